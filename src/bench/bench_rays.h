@@ -0,0 +1,32 @@
+#pragma once
+#include "camera/camera.h"
+#include "core/hit_record.h"
+#include "core/random.h"
+#include "geometry/hittable.h"
+
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief Builds the benchmark ray workload shared by cobra_bench and cobra_bvh_bench:
+     * one camera ray per pixel, and one diffuse bounce from each primary hit point.
+     */
+    inline void make_bench_rays(camera &cam, const hittable &world, std::vector<ray> &primary, std::vector<ray> &secondary)
+    {
+        cam.init();
+        for (size_t j = 0; j < cam.image_height(); ++j)
+        {
+            for (size_t i = 0; i < cam.image_width(); ++i)
+            {
+                thread_rng().begin_sample(cam.seed, j * cam.image_width() + i, 0);
+                ray r = cam.generate_ray(int(i), int(j), 0, 0);
+                primary.push_back(r);
+
+                hit_record rec;
+                if (world.hit(r, interval(0.001, infinity), rec))
+                    secondary.emplace_back(rec.point, rec.normal + random_unit_vector());
+            }
+        }
+    }
+} // namespace cobra
@@ -0,0 +1,178 @@
+#include "bench/bench_rays.h"
+#include "scene/demo_scenes.h"
+#include "core/bvh_builder.h"
+#include "core/bvh_node.h"
+#include "core/wide_bvh.h"
+#include "core/hit_record.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace cobra;
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    double seconds_since(bench_clock::time_point start)
+    {
+        return std::chrono::duration<double>(bench_clock::now() - start).count();
+    }
+
+    /**
+     * @brief Traces every ray through an acceleration structure and reports the throughput.
+     * @return The closest hit distance of every ray (infinity on a miss).
+     */
+    std::vector<double> run(const char *label, const hittable &accel, const std::vector<ray> &rays, int repeats)
+    {
+        std::vector<double> distances(rays.size());
+        double best = infinity;
+        for (int rep = 0; rep < repeats; ++rep)
+        {
+            auto start = bench_clock::now();
+            for (size_t i = 0; i < rays.size(); ++i)
+            {
+                hit_record rec;
+                distances[i] = accel.hit(rays[i], interval(0.001, infinity), rec) ? rec.t : infinity;
+            }
+            best = std::fmin(best, seconds_since(start));
+        }
+
+        std::cout << "    " << std::setw(8) << label << std::setw(10) << std::fixed << std::setprecision(2)
+                  << rays.size() / best * 1e-6 << " Mrays/s";
+        return distances;
+    }
+
+    void compare(const std::vector<double> &reference, const std::vector<double> &result)
+    {
+        size_t mismatches = 0;
+        for (size_t i = 0; i < reference.size(); ++i)
+            if (reference[i] != result[i])
+                mismatches++;
+        std::cout << "  (" << mismatches << " mismatches)" << std::endl;
+    }
+
+    void bench_scene(const char *name, demo_scene demo, int repeats)
+    {
+        std::cout << name << " (" << demo.world.hittable_list.size() << " objects)" << std::endl;
+
+        auto start = bench_clock::now();
+        auto binary = make_shared<bvh_node>(demo.world);
+        double binary_time = seconds_since(start);
+
+        start = bench_clock::now();
+        bvh4 wide4(binary);
+        double wide4_time = seconds_since(start);
+
+        start = bench_clock::now();
+        bvh8 wide8(binary);
+        double wide8_time = seconds_since(start);
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "  build: binary " << binary->node_count() << " nodes in " << binary_time * 1e3 << " ms, "
+                  << "bvh4 " << wide4.node_count() << " nodes in " << wide4_time * 1e3 << " ms, "
+                  << "bvh8 " << wide8.node_count() << " nodes in " << wide8_time * 1e3 << " ms" << std::endl;
+
+        std::vector<ray> primary, secondary;
+        make_bench_rays(demo.cam, *binary, primary, secondary);
+
+        const std::pair<const char *, const std::vector<ray> *> sets[] = {{"primary", &primary}, {"secondary", &secondary}};
+        for (const auto &set : sets)
+        {
+            std::cout << "  " << set.first << " rays: " << set.second->size() << std::endl;
+            auto reference = run("scalar", *binary, *set.second, repeats);
+            std::cout << std::endl;
+            compare(reference, run("bvh4", wide4, *set.second, repeats));
+            compare(reference, run("bvh8", wide8, *set.second, repeats));
+        }
+    }
+
+    bool same_tree(const bvh_builder &a, const bvh_builder &b)
+    {
+        if (a.nodes().size() != b.nodes().size() || a.primitive_order() != b.primitive_order())
+            return false;
+        for (size_t i = 0; i < a.nodes().size(); ++i)
+        {
+            const bvh_build_node &x = a.nodes()[i], &y = b.nodes()[i];
+            if (x.primitive_count != y.primitive_count || x.first_primitive != y.first_primitive ||
+                x.children[0] != y.children[0] || x.children[1] != y.children[1] || x.split_axis != y.split_axis)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Times bvh_builder on random boxes with 1, 2, 4... threads, up to the hardware
+     * concurrency, and checks that every build gives the tree of the serial one.
+     */
+    void bench_build(size_t primitives, int repeats)
+    {
+        std::mt19937_64 generator(42);
+        std::uniform_real_distribution<double> position(0, 1000), size(0.01, 2);
+        std::vector<aabb> bounds(primitives);
+        for (auto &box : bounds)
+        {
+            vec3 c(position(generator), 0.2 * position(generator), position(generator));
+            double r = size(generator);
+            box = aabb(c - vec3(r, r, r), c + vec3(r, r, r));
+        }
+        std::cout << "bvh_builder (" << primitives << " random boxes)" << std::endl;
+
+        size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+        bvh_builder serial;
+        double serial_time = 0;
+        for (size_t threads = 1;; threads = std::min(2 * threads, max_threads))
+        {
+            bvh_build_options options;
+            options.threads = threads;
+            bvh_builder builder(options);
+            double best = infinity;
+            for (int rep = 0; rep < repeats; ++rep)
+            {
+                auto start = bench_clock::now();
+                builder.build(bounds);
+                best = std::fmin(best, seconds_since(start));
+            }
+
+            if (threads == 1)
+            {
+                serial = builder;
+                serial_time = best;
+            }
+            std::cout << std::fixed << std::setprecision(1) << "  " << std::setw(3) << threads << " threads: "
+                      << std::setw(8) << best * 1e3 << " ms, speedup " << std::setprecision(2) << serial_time / best
+                      << (same_tree(serial, builder) ? "" : "  (tree differs)") << std::endl;
+            if (threads == max_threads)
+                break;
+        }
+    }
+}
+
+/**
+ * Compares the scalar binary BVH traversal with the SIMD BVH4 and BVH8 traversals on
+ * the demo scenes, then times the parallel BVH build.
+ * Usage: cobra_bvh_bench [repeats] [build primitives]
+ */
+int main(int argc, char **argv)
+{
+    int repeats = argc > 1 ? std::max(1, std::atoi(argv[1])) : 3;
+    size_t build_primitives = argc > 2 ? size_t(std::max(1L, std::atol(argv[2]))) : 1000000;
+
+#if defined(COBRA_AVX)
+    std::cout << "SIMD: SSE (bvh4), AVX (bvh8)" << std::endl;
+#elif defined(COBRA_SSE)
+    std::cout << "SIMD: SSE (bvh4), scalar fallback (bvh8)" << std::endl;
+#else
+    std::cout << "SIMD: scalar fallback" << std::endl;
+#endif
+
+    bench_scene("fill_with_spheres", fill_with_spheres(), repeats);
+    bench_scene("cornell_box", cornell_box(), repeats);
+    bench_build(build_primitives, repeats);
+    return 0;
+}
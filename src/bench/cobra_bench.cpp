@@ -0,0 +1,517 @@
+#include "bench/bench_rays.h"
+#include "scene/demo_scenes.h"
+#include "scene/instancing.h"
+#include "scene/light_sampler.h"
+#include "core/bvh_node.h"
+#include "core/wide_bvh.h"
+#include "core/hit_record.h"
+#include "image/image_writer.h"
+#include "tools/command_line.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cobra;
+
+namespace
+{
+    using bench_clock = std::chrono::steady_clock;
+
+    double seconds_since(bench_clock::time_point start)
+    {
+        return std::chrono::duration<double>(bench_clock::now() - start).count();
+    }
+
+    /// Command line settings of the benchmark.
+    struct settings
+    {
+        std::vector<std::string> scenes = {"quads", "fill_with_spheres", "checkered_spheres", "simple_light",
+                                           "cornell_box"};
+        size_t width = 200;    ///< Image width; the height follows the scene's aspect ratio.
+        size_t spp = 16;       ///< Samples per pixel of the timed renders.
+        size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+        int warmup = 1;        ///< Untimed runs before each measurement.
+        int repeats = 3;       ///< Timed runs; the median is reported.
+        uint64_t seed = 1;     ///< Seed of the scene setup and of the render.
+        std::string json = "cobra_bench.json";
+        std::string images;    ///< Directory receiving the rendered images, for image comparisons.
+        light_sampling sampling = light_sampling::bvh; ///< How the renders choose among several lights.
+        bool next_event_estimation = true;             ///< Shadow rays toward the lights.
+    };
+
+    /// Minimum and median of repeated timings, in seconds.
+    struct timing
+    {
+        double min = 0;
+        double median = 0;
+    };
+
+    /**
+     * @brief Runs `work` `warmup` times untimed, then `repeats` times timed.
+     */
+    timing measure(const settings &opts, const std::function<void()> &work)
+    {
+        for (int run = 0; run < opts.warmup; ++run)
+            work();
+
+        std::vector<double> seconds;
+        for (int run = 0; run < opts.repeats; ++run)
+        {
+            auto start = bench_clock::now();
+            work();
+            seconds.push_back(seconds_since(start));
+        }
+        std::sort(seconds.begin(), seconds.end());
+        return {seconds.front(), seconds[seconds.size() / 2]};
+    }
+
+    /**
+     * @class counting_hittable
+     * @brief Forwards to a world while counting the rays traced through it.
+     *
+     * The integrators call the world once per path segment and once per shadow ray, so
+     * this counts every ray of a render. Counts go to a few cache-line sized slots picked by thread to keep the
+     * render threads from contending on a single counter.
+     */
+    class counting_hittable : public hittable
+    {
+    public:
+        explicit counting_hittable(const hittable &world) : world(world) {}
+
+        bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+        {
+            slots[std::hash<std::thread::id>()(std::this_thread::get_id()) % slot_count].rays.fetch_add(
+                1, std::memory_order_relaxed);
+            return world.hit(r, ray_t, rec);
+        }
+
+        bool occluded(const ray &r, interval ray_t) const override
+        {
+            slots[std::hash<std::thread::id>()(std::this_thread::get_id()) % slot_count].shadow_rays.fetch_add(
+                1, std::memory_order_relaxed);
+            return world.occluded(r, ray_t);
+        }
+
+        aabb bounding_box() const override { return world.bounding_box(); }
+
+        double pdf_value(const vec3 &origin, const vec3 &direction) const override
+        {
+            return world.pdf_value(origin, direction);
+        }
+
+        vec3 random(const vec3 &origin) const override { return world.random(origin); }
+
+        /// @return The rays counted since the last reset.
+        uint64_t rays() const
+        {
+            uint64_t total = 0;
+            for (const auto &slot : slots)
+                total += slot.rays.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        /// @return The shadow rays counted since the last reset.
+        uint64_t shadow_rays() const
+        {
+            uint64_t total = 0;
+            for (const auto &slot : slots)
+                total += slot.shadow_rays.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        void reset()
+        {
+            for (auto &slot : slots)
+            {
+                slot.rays.store(0, std::memory_order_relaxed);
+                slot.shadow_rays.store(0, std::memory_order_relaxed);
+            }
+        }
+
+    private:
+        struct alignas(64) slot
+        {
+            std::atomic<uint64_t> rays{0};
+            std::atomic<uint64_t> shadow_rays{0};
+        };
+        static constexpr size_t slot_count = 64;
+
+        const hittable &world;
+        mutable slot slots[slot_count];
+    };
+
+    /// @brief Builds a demo scene from a fixed state of the setup generator.
+    bool make_scene(const std::string &name, uint64_t seed, demo_scene &demo)
+    {
+        thread_rng() = rng(seed);
+        return make_demo_scene(name, demo);
+    }
+
+    /// Hits of the last cast(), stored so that the loop is not optimized away.
+    volatile size_t cast_hits = 0;
+
+    /// @brief Closest-hit queries for every ray, the rays per second being derived by the caller.
+    void cast(const hittable &accel, const std::vector<ray> &rays)
+    {
+        size_t hits = 0;
+        for (const auto &r : rays)
+        {
+            hit_record rec;
+            hits += accel.hit(r, interval(0.001, infinity), rec) ? 1 : 0;
+        }
+        cast_hits = hits;
+    }
+
+    /// @brief Any-hit (shadow) queries for every ray over its whole range.
+    void occlude(const hittable &accel, const std::vector<ray> &rays)
+    {
+        size_t hits = 0;
+        for (const auto &r : rays)
+            hits += accel.occluded(r, interval(0.001, infinity)) ? 1 : 0;
+        cast_hits = hits;
+    }
+
+    /// @return An FNV-1a hash of the pixels, to check that the renders do not depend on the thread count.
+    uint64_t image_hash(const image &img)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (size_t row = 0; row < img.get_height(); ++row)
+        {
+            for (size_t col = 0; col < img.get_width(); ++col)
+            {
+                vec3 pixel = img.get_pixel(row, col);
+                unsigned char bytes[sizeof(double)];
+                for (int c = 0; c < 3; ++c)
+                {
+                    double value = pixel[c];
+                    std::memcpy(bytes, &value, sizeof(double));
+                    for (unsigned char byte : bytes)
+                        hash = (hash ^ byte) * 0x100000001b3ULL;
+                }
+            }
+        }
+        return hash;
+    }
+
+    /// @return 1, 2, 4, ... up to and including `max_threads`.
+    std::vector<size_t> thread_counts(size_t max_threads)
+    {
+        std::vector<size_t> counts;
+        for (size_t n = 1; n < max_threads; n *= 2)
+            counts.push_back(n);
+        counts.push_back(max_threads);
+        return counts;
+    }
+
+    /// @brief Writes "key": {"min": .., "median": ..} with the timings in milliseconds.
+    void write_timing(std::ostream &out, const char *key, const timing &t)
+    {
+        out << "\"" << key << "\": {\"min\": " << t.min * 1e3 << ", \"median\": " << t.median * 1e3 << "}";
+    }
+
+    /**
+     * @brief Benchmarks one scene and appends its JSON object to `json`.
+     * @return False if the scene does not exist or its image could not be written.
+     */
+    bool bench_scene(const std::string &name, const settings &opts, std::ostream &json)
+    {
+        demo_scene demo;
+        auto start = bench_clock::now();
+        if (!make_scene(name, opts.seed, demo))
+        {
+            std::cerr << "Unknown demo scene " << name << std::endl;
+            return false;
+        }
+        double setup_time = seconds_since(start);
+        std::cout << name << " (" << demo.world.hittable_list.size() << " objects)" << std::endl;
+
+        // Acceleration structure, built as by the cobra executable.
+        timing build_time = measure(opts, [&]
+        {
+            instance_builder instances;
+            auto bvh = make_shared<bvh_node>(instances.build(demo.world));
+            bvh8 wide(bvh);
+        });
+        instance_builder instances;
+        auto bvh = make_shared<bvh_node>(instances.build(demo.world));
+        scene world(make_shared<bvh8>(bvh));
+        std::cout << std::fixed << std::setprecision(3) << "  build: " << bvh->node_count() << " nodes in "
+                  << build_time.median * 1e3 << " ms" << std::endl;
+
+        camera &cam = demo.cam;
+        cam.width = opts.width;
+        cam.nb_samples = opts.spp;
+        cam.seed = opts.seed;
+        cam.next_event_estimation = opts.next_event_estimation;
+
+        // Ray casting alone, on one thread.
+        std::vector<ray> primary, secondary;
+        make_bench_rays(cam, world, primary, secondary);
+        timing primary_time = measure(opts, [&] { cast(world, primary); });
+        timing secondary_time = measure(opts, [&] { cast(world, secondary); });
+        timing shadow_time = measure(opts, [&] { occlude(world, secondary); });
+        double primary_rate = primary.size() / primary_time.median;
+        double secondary_rate = secondary.size() / secondary_time.median;
+        double shadow_rate = secondary.size() / shadow_time.median;
+        std::cout << std::setprecision(2) << "  cast: primary " << primary_rate * 1e-6 << " Mrays/s, secondary "
+                  << secondary_rate * 1e-6 << " Mrays/s, secondary any-hit " << shadow_rate * 1e-6 << " Mrays/s"
+                  << std::endl;
+
+        // Full renders over the thread sweep.
+        counting_hittable counted(world);
+        shared_ptr<hittable> sampled = make_light_sampler(demo.lights, opts.sampling);
+        scene no_lights;
+        const hittable &lights = sampled ? *sampled : static_cast<const hittable &>(no_lights);
+        std::ostringstream sweep;
+        double single_thread = 0;
+        uint64_t reference_hash = 0;
+        bool deterministic = true;
+        std::unique_ptr<image> img;
+        for (size_t threads : thread_counts(opts.max_threads))
+        {
+            cam.nb_threads = threads;
+            timing render_time = measure(opts, [&] { cam.render_image(counted, lights); });
+
+            // Rays of one render: every sample starts with a primary ray, then bounces and shadow rays.
+            counted.reset();
+            img = std::make_unique<image>(cam.render_image(counted, lights));
+            uint64_t shadow_rays = counted.shadow_rays();
+            uint64_t rays = counted.rays() + shadow_rays;
+            uint64_t primary_rays = cam.samples_taken;
+            uint64_t secondary_rays = rays - primary_rays - shadow_rays;
+
+            uint64_t hash = image_hash(*img);
+            if (threads == 1)
+            {
+                single_thread = render_time.median;
+                reference_hash = hash;
+            }
+            deterministic = deterministic && hash == reference_hash;
+
+            double speedup = single_thread / render_time.median;
+            std::cout << "  render " << std::setw(3) << threads << " threads: " << std::setprecision(3)
+                      << render_time.median * 1e3 << " ms, " << std::setprecision(2)
+                      << rays / render_time.median * 1e-6 << " Mrays/s, speedup " << speedup << std::endl;
+
+            sweep << (threads == 1 ? "" : ",") << "\n        {\"threads\": " << threads << ", ";
+            write_timing(sweep, "time_ms", render_time);
+            sweep << ", \"samples\": " << cam.samples_taken
+                  << ", \"primary_rays\": " << primary_rays << ", \"secondary_rays\": " << secondary_rays
+                  << ", \"shadow_rays\": " << shadow_rays
+                  << ", \"samples_per_second\": " << cam.samples_taken / render_time.median
+                  << ", \"primary_rays_per_second\": " << primary_rays / render_time.median
+                  << ", \"secondary_rays_per_second\": " << secondary_rays / render_time.median
+                  << ", \"speedup\": " << speedup << ", \"efficiency\": " << speedup / threads
+                  << ", \"imbalance\": " << cam.render_stats.imbalance() << "}";
+        }
+        if (!deterministic)
+            std::cerr << "  warning: the image depends on the thread count" << std::endl;
+
+        // Image output, to a scratch file.
+        const std::string extensions[] = {".ppm", ".pfm"};
+        timing output_time[2];
+        for (int format = 0; format < 2; ++format)
+        {
+            const std::string path = "cobra_bench_" + name + extensions[format];
+            auto writer = image_writer::create(path);
+            bool written = true;
+            output_time[format] = measure(opts, [&] { written = writer && writer->write(*img, path) && written; });
+            std::remove(path.c_str());
+            if (!written)
+            {
+                std::cerr << "Could not write " << path << std::endl;
+                return false;
+            }
+        }
+        if (!opts.images.empty())
+        {
+            const std::string path = opts.images + "/" + name + ".pfm";
+            auto writer = image_writer::create(path);
+            if (!writer || !writer->write(*img, path))
+            {
+                std::cerr << "Could not write " << path << std::endl;
+                return false;
+            }
+        }
+        std::cout << std::setprecision(3) << "  output: ppm " << output_time[0].median * 1e3 << " ms, pfm "
+                  << output_time[1].median * 1e3 << " ms" << std::endl;
+
+        json << "    {\n      \"name\": \"" << name << "\",\n"
+             << "      \"objects\": " << demo.world.hittable_list.size() << ",\n"
+             << "      \"width\": " << cam.image_width() << ", \"height\": " << cam.image_height()
+             << ", \"spp\": " << opts.spp << ", \"depth\": " << cam.depth
+             << ", \"next_event_estimation\": " << (cam.next_event_estimation ? "true" : "false") << ",\n"
+             << "      \"setup_ms\": " << setup_time * 1e3 << ",\n"
+             << "      \"bvh\": {\"nodes\": " << bvh->node_count() << ", \"instances\": " << instances.instance_count()
+             << ", \"grouped_spheres\": " << instances.grouped_sphere_count() << ", ";
+        write_timing(json, "build_ms", build_time);
+        json << "},\n      \"ray_cast\": {\"threads\": 1, \"primary_rays\": " << primary.size()
+             << ", \"secondary_rays\": " << secondary.size() << ", ";
+        write_timing(json, "primary_ms", primary_time);
+        json << ", ";
+        write_timing(json, "secondary_ms", secondary_time);
+        json << ", ";
+        write_timing(json, "shadow_ms", shadow_time);
+        json << ", \"primary_rays_per_second\": " << primary_rate
+             << ", \"secondary_rays_per_second\": " << secondary_rate
+             << ", \"shadow_rays_per_second\": " << shadow_rate << "},\n"
+             << "      \"render\": [" << sweep.str() << "\n      ],\n"
+             << "      \"deterministic\": " << (deterministic ? "true" : "false") << ",\n"
+             << "      \"image_hash\": \"" << std::hex << reference_hash << std::dec << "\",\n"
+             << "      \"output\": {";
+        write_timing(json, "ppm_ms", output_time[0]);
+        json << ", ";
+        write_timing(json, "pfm_ms", output_time[1]);
+        json << "}\n    }";
+        return true;
+    }
+
+    void print_usage(const char *program)
+    {
+        std::cout << "Usage: " << program << " [options]\n"
+                  << "\n"
+                  << "Times the BVH build, ray casting, rendering over 1 to N threads and the image\n"
+                  << "output of the demo scenes, and writes the results as JSON.\n"
+                  << "\n"
+                  << "  -w, --width N      image width (default 200)\n"
+                  << "  -s, --spp N        samples per pixel (default 16)\n"
+                  << "  -t, --threads N    largest thread count of the sweep (default: all hardware threads)\n"
+                  << "      --warmup N     untimed runs before each measurement (default 1)\n"
+                  << "  -r, --repeats N    timed runs, the median being reported (default 3)\n"
+                  << "      --seed N       seed of the scenes and of the renders (default 1)\n"
+                  << "      --scene NAME   benchmark this demo scene (repeatable; default: quads,\n"
+                  << "                     fill_with_spheres, checkered_spheres, simple_light, cornell_box)\n"
+                  << "  -o, --json PATH    results file (default cobra_bench.json)\n"
+                  << "      --images DIR   also save each render as DIR/SCENE.pfm (see cobra_image_diff)\n"
+                  << "      --no-nee       render without next-event estimation (shadow rays)\n"
+                  << "      --light-sampling uniform|power|bvh\n"
+                  << "                     how to choose among several lights (default bvh)\n"
+                  << "  -h, --help         print this help\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    settings opts;
+    std::vector<std::string> scenes;
+    for (int a = 1; a < argc; ++a)
+    {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        long value = has_value ? parse_count(argv[a + 1]) : -1;
+        bool is_count = arg == "-w" || arg == "--width" || arg == "-s" || arg == "--spp" || arg == "-t" ||
+                        arg == "--threads" || arg == "--warmup" || arg == "-r" || arg == "--repeats" ||
+                        arg == "--seed";
+        if (is_count && value < 0)
+        {
+            std::cerr << arg << " expects a non-negative integer" << std::endl;
+            return 1;
+        }
+
+        if (arg == "-w" || arg == "--width")
+            opts.width = size_t(std::max(1l, value));
+        else if (arg == "-s" || arg == "--spp")
+            opts.spp = size_t(std::max(1l, value));
+        else if (arg == "-t" || arg == "--threads")
+            opts.max_threads = value > 0 ? size_t(value) : opts.max_threads;
+        else if (arg == "--warmup")
+            opts.warmup = int(value);
+        else if (arg == "-r" || arg == "--repeats")
+            opts.repeats = int(std::max(1l, value));
+        else if (arg == "--seed")
+            opts.seed = uint64_t(value);
+        else if (arg == "--scene" && has_value)
+            scenes.push_back(argv[a + 1]);
+        else if ((arg == "-o" || arg == "--json") && has_value)
+            opts.json = argv[a + 1];
+        else if (arg == "--no-nee")
+        {
+            opts.next_event_estimation = false;
+            continue;
+        }
+        else if (arg == "--light-sampling" && has_value)
+        {
+            if (!parse_light_sampling(argv[a + 1], opts.sampling))
+            {
+                std::cerr << "Unknown light sampling " << argv[a + 1] << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--images" && has_value)
+            opts.images = argv[a + 1];
+        else if (arg == "-h" || arg == "--help")
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else
+        {
+            std::cerr << "Unknown or incomplete option " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+        ++a;
+    }
+    if (!scenes.empty())
+        opts.scenes = scenes;
+
+#if defined(COBRA_AVX)
+    const char *simd = "avx";
+#elif defined(COBRA_SSE)
+    const char *simd = "sse";
+#else
+    const char *simd = "scalar";
+#endif
+
+    std::ostringstream json;
+    json << std::setprecision(6) << "{\n"
+         << "  \"version\": 1,\n"
+         << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+         << "  \"simd\": \"" << simd << "\",\n"
+         << "  \"precision\": \"" << (sizeof(real) == sizeof(float) ? "float" : "double") << "\",\n"
+         << "  \"settings\": {\"width\": " << opts.width << ", \"spp\": " << opts.spp
+         << ", \"max_threads\": " << opts.max_threads << ", \"warmup\": " << opts.warmup
+         << ", \"repeats\": " << opts.repeats << ", \"seed\": " << opts.seed << "},\n"
+         << "  \"scenes\": [\n";
+
+    // The per-render statistics that camera logs would drown the results.
+    std::streambuf *log = std::clog.rdbuf(nullptr);
+    int failures = 0;
+    bool first = true;
+    for (const auto &name : opts.scenes)
+    {
+        std::ostringstream entry;
+        entry << std::setprecision(6);
+        if (!bench_scene(name, opts, entry))
+        {
+            failures++;
+            continue;
+        }
+        json << (first ? "" : ",\n") << entry.str();
+        first = false;
+    }
+    json << "\n  ]\n}\n";
+    std::clog.rdbuf(log);
+
+    std::ofstream out(opts.json);
+    if (!(out << json.str()))
+    {
+        std::cerr << "Could not write " << opts.json << std::endl;
+        return 1;
+    }
+    std::cout << "Results: " << opts.json << std::endl;
+    return failures == 0 ? 0 : 1;
+}
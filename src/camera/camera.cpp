@@ -4,12 +4,36 @@
 #include "image/image.h"
 #include "core/hit_record.h"
 #include "scene/scene.h"
-#include "core/material.h"
+#include "core/material_dispatch.h"
 #include "core/pdf.h"
+#include "core/allocation_counter.h"
+#include "core/instrumentation.h"
+#include "render/wavefront_integrator.h"
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
 #include "scene/scene.h"
 
 namespace cobra
 {
+    namespace
+    {
+        /// Fraction of the distance to a light left out of its shadow ray, so that the light
+        /// itself does not count as a blocker.
+        constexpr double shadow_epsilon = 1e-6;
+
+        /// Power heuristic (exponent 2): weight of a sample drawn with density `f` that
+        /// could also have been drawn with density `g`.
+        inline double power_heuristic(double f, double g)
+        {
+            double f2 = f * f;
+            return f2 / (f2 + g * g);
+        }
+    }
+
     // ----------------------------
     // Constructors & Destructors
     // ---------------------------
@@ -22,10 +46,17 @@ namespace cobra
     {
     }
 
+    bool camera::image_size_ok() const
+    {
+        // In double, as width / aspect_ratio overflows the integer types for tiny aspect ratios.
+        double rows = std::max(1.0, std::floor(width / aspect_ratio));
+        return width > 0 && aspect_ratio > 0 && double(width) * rows <= max_pixels;
+    }
+
     void camera::init()
     {
-        height = int(width / aspect_ratio);
-        height = (height < 1) ? 1 : height;
+        double rows = std::floor(width / aspect_ratio);
+        height = rows < 1 ? 1 : size_t(rows);
 
         camera_center = lookfrom;
 
@@ -34,7 +65,8 @@ namespace cobra
         viewport_height = 2 * h * focus_dist;
         viewport_width = viewport_height * (double(width) / height);
 
-        sqrt_spp = int(std::sqrt(nb_samples));
+        sqrt_spp = int(std::sqrt(adaptive_sampling ? adaptive_base_samples : nb_samples));
+        sqrt_spp = (sqrt_spp < 1) ? 1 : sqrt_spp;
         recip_sqrt_spp = 1.0 / sqrt_spp;
 
         w = unit_vector(lookfrom - lookat);
@@ -64,7 +96,8 @@ namespace cobra
 
     vec3 camera::sample_square() const
     {
-        return vec3(random_double() - 0.5, random_double() - 0.5, 0);
+        auto r = thread_rng().next_doubles<2>();
+        return vec3(r[0] - 0.5, r[1] - 0.5, 0);
     }
 
     const ray camera::generate_ray(int i, int j, int s_i, int s_j) const
@@ -80,8 +113,9 @@ namespace cobra
 
     vec3 camera::sample_square_stratified(int s_i, int s_j) const
     {
-        auto px = ((s_i + random_double()) * recip_sqrt_spp) - 0.5;
-        auto py = ((s_j + random_double()) * recip_sqrt_spp) - 0.5;
+        auto r = thread_rng().next_doubles<2>();
+        auto px = ((s_i + r[0]) * recip_sqrt_spp) - 0.5;
+        auto py = ((s_j + r[1]) * recip_sqrt_spp) - 0.5;
 
         return vec3(px, py, 0);
     }
@@ -94,70 +128,361 @@ namespace cobra
     }
 
     image camera::render_image(const hittable &world, const hittable &lights)
+    {
+        accumulation_buffer accumulation;
+        return render_image(world, lights, accumulation);
+    }
+
+    tile camera::clipped_region() const
+    {
+        tile r = {uint32_t(std::min<size_t>(region.x0, width)), uint32_t(std::min<size_t>(region.y0, height)),
+                  uint32_t(std::min<size_t>(region.x1, width)), uint32_t(std::min<size_t>(region.y1, height))};
+        if (r.x1 <= r.x0 || r.y1 <= r.y0)
+            r = {0, 0, uint32_t(width), uint32_t(height)};
+        return r;
+    }
+
+    bool camera::can_resume(const accumulation_buffer &accumulation)
     {
         init();
-        image img_result(width, height);
+        tile r = clipped_region();
+        return accumulation.image_width == width && accumulation.image_height == height &&
+               accumulation.x0 == r.x0 && accumulation.y0 == r.y0 &&
+               accumulation.width == r.x1 - r.x0 && accumulation.height == r.y1 - r.y0 &&
+               accumulation.sample_offset == sample_offset && accumulation.seed == seed &&
+               accumulation.batch_samples == size_t(sqrt_spp * sqrt_spp) && accumulation.adaptive == adaptive_sampling &&
+               accumulation.aovs == aovs &&
+               accumulation.pixels.size() == accumulation.width * accumulation.height;
+    }
 
-#pragma omp parallel for schedule(dynamic, 1)
-        for (size_t j = 0; j < height; ++j)
+    image camera::render_image(const hittable &world, const hittable &lights, accumulation_buffer &accumulation)
+    {
+        COBRA_TRACE_SPAN("render_image", "render");
+        bool resumable = can_resume(accumulation);
+        lights_emit = lights.emitted_power() > 0;
+        const tile r = clipped_region();
+        const size_t region_width = r.x1 - r.x0, region_height = r.y1 - r.y0;
+        if (!resumable)
+        {
+            accumulation = accumulation_buffer(region_width, region_height, seed, size_t(sqrt_spp * sqrt_spp), adaptive_sampling);
+            accumulation.x0 = r.x0;
+            accumulation.y0 = r.y0;
+            accumulation.image_width = width;
+            accumulation.image_height = height;
+            accumulation.sample_offset = sample_offset;
+            accumulation.aovs = aovs;
+        }
+        std::atomic<uint64_t> allocations{0};
+        tile_scheduler scheduler(region_width, region_height, tile_size, nb_threads);
+        render_stats = tile_stats();
+        interrupted = false;
+        const size_t batch = size_t(sqrt_spp * sqrt_spp);
+        const size_t max_samples = adaptive_sampling ? std::max(nb_samples, batch) : batch;
+        // Samples of a pass: a batch, or the part of it this render takes.
+        const size_t pass_samples = !adaptive_sampling && sample_count > 0 ? std::min(sample_count, batch) : batch;
+        const size_t resumed_samples = accumulation.sample_count();
+
+        // Per-thread work buffers, sized up front so that rendering does not allocate. The
+        // luminance statistics of a tile are updated in a copy, for the same reason as the sums.
+        std::vector<std::vector<pixel_batch>> tile_batches(scheduler.thread_count());
+        std::vector<std::vector<running_stats>> tile_luminance(scheduler.thread_count());
+        std::vector<std::unique_ptr<wavefront_integrator>> integrators(scheduler.thread_count());
+        for (size_t t = 0; t < scheduler.thread_count(); ++t)
+        {
+            tile_batches[t].reserve(tile_size * tile_size);
+            tile_luminance[t].reserve(tile_size * tile_size);
+            if (wavefront)
+                integrators[t] = std::make_unique<wavefront_integrator>(*this, world, lights, wavefront_size);
+        }
+
+        // Tiles add their samples under a lock, so that a checkpoint never holds half a tile.
+        std::mutex accumulation_mutex;
+        std::mutex checkpoint_mutex;
+        using checkpoint_clock = std::chrono::steady_clock;
+        const auto interval = std::chrono::duration_cast<checkpoint_clock::duration>(std::chrono::duration<double>(checkpoint_interval));
+        auto next_checkpoint = checkpoint_clock::now() + interval;
+        auto save_checkpoint = [&]()
         {
-            for (size_t i = 0; i < width; ++i)
+            COBRA_TRACE_SPAN("checkpoint", "render");
+            accumulation_buffer snapshot;
             {
-                vec3 final_color(0, 0, 0);
+                std::lock_guard<std::mutex> lock(accumulation_mutex);
+                snapshot = accumulation;
+            }
+            std::string error;
+            if (!write_accumulation(snapshot, checkpoint_path, &error))
+                std::cerr << "Checkpoint failed: " << error << std::endl;
+        };
+
+        // One pass over the image: every pixel not done gets a batch, unless it already has
+        // `target` samples from a previous run. Only what shading allocates is counted, not
+        // the thread pool.
+        auto render_pass = [&](size_t target)
+        {
+            COBRA_TRACE_SPAN("render_pass", "render");
+            render_stats.add(scheduler.run([&](const tile &t, size_t thread)
+                                           {
+                                               if (stop_request && stop_request->load())
+                                                   return;
+                                               COBRA_TRACE_SPAN("tile", "render");
+                                               uint64_t before = thread_allocation_count();
+                                               std::vector<pixel_batch> &batches = tile_batches[thread];
+                                               std::vector<running_stats> &luminance = tile_luminance[thread];
+                                               batches.clear();
+                                               luminance.clear();
+                                               scheduler.for_each_pixel(t, [&](size_t i, size_t j)
+                                                                        {
+                                                                            const pixel_accumulator &p = accumulation.at(i, j);
+                                                                            if (p.done || p.samples() >= target)
+                                                                                return;
+                                                                            batches.push_back({uint32_t(r.x0 + i), uint32_t(r.y0 + j), sample_offset + p.samples(),
+                                                                                               uint32_t(target - p.samples()), nullptr, vec3(0, 0, 0), aov_sample()});
+                                                                            luminance.push_back(p.luminance); });
+                                               for (size_t b = 0; b < batches.size(); ++b)
+                                                   batches[b].luminance = &luminance[b];
+
+                                               if (wavefront)
+                                                   integrators[thread]->trace(batches);
+                                               else
+                                                   for (pixel_batch &batch : batches)
+                                                       batch.sum = sample_pixel(batch.i, batch.j, world, lights, batch.first_sample, batch.samples,
+                                                                                batch.luminance, aovs ? &batch.aovs : nullptr);
+
+                                               {
+                                                   std::lock_guard<std::mutex> lock(accumulation_mutex);
+                                                   for (size_t b = 0; b < batches.size(); ++b)
+                                                   {
+                                                       pixel_accumulator &p = accumulation.at(batches[b].i - r.x0, batches[b].j - r.y0);
+                                                       p.sum += batches[b].sum;
+                                                       p.luminance = luminance[b];
+                                                       p.aovs += batches[b].aovs;
+                                                   }
+                                               }
+                                               allocations += thread_allocation_count() - before;
+
+                                               if (checkpoint_path.empty())
+                                                   return;
+                                               std::unique_lock<std::mutex> checkpoint_lock(checkpoint_mutex, std::try_to_lock);
+                                               if (checkpoint_lock.owns_lock() && checkpoint_clock::now() >= next_checkpoint)
+                                               {
+                                                   save_checkpoint();
+                                                   next_checkpoint = checkpoint_clock::now() + interval;
+                                               } }));
+        };
+
+        bool active = std::any_of(accumulation.pixels.begin(), accumulation.pixels.end(), [](const pixel_accumulator &p)
+                             { return !p.done; });
+        while (active)
+        {
+            render_pass(accumulation.passes * batch + pass_samples);
+            if (stop_request && stop_request->load())
+            {
+                interrupted = true;
+                break;
+            }
+            accumulation.passes++;
 
-                for (int s_j = 0; s_j < sqrt_spp; s_j++)
+            if (!adaptive_sampling)
+            {
+                for (auto &p : accumulation.pixels)
+                    p.done = true;
+                break;
+            }
+
+            // Decide on the estimates of this pass only, so the outcome does not depend
+            // on the order pixels are visited in.
+            COBRA_TRACE_SPAN("adaptive_update", "render");
+            std::vector<char> converged(accumulation.pixels.size(), 0);
+            for (size_t j = 0; j < region_height; ++j)
+            {
+                for (size_t i = 0; i < region_width; ++i)
                 {
-                    for (int s_i = 0; s_i < sqrt_spp; s_i++)
-                    {
-                        vec3 color_contrib = trace_ray(generate_ray(i, j, s_i, s_j), world, lights, depth);
-                        final_color += color_contrib;
-                    }
+                    const pixel_accumulator &e = accumulation.at(i, j);
+                    if (e.done)
+                        continue;
+
+                    double neighbour_variance = 0;
+                    double neighbour_mean = 0;
+                    int neighbours = 0;
+                    for (size_t y = (j > 0 ? j - 1 : 0); y <= std::min(j + 1, region_height - 1); ++y)
+                        for (size_t x = (i > 0 ? i - 1 : 0); x <= std::min(i + 1, region_width - 1); ++x)
+                        {
+                            neighbour_variance += accumulation.at(x, y).luminance.variance();
+                            neighbour_mean += accumulation.at(x, y).luminance.mean();
+                            ++neighbours;
+                        }
+
+                    double variance = std::fmax(e.luminance.variance(), neighbour_variance / neighbours);
+                    double mean = std::fmax(neighbour_mean / neighbours, 1e-4);
+                    double error = std::sqrt(variance / (e.samples() * mean));
+                    converged[j * region_width + i] = error <= adaptive_threshold || e.samples() + batch > max_samples;
                 }
-                final_color /= nb_samples;
-                img_result.set_pixel(j, i, final_color);
+            }
+
+            active = false;
+            for (size_t p = 0; p < accumulation.pixels.size(); ++p)
+            {
+                accumulation.pixels[p].done = accumulation.pixels[p].done || converged[p];
+                active = active || !accumulation.pixels[p].done;
             }
         }
-        return img_result;
+
+        if (!checkpoint_path.empty())
+            save_checkpoint();
+        size_t total_samples = accumulation.sample_count();
+        samples_taken = total_samples - resumed_samples;
+
+        std::clog << "Tiles: " << render_stats.tile_count << " on " << render_stats.busy_seconds.size()
+                  << " threads, " << render_stats.steals << " stolen, load imbalance "
+                  << render_stats.imbalance() << std::endl;
+        if (adaptive_sampling)
+            std::clog << "Adaptive sampling: " << double(total_samples) / accumulation.pixels.size()
+                      << " samples per pixel on average, at most " << max_samples << std::endl;
+        if (allocation_counting_enabled())
+            std::clog << "Heap allocations during render: " << allocations << std::endl;
+        return accumulation.resolve();
     }
 
-    vec3 camera::trace_ray(const ray &r, const hittable &world, const hittable &lights, size_t depth)
+    vec3 camera::sample_pixel(size_t i, size_t j, const hittable &world, const hittable &lights,
+                              size_t first_sample, size_t samples, running_stats *luminance, aov_sample *aovs) const
     {
-        if (depth <= 0)
-            return vec3(0, 0, 0);
+        vec3 sum(0, 0, 0);
+        size_t pixel = j * width + i;
+
+        for (size_t sample = first_sample; sample < first_sample + samples; ++sample)
+        {
+            // Key the generator on this sample so the result does not depend on scheduling.
+            thread_rng().begin_sample(seed, pixel, sample);
+            aov_sample first_hit;
+            vec3 color = trace_ray(generate_sample_ray(int(i), int(j), sample), world, lights, &first_hit);
+            sum += color;
+            if (aovs)
+                *aovs += first_hit;
+            if (luminance)
+                luminance->add(cobra::luminance(color));
+        }
+        return sum;
+    }
 
-        hit_record closest_hit;
-        double closest_so_far = std::numeric_limits<double>::infinity();
-        bool hit_anything = world.hit(r, interval(0.001, closest_so_far), closest_hit);
+    vec3 camera::trace_ray(const ray &r, const hittable &world, const hittable &lights, aov_sample *first_hit) const
+    {
+        path_state path;
+        path.r = r;
 
-        if (hit_anything)
+        while (path.bounce < depth)
         {
-            scatter_record srec;
-            vec3 emission = closest_hit.mat->emitted(r, closest_hit, closest_hit.u, closest_hit.v, closest_hit.point);
+            thread_rng().begin_bounce(path.bounce);
 
-            if (!closest_hit.mat->scatter(r, closest_hit, srec))
-                return emission;
-            if (srec.skip_pdf)
+            hit_record closest_hit;
+            COBRA_COUNT(rays);
+            if (!world.hit(path.r, interval(0.001, infinity), closest_hit))
             {
-                return srec.attenuation * trace_ray(srec.skip_pdf_ray, world, lights, depth - 1);
+                path.radiance += path.throughput * background;
+                break;
             }
 
-            auto light_ptr = make_shared<hittable_pdf>(lights, closest_hit.point);
-            mixture_pdf p(light_ptr, srec.pdf_ptr);
+            bool alive = shade(path, closest_hit, lights);
+            path.resolve_shadow(world);
+            if (!alive)
+                break;
+        }
 
-            ray scattered = ray(closest_hit.point, p.generate());
-            auto pdf_value = p.value(scattered.get_direction());
+        COBRA_PATH_LENGTH(path.bounce);
+        if (first_hit)
+            *first_hit = path.first_hit;
+        return path.radiance;
+    }
 
-            double scattering_pdf = closest_hit.mat->scattering_pdf(r, closest_hit, scattered);
+    void camera::sample_light(path_state &path, const hit_record &rec, const scatter_record &srec,
+                              const hittable &lights) const
+    {
+        // Densities are evaluated on the unit direction, as for the scattered rays.
+        ray shadow(rec.point, lights.random(rec.point));
+        const vec3 &direction = shadow.get_direction();
+        double light_pdf = lights.pdf_value(rec.point, direction);
+        if (!(light_pdf > 0))
+            return;
+
+        // The light the direction leads to; the shadow ray stops just before it.
+        hit_record light_rec;
+        if (!lights.hit(shadow, interval(0.001, infinity), light_rec) || !light_rec.mat)
+            return;
+        vec3 emission = emitted(*light_rec.mat, shadow, light_rec, light_rec.u, light_rec.v, light_rec.point);
+        double density = scattering_pdf(*rec.mat, path.r, rec, shadow);
+        if (!(emission.max_component() > 0) || !(density > 0))
+            return;
+
+        double weight = power_heuristic(light_pdf, srec.scatter_pdf.value(direction));
+        path.shadow = shadow;
+        path.shadow_max = light_rec.t * (1 - shadow_epsilon);
+        path.shadow_radiance = path.throughput * srec.attenuation * emission * (density * weight / light_pdf);
+        path.shadow_pending = true;
+    }
 
-            return emission + (srec.attenuation * scattering_pdf * trace_ray(scattered, world, lights, depth - 1)) / pdf_value;
+    bool camera::shade(path_state &path, const hit_record &rec, const hittable &lights) const
+    {
+        const ray &r_in = path.r;
+        if (aovs && path.bounce == 0)
+            path.first_hit = {surface_albedo(*rec.mat, rec), rec.normal, rec.t * r_in.get_direction().length()};
+        vec3 emission = emitted(*rec.mat, r_in, rec, rec.u, rec.v, rec.point);
+        if (path.scatter_density > 0 && emission.max_component() > 0)
+        {
+            // The light could also have been reached by the shadow ray of the last bounce.
+            double light_pdf = lights.pdf_value(r_in.get_origin(), r_in.get_direction());
+            emission *= power_heuristic(path.scatter_density, light_pdf);
         }
+        path.radiance += path.throughput * emission;
 
-        return background;
-    }
+        scatter_record srec;
+        if (!scatter(*rec.mat, r_in, rec, srec))
+            return false;
 
-    double camera::fRand(double fMin, double fMax)
-    {
-        double f = (double)rand() / RAND_MAX;
-        return fMin + f * (fMax - fMin);
+        if (srec.skip_pdf)
+        {
+            path.throughput = path.throughput * srec.attenuation;
+            path.r = srec.skip_pdf_ray;
+            path.scatter_density = 0;
+        }
+        else if (next_event_estimation || !lights_emit)
+        {
+            if (lights_emit)
+                sample_light(path, rec, srec, lights);
+
+            ray scattered = ray(rec.point, srec.scatter_pdf.generate());
+            auto pdf_value = srec.scatter_pdf.value(scattered.get_direction());
+            if (!(pdf_value > 0))
+                return false;
+
+            double density = scattering_pdf(*rec.mat, r_in, rec, scattered);
+            path.throughput = path.throughput * srec.attenuation * (density / pdf_value);
+            path.r = scattered;
+            path.scatter_density = lights_emit ? pdf_value : 0;
+        }
+        else
+        {
+            mixture_pdf p(hittable_pdf(lights, rec.point), srec.scatter_pdf);
+
+            ray scattered = ray(rec.point, p.generate());
+            auto pdf_value = p.value(scattered.get_direction());
+            if (!(pdf_value > 0))
+                return false;
+
+            double density = scattering_pdf(*rec.mat, r_in, rec, scattered);
+            path.throughput = path.throughput * srec.attenuation * (density / pdf_value);
+            path.r = scattered;
+        }
+
+        ++path.bounce;
+
+        // Russian roulette: keep the path with a probability that follows its throughput,
+        // and divide by that probability so that the expected contribution is unchanged.
+        if (path.bounce >= russian_roulette_depth)
+        {
+            double survival = std::fmin(path.throughput.max_component(), 0.95);
+            if (!(random_double() < survival))
+                return false;
+            path.throughput /= survival;
+        }
+        return true;
     }
-}
\ No newline at end of file
+}
@@ -1,11 +1,65 @@
 #pragma once
 #include "core/ray.h"
 #include "core/vec3.h"
+#include "image/accumulation.h"
 #include "image/image.h"
 #include "scene/scene.h"
+#include "render/tile_scheduler.h"
+#include "core/running_stats.h"
+
+#include <atomic>
+#include <string>
 
 namespace cobra
 {
+    class scatter_record;
+
+    /**
+     * @brief State of a light path between two bounces.
+     */
+    struct path_state
+    {
+        ray r;                           ///< Ray to trace for the next bounce.
+        vec3 throughput = vec3(1, 1, 1); ///< Product of the weights of the bounces so far.
+        vec3 radiance = vec3(0, 0, 0);   ///< Light gathered so far.
+        size_t bounce = 0;               ///< Number of bounces already traced.
+        aov_sample first_hit;            ///< Features of the first hit, recorded when the camera's `aovs` is set.
+        /// Density of the direction of `r` when it was sampled from a material's distribution
+        /// with next-event estimation on; 0 for camera rays and specular bounces, whose
+        /// emission hits are not weighted against light sampling.
+        double scatter_density = 0;
+
+        bool shadow_pending = false;          ///< The last bounce left a shadow ray to test.
+        ray shadow;                           ///< Shadow ray toward the sampled light.
+        double shadow_max = 0;                ///< End of the shadow ray, just before the light.
+        vec3 shadow_radiance = vec3(0, 0, 0); ///< Added to `radiance` if `shadow` is unoccluded.
+
+        /// @brief Tests the pending shadow ray, if any, and adds its light when nothing blocks it.
+        void resolve_shadow(const hittable &world)
+        {
+            if (!shadow_pending)
+                return;
+            shadow_pending = false;
+            COBRA_COUNT(shadow_rays);
+            if (!world.occluded(shadow, interval(0.001, shadow_max)))
+                radiance += shadow_radiance;
+        }
+    };
+
+    /**
+     * @brief A batch of samples to trace through one pixel.
+     */
+    struct pixel_batch
+    {
+        uint32_t i;               ///< Pixel column.
+        uint32_t j;               ///< Pixel row.
+        size_t first_sample;      ///< Index of the first sample of the batch within the pixel.
+        uint32_t samples;         ///< Number of samples, at most one stratification grid.
+        running_stats *luminance; ///< If not null, receives the luminance of every sample.
+        vec3 sum = vec3(0, 0, 0); ///< Sum of the sample colors, filled by the integrator.
+        aov_sample aovs;          ///< Sum of the first-hit features, filled if the camera's `aovs` is set.
+    };
+
     /**
      * @class camera
      * @brief Represents a 3D camera for ray generation.
@@ -26,17 +80,9 @@ namespace cobra
         vec3 u, v, w;          ///< Camera frame basis vectors
         vec3 defocus_disk_u;   ///< Defocus disk horizontal radius
         vec3 defocus_disk_v;   ///< Defocus disk vertical radius
-        int sqrt_spp;          ///< Square root of number of samples per pixel
+        int sqrt_spp;          ///< Side of the stratification grid (of a batch in adaptive mode)
         double recip_sqrt_spp; ///< 1 / sqrt_spp
 
-        /**
-         * @brief Generate a random double in the range [fMin, fMax].
-         * @param fMin Minimum value.
-         * @param fMax Maximum value.
-         * @return Random double between fMin and fMax.
-         */
-        double fRand(double fMin, double fMax);
-
         /**
          * @brief Returns the vector to a random point in the [-.5,-.5]-[+.5,+.5] unit square.
          */
@@ -59,6 +105,7 @@ namespace cobra
         double aspect_ratio = 1.; ///< Aspect ratio.
         size_t nb_samples = 10;   ///< Number of samples for anti-aliasing.
         size_t depth = 10;        ///< Number of rebound for a primary ray.
+        size_t russian_roulette_depth = 3; ///< Bounces before Russian roulette may end a path.
 
         double vfov = 90;              ///< Vertical view angle (field of view)
         vec3 lookfrom = vec3(0, 0, 0); ///< Point camera is looking from
@@ -67,6 +114,32 @@ namespace cobra
         double defocus_angle = 0;      ///< Variation angle of rays through each pixel
         double focus_dist = 10;        ///< Distance from camera lookfrom point to plane of perfect focus
         vec3 background;               ///< Scene background color
+        uint64_t seed = 0;             ///< Seed of the per-sample random sequences
+        size_t nb_threads = 0;         ///< Render threads, 0 for all hardware threads
+        size_t tile_size = 16;         ///< Side of the square tiles handed to the threads
+
+        bool adaptive_sampling = false;    ///< Stop sampling a pixel once its estimate is precise enough
+        size_t adaptive_base_samples = 16; ///< Samples per batch in adaptive mode (rounded down to a square)
+        double adaptive_threshold = 0.02;  ///< Estimated error, after gamma encoding, at which a pixel is done
+
+        bool next_event_estimation = true; ///< Sample a light with a shadow ray at every non-specular hit
+
+        bool aovs = false; ///< Also accumulate the albedo, normal and depth of the first hits, for the denoiser
+
+        bool wavefront = false;          ///< Trace tiles with the wavefront_integrator instead of trace_ray
+        size_t wavefront_size = 1 << 14; ///< Maximum number of paths in flight per thread in wavefront mode
+
+        tile region = {0, 0, 0, 0}; ///< Pixels to render, [x0, x1) x [y0, y1) of the image; all of them if empty
+        size_t sample_offset = 0;   ///< Index of the first sample of every pixel, for processes that share pixels
+        size_t sample_count = 0;    ///< Samples per pixel from `sample_offset`, at most one batch; 0 for a whole batch (not in adaptive mode)
+
+        std::string checkpoint_path;                       ///< Accumulation file saved periodically, when stopped and at the end; empty for none
+        double checkpoint_interval = 60;                   ///< Seconds between two periodic checkpoints
+        const std::atomic<bool> *stop_request = nullptr;   ///< Once it is true, the render starts no new tile and returns early
+
+        tile_stats render_stats;  ///< Scheduling statistics of the last render
+        size_t samples_taken = 0; ///< Number of samples traced by the last render
+        bool interrupted = false; ///< The last render was stopped by `stop_request` before the end
 
         /**
          * @brief Constructs a camera.
@@ -76,15 +149,38 @@ namespace cobra
         /// Default destructor.
         ~camera();
 
+        /// Largest image a camera renders, in pixels.
+        static constexpr double max_pixels = double(size_t(1) << 28);
+
         /// @brief Initialize the empty params.
         void init();
 
+        /**
+         * @brief Checks the image size `width` and `aspect_ratio` lead to, before init() allocates it.
+         * @return False if the image is empty, or larger than max_pixels.
+         */
+        bool image_size_ok() const;
+
         /// @brief Get image width in pixels.
         size_t image_width() const { return width; }
 
         /// @brief Get image height in pixels.
         size_t image_height() const { return height; }
 
+        /// @brief Get the side of the stratification grid covered by one batch of samples.
+        int strata() const { return sqrt_spp; }
+
+        /**
+         * @brief Generates the ray of sample k of a pixel, through its cell of the stratification grid.
+         *
+         * The generator must already be keyed on the sample.
+         */
+        const ray generate_sample_ray(int i, int j, size_t sample) const
+        {
+            int cell = int(sample % size_t(sqrt_spp * sqrt_spp));
+            return generate_ray(i, j, cell % sqrt_spp, cell / sqrt_spp);
+        }
+
         /**
          * @brief Generate a ray from the camera passing through the viewport at coordinates (u,v).
          * @param u Horizontal coordinate normalized between 0 and 1.
@@ -95,17 +191,142 @@ namespace cobra
 
         /**
          * @brief Render the scene and produce the image.
+         *
+         * The image is split into tiles shared out by a tile_scheduler; the result does not
+         * depend on the number of threads. Paths are traced one at a time by trace_ray, or
+         * a tile at a time by a wavefront_integrator when `wavefront` is set; both give the
+         * same image.
+         *
+         * In adaptive mode, every pixel gets batches of `adaptive_base_samples` samples in
+         * successive passes, until its error estimate falls below `adaptive_threshold` or it
+         * reaches `nb_samples`. The error estimate is the standard error of the mean
+         * luminance over the square root of that mean, which approximates the error after
+         * gamma 2 encoding. The variance used is the larger of the pixel's own and the
+         * average over its 3x3 neighbourhood, so that a pixel whose first samples all missed
+         * a rare bright path does not stop too early.
+         *
          * @return Rendered image.
          */
         image render_image(const hittable &world, const hittable &lights);
 
+        /**
+         * @brief Renders the scene, continuing from the samples of an accumulation buffer.
+         *
+         * Samples are taken in passes over the image, a stratified batch per pixel; a
+         * plain render is a single pass. A pixel only gets the batches of the passes it
+         * is missing, so a render resumed from a checkpoint, even one saved in the middle
+         * of a pass, gives the same image as one that never stopped. A buffer that does not
+         * match the render (see can_resume()) is cleared first.
+         *
+         * Only the pixels of `region` are rendered, and the buffer and the image returned
+         * are the size of the region; the samples of a pixel are numbered from
+         * `sample_offset`. Adaptive sampling then only looks at neighbours inside the region.
+         * Without adaptive sampling, `sample_count` takes only part of the batch: processes
+         * that take [0, a), [a, b)... [c, batch) of the samples of a pixel trace together
+         * exactly the paths of a single render.
+         *
+         * With a `checkpoint_path`, the buffer is written there every
+         * `checkpoint_interval` seconds, between tiles, and once the render ends or is
+         * stopped through `stop_request`.
+         *
+         * @param accumulation Samples taken so far; receives the samples of the render.
+         * @return The mean of the samples of each pixel.
+         */
+        image render_image(const hittable &world, const hittable &lights, accumulation_buffer &accumulation);
+
+        /**
+         * @brief Tells whether a render would continue the samples of an accumulation buffer.
+         *
+         * The image size, the region, the sample offset, the seed, the batch size (from
+         * the samples per pixel, or `adaptive_base_samples`), the adaptive mode and whether
+         * AOVs are recorded must be the same.
+         */
+        bool can_resume(const accumulation_buffer &accumulation);
+
+        /**
+         * @brief Traces a batch of stratified samples through a pixel.
+         *
+         * Sample k of the pixel goes through cell k mod (sqrt_spp x sqrt_spp) of the
+         * stratification grid, row by row, so a batch of sqrt_spp^2 samples starting at a
+         * multiple of it covers the grid once. It is keyed on (seed, pixel, k), so batches
+         * can be taken in any order and on any thread.
+         *
+         * @param i Pixel column.
+         * @param j Pixel row.
+         * @param world Scene to trace in.
+         * @param lights Objects sampled towards for importance sampling.
+         * @param first_sample Index of the first sample of the batch within the pixel.
+         * @param samples Number of samples of the batch.
+         * @param luminance If not null, receives the luminance of every sample.
+         * @param aovs If not null, receives the sum of the first-hit features (see `aovs`).
+         * @return The sum of the sample colors.
+         */
+        vec3 sample_pixel(size_t i, size_t j, const hittable &world, const hittable &lights,
+                          size_t first_sample, size_t samples, running_stats *luminance, aov_sample *aovs = nullptr) const;
+
         /**
          * @brief Trace a ray through the scene to compute its color.
+         *
+         * Follows the path iteratively, for at most `depth` bounces, testing the shadow ray
+         * that shade() leaves after each bounce. After
+         * `russian_roulette_depth` bounces, paths are ended at random with a probability
+         * that grows as their throughput drops, and survivors are reweighted so that the
+         * estimate stays unbiased.
+         *
          * @param r Ray to trace.
-         * @param scene Scene to trace in.
-         * @param depth Current recursion depth.
+         * @param world Scene to trace in.
+         * @param lights Objects sampled towards for importance sampling.
+         * @param first_hit If not null, receives the features of the first hit (see `aovs`).
          * @return Computed color as vec3.
          */
-        vec3 trace_ray(const ray &r, const hittable &world, const hittable &lights, size_t depth);
+        vec3 trace_ray(const ray &r, const hittable &world, const hittable &lights, aov_sample *first_hit = nullptr) const;
+
+        /**
+         * @brief Shades one bounce of a path.
+         *
+         * Adds the emission at the hit point, scatters the ray, updates the throughput and
+         * plays Russian roulette. The features of a camera ray's hit are kept in
+         * path.first_hit when `aovs` is set.
+         *
+         * With `next_event_estimation`, a non-specular hit also samples a direction toward
+         * `lights` and leaves the light's contribution in a shadow ray for the caller to
+         * test (path_state::resolve_shadow), while the bounce itself follows the material's
+         * own distribution. The two estimates of the light are combined with the power
+         * heuristic: the shadow ray is weighted by the light density and the emission
+         * found by the next bounce by the material density, so that neither small
+         * lights nor glossy reflections of large ones are noisy. Without it, the bounce
+         * direction is drawn from an equal mixture of both densities, as before.
+         *
+         * Emitters that are not part of `lights` are assumed not to hide ones that are,
+         * since a shadow ray cannot tell them from any other blocker. When `lights` emit
+         * nothing (render_image checks emitted_power()), they are not sampled at all and the
+         * bounce follows the material alone.
+         *
+         * @param path The path, whose ray hit the scene.
+         * @param rec The hit of the path's ray.
+         * @param lights Objects sampled towards for importance sampling.
+         * @return True if the path continues with path.r, false if it ended.
+         */
+        bool shade(path_state &path, const hit_record &rec, const hittable &lights) const;
+
+    private:
+        bool lights_emit = false; ///< The lights of the render emit: shade() samples them.
+
+        /// @return `region` clipped to the image, or the whole image if it is empty.
+        tile clipped_region() const;
+
+        /**
+         * @brief Next-event estimation: samples a light from a hit and prepares the shadow ray.
+         *
+         * Leaves the path untouched when the sampled direction reaches no emitting part of
+         * a light, or one the material does not scatter toward.
+         *
+         * @param path The path; receives the shadow ray.
+         * @param rec The hit being shaded.
+         * @param srec The material's scattering at the hit.
+         * @param lights Objects sampled towards; they must carry their emitting materials.
+         */
+        void sample_light(path_state &path, const hit_record &rec, const scatter_record &srec,
+                          const hittable &lights) const;
     };
 }
@@ -6,6 +6,8 @@
 #include <limits>
 #include <memory>
 
+#include "core/random.h"
+
 // C++ Std Usings
 using std::make_shared;
 using std::shared_ptr;
@@ -20,9 +22,12 @@ namespace cobra
         return degrees * pi / 180.0;
     }
 
+    /**
+     * @brief Returns a uniformly distributed double in [0, 1) from the calling thread's generator.
+     */
     inline double random_double()
     {
-        return std::rand() / (RAND_MAX + 1.0);
+        return thread_rng().next_double();
     }
 
     inline double random_double(double min, double max)
@@ -10,15 +10,22 @@ namespace cobra
      *
      * The AABB is defined by three intervals—one for each axis (x, y, z).
      * It is primarily used for efficient ray-object intersection testing.
+     *
+     * @tparam T Scalar type of the bounds; the renderer uses aabb (see real).
      */
-    class aabb
+    template <typename T>
+    class basic_aabb
     {
     public:
+        using interval = basic_interval<T>; ///< Interval of the box's scalar type.
+        using vec3 = basic_vec3<T>;         ///< Vector of the box's scalar type.
+        using ray = basic_ray<T>;           ///< Ray of the box's scalar type.
+
         interval x, y, z; ///< Intervals along the x, y, and z axes.
 
         /// @brief Default constructor.
         /// Creates an empty AABB, as default-constructed intervals are empty.
-        aabb() {}
+        basic_aabb() {}
 
         /**
          * @brief Constructs an AABB from three axis-aligned intervals.
@@ -30,31 +37,28 @@ namespace cobra
          * @param y Interval along the y-axis.
          * @param z Interval along the z-axis.
          */
-        aabb(const interval &x, const interval &y, const interval &z)
+        basic_aabb(const interval &x, const interval &y, const interval &z)
             : x(x), y(y), z(z)
         {
-            double delta = 0.0001;
-            if (x.size() < delta)
-                this->x = x.expand(delta);
-            if (y.size() < delta)
-                this->y = y.expand(delta);
-            if (z.size() < delta)
-                this->z = z.expand(delta);
+            pad_to_minimums();
         }
 
         /**
          * @brief Constructs an AABB from two 3D points.
          *
          * The two points can be in any order; the constructor handles which has smaller/larger coordinates.
+         * Like the interval constructor, flat boxes (e.g. around an axis-aligned quad) are padded
+         * so that the slab test can still hit them.
          *
          * @param a First corner of the box.
          * @param b Opposite corner of the box.
          */
-        aabb(const vec3 &a, const vec3 &b)
+        basic_aabb(const vec3 &a, const vec3 &b)
         {
             x = (a[0] <= b[0]) ? interval(a[0], b[0]) : interval(b[0], a[0]);
             y = (a[1] <= b[1]) ? interval(a[1], b[1]) : interval(b[1], a[1]);
             z = (a[2] <= b[2]) ? interval(a[2], b[2]) : interval(b[2], a[2]);
+            pad_to_minimums();
         }
 
         /**
@@ -63,7 +67,7 @@ namespace cobra
          * @param box0 The first bounding box.
          * @param box1 The second bounding box.
          */
-        aabb(const aabb &box0, const aabb &box1)
+        basic_aabb(const basic_aabb &box0, const basic_aabb &box1)
         {
             x = interval(box0.x, box1.x);
             y = interval(box0.y, box1.y);
@@ -85,6 +89,38 @@ namespace cobra
             return x;
         }
 
+        /**
+         * @brief Returns the center of the box.
+         * @return The midpoint of the three intervals.
+         */
+        vec3 centroid() const
+        {
+            return vec3(0.5 * (x.min + x.max), 0.5 * (y.min + y.max), 0.5 * (z.min + z.max));
+        }
+
+        /**
+         * @brief Returns the surface area of the box, or 0 if it is empty.
+         * @return The area of the six faces.
+         */
+        T surface_area() const
+        {
+            T dx = x.size(), dy = y.size(), dz = z.size();
+            if (dx < 0 || dy < 0 || dz < 0)
+                return 0;
+            return 2 * (dx * dy + dy * dz + dz * dx);
+        }
+
+        /**
+         * @brief Returns the index of the axis along which the box is the widest.
+         * @return Axis index: 0 = x, 1 = y, 2 = z.
+         */
+        int longest_axis() const
+        {
+            if (x.size() > y.size())
+                return x.size() > z.size() ? 0 : 2;
+            return y.size() > z.size() ? 1 : 2;
+        }
+
         /**
          * @brief Determines whether a ray intersects the AABB.
          *
@@ -96,13 +132,15 @@ namespace cobra
          */
         bool hit(const ray &r, interval ray_t) const
         {
+            // Rounding of the distances must not make the ray miss a box it touches.
+            constexpr T tolerance = slab_tolerance<T>;
             const vec3 &ray_orig = r.get_origin();
             const vec3 &ray_dir = r.get_direction();
 
             for (int axis = 0; axis < 3; axis++)
             {
                 const interval &ax = axis_interval(axis);
-                const double adinv = 1.0 / ray_dir[axis];
+                const T adinv = 1 / ray_dir[axis];
 
                 auto t0 = (ax.min - ray_orig[axis]) * adinv;
                 auto t1 = (ax.max - ray_orig[axis]) * adinv;
@@ -111,15 +149,15 @@ namespace cobra
                 {
                     if (t0 > ray_t.min)
                         ray_t.min = t0;
-                    if (t1 < ray_t.max)
-                        ray_t.max = t1;
+                    if (t1 * tolerance < ray_t.max)
+                        ray_t.max = t1 * tolerance;
                 }
                 else
                 {
                     if (t1 > ray_t.min)
                         ray_t.min = t1;
-                    if (t0 < ray_t.max)
-                        ray_t.max = t0;
+                    if (t0 * tolerance < ray_t.max)
+                        ray_t.max = t0 * tolerance;
                 }
 
                 if (ray_t.max <= ray_t.min)
@@ -127,15 +165,32 @@ namespace cobra
             }
             return true;
         }
-    };
 
-    inline aabb operator+(const aabb &bbox, const vec3 &offset)
-    {
-        return aabb(bbox.x + offset.x(), bbox.y + offset.y(), bbox.z + offset.z());
-    }
+        /// Translates a box.
+        friend basic_aabb operator+(const basic_aabb &bbox, const vec3 &offset)
+        {
+            return basic_aabb(bbox.x + offset.x(), bbox.y + offset.y(), bbox.z + offset.z());
+        }
 
-    inline aabb operator+(const vec3 &offset, const aabb &bbox)
-    {
-        return bbox + offset;
-    }
+        friend basic_aabb operator+(const vec3 &offset, const basic_aabb &bbox)
+        {
+            return bbox + offset;
+        }
+
+    private:
+        /// Expands any side narrower than a small delta, to avoid degenerate boxes.
+        void pad_to_minimums()
+        {
+            T delta = T(0.0001);
+            if (x.size() < delta)
+                x = x.expand(delta);
+            if (y.size() < delta)
+                y = y.expand(delta);
+            if (z.size() < delta)
+                z = z.expand(delta);
+        }
+    };
+
+    /// Box of the renderer's scalar type.
+    using aabb = basic_aabb<real>;
 }
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @class alias_table
+     * @brief Samples an index in proportion to a weight in constant time (Vose's alias method).
+     *
+     * Each slot keeps the probability of returning its own index and an alias returned
+     * otherwise, so one uniform number picks a slot and then decides between the two.
+     */
+    class alias_table
+    {
+    public:
+        /// @brief Constructs an empty table.
+        alias_table() = default;
+
+        /**
+         * @brief Builds the table.
+         * @param weights Non-negative weight of each index. If they are all zero, every
+         * index gets the same probability.
+         */
+        explicit alias_table(const std::vector<double> &weights)
+        {
+            size_t n = weights.size();
+            slots.resize(n);
+            probabilities.resize(n);
+            if (n == 0)
+                return;
+
+            double total = 0;
+            for (double w : weights)
+                total += w;
+            for (size_t i = 0; i < n; ++i)
+                probabilities[i] = total > 0 ? weights[i] / total : 1.0 / n;
+
+            // Scaled so that the average slot holds exactly 1.
+            std::vector<double> scaled(n);
+            std::vector<uint32_t> small, large;
+            for (size_t i = 0; i < n; ++i)
+            {
+                scaled[i] = probabilities[i] * n;
+                (scaled[i] < 1 ? small : large).push_back(uint32_t(i));
+            }
+            while (!small.empty() && !large.empty())
+            {
+                uint32_t s = small.back(), l = large.back();
+                small.pop_back();
+                slots[s] = {scaled[s], l};
+                scaled[l] -= 1 - scaled[s];
+                if (scaled[l] < 1)
+                {
+                    large.pop_back();
+                    small.push_back(l);
+                }
+            }
+            // Whatever is left is 1 up to rounding.
+            for (uint32_t i : large)
+                slots[i] = {1.0, i};
+            for (uint32_t i : small)
+                slots[i] = {1.0, i};
+        }
+
+        /**
+         * @brief Picks an index.
+         * @param u Uniform number in [0, 1).
+         * @return An index, with probability pmf(index).
+         */
+        size_t sample(double u) const
+        {
+            double scaled = u * slots.size();
+            size_t i = size_t(scaled);
+            if (i >= slots.size())
+                i = slots.size() - 1;
+            return scaled - i < slots[i].probability ? i : slots[i].alias;
+        }
+
+        /// @return The probability of sampling index `i`.
+        double pmf(size_t i) const { return probabilities[i]; }
+
+        /// @return Number of indices.
+        size_t size() const { return slots.size(); }
+
+    private:
+        /// One slot: keep its own index with `probability`, else return `alias`.
+        struct slot
+        {
+            double probability = 1;
+            uint32_t alias = 0;
+        };
+
+        std::vector<slot> slots;
+        std::vector<double> probabilities; ///< Normalized weights.
+    };
+} // namespace cobra
@@ -0,0 +1,64 @@
+#include "core/allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace cobra
+{
+#ifdef COBRA_COUNT_ALLOCATIONS
+    namespace
+    {
+        std::atomic<uint64_t> allocations{0};
+        thread_local uint64_t thread_allocations = 0;
+
+        void *counted_alloc(std::size_t size)
+        {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            ++thread_allocations;
+            if (void *p = std::malloc(size ? size : 1))
+                return p;
+            throw std::bad_alloc();
+        }
+
+        void *counted_aligned_alloc(std::size_t size, std::align_val_t alignment)
+        {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            ++thread_allocations;
+            std::size_t align = std::size_t(alignment);
+            std::size_t rounded = (size + align - 1) / align * align;
+            if (void *p = std::aligned_alloc(align, rounded ? rounded : align))
+                return p;
+            throw std::bad_alloc();
+        }
+    } // namespace
+
+    bool allocation_counting_enabled() { return true; }
+
+    uint64_t allocation_count() { return allocations.load(std::memory_order_relaxed); }
+
+    uint64_t thread_allocation_count() { return thread_allocations; }
+#else
+    bool allocation_counting_enabled() { return false; }
+
+    uint64_t allocation_count() { return 0; }
+
+    uint64_t thread_allocation_count() { return 0; }
+#endif
+} // namespace cobra
+
+#ifdef COBRA_COUNT_ALLOCATIONS
+void *operator new(std::size_t size) { return cobra::counted_alloc(size); }
+void *operator new[](std::size_t size) { return cobra::counted_alloc(size); }
+void *operator new(std::size_t size, std::align_val_t alignment) { return cobra::counted_aligned_alloc(size, alignment); }
+void *operator new[](std::size_t size, std::align_val_t alignment) { return cobra::counted_aligned_alloc(size, alignment); }
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+
+namespace cobra
+{
+    /**
+     * @brief Tells whether heap allocations are counted.
+     *
+     * Counting replaces the global operator new, so it is only compiled in when the
+     * COBRA_COUNT_ALLOCATIONS CMake option is on.
+     *
+     * @return True if allocation_count() is meaningful.
+     */
+    bool allocation_counting_enabled();
+
+    /**
+     * @brief Returns the number of heap allocations made so far by all threads.
+     * @return The allocation count, always 0 when counting is disabled.
+     */
+    uint64_t allocation_count();
+
+    /**
+     * @brief Returns the number of heap allocations made so far by the calling thread.
+     * @return The allocation count, always 0 when counting is disabled.
+     */
+    uint64_t thread_allocation_count();
+} // namespace cobra
@@ -0,0 +1,448 @@
+#include "core/bvh_builder.h"
+#include "core/parallel_chunks.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <thread>
+
+namespace cobra
+{
+    namespace
+    {
+        /// One centroid bin of the SAH sweep.
+        struct sah_bin
+        {
+            aabb bbox;
+            uint32_t count = 0;
+        };
+
+        /// Index of the bin a centroid coordinate falls in.
+        size_t bin_index(double c, const interval &range, size_t bin_count)
+        {
+            auto b = size_t(bin_count * ((c - range.min) / range.size()));
+            return b < bin_count ? b : bin_count - 1;
+        }
+
+        /// Below this many primitives a build is not worth starting threads for.
+        constexpr size_t min_parallel_primitives = size_t(1) << 15;
+        /// Fewest primitives a thread is given to bin or measure near the root.
+        constexpr size_t min_chunk = size_t(1) << 14;
+        /// Subtree tasks per thread: enough to balance uneven subtrees, few enough to keep the top short.
+        constexpr size_t tasks_per_thread = 16;
+        /// Fewest primitives in a subtree task.
+        constexpr size_t min_task_size = 4096;
+
+        bvh_build_node make_leaf(const aabb &bbox, uint32_t start, uint32_t end)
+        {
+            bvh_build_node leaf;
+            leaf.bbox = bbox;
+            leaf.children[0] = leaf.children[1] = 0;
+            leaf.first_primitive = start;
+            leaf.primitive_count = end - start;
+            leaf.split_axis = 0;
+            return leaf;
+        }
+
+        bvh_build_node make_interior(const aabb &bbox, uint32_t left, uint32_t right, int axis)
+        {
+            bvh_build_node node;
+            node.bbox = bbox;
+            node.children[0] = left;
+            node.children[1] = right;
+            node.first_primitive = 0;
+            node.primitive_count = 0;
+            node.split_axis = axis;
+            return node;
+        }
+
+        /// Placeholder for the subtree of a task while the top of the tree is built.
+        bvh_build_node make_task_node(size_t task)
+        {
+            return make_interior(aabb(), uint32_t(task), uint32_t(task), -1);
+        }
+
+        bool is_task_node(const bvh_build_node &node) { return !node.is_leaf() && node.split_axis < 0; }
+    }
+
+    struct bvh_builder::range_bounds
+    {
+        aabb bbox;
+        /// Kept unpadded: an empty extent means the centroids coincide.
+        interval centroids[3];
+
+        void add(const aabb &box, const vec3 &c)
+        {
+            bbox = aabb(bbox, box);
+            for (int axis = 0; axis < 3; ++axis)
+                centroids[axis] = interval(centroids[axis], interval(c[axis], c[axis]));
+        }
+
+        void add(const range_bounds &other)
+        {
+            bbox = aabb(bbox, other.bbox);
+            for (int axis = 0; axis < 3; ++axis)
+                centroids[axis] = interval(centroids[axis], other.centroids[axis]);
+        }
+    };
+
+    struct bvh_builder::split
+    {
+        int axis = -1; ///< -1 if no SAH split was found.
+        size_t bin = 0; ///< Last bin of the left part.
+        double cost = infinity;
+    };
+
+    /// Bins and sweep buffer, allocated once per thread rather than per node.
+    struct bvh_builder::scratch
+    {
+        std::vector<sah_bin> bins[3];
+        std::vector<double> right_cost;
+
+        explicit scratch(size_t bin_count) : right_cost(bin_count)
+        {
+            for (auto &axis_bins : bins)
+                axis_bins.resize(bin_count);
+        }
+
+        void clear()
+        {
+            for (auto &axis_bins : bins)
+                std::fill(axis_bins.begin(), axis_bins.end(), sah_bin());
+        }
+
+        /// Adds the bins of another part of the same range; min, max and counts merge exactly.
+        void add(const scratch &other)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+                for (size_t b = 0; b < bins[axis].size(); ++b)
+                {
+                    bins[axis][b].bbox = aabb(bins[axis][b].bbox, other.bins[axis][b].bbox);
+                    bins[axis][b].count += other.bins[axis][b].count;
+                }
+        }
+    };
+
+    /// A subtree left to one thread, built into its own nodes.
+    struct bvh_builder::task
+    {
+        uint32_t start, end;
+        int depth;
+        std::vector<bvh_build_node> nodes;
+    };
+
+    bvh_builder::bvh_builder(const bvh_build_options &options) : opts(options)
+    {
+        opts.bin_count = std::max<size_t>(opts.bin_count, 2);
+        opts.max_leaf_size = std::min<size_t>(std::max<size_t>(opts.max_leaf_size, 1), 65535);
+        opts.primitive_block = std::max<size_t>(opts.primitive_block, 1);
+    }
+
+    double bvh_builder::blocks(size_t count) const
+    {
+        return double((count + opts.primitive_block - 1) / opts.primitive_block * opts.primitive_block);
+    }
+
+    bool bvh_builder::build(const std::vector<aabb> &bounds)
+    {
+        build_nodes.clear();
+        order.resize(bounds.size());
+        std::iota(order.begin(), order.end(), 0u);
+
+        if (bounds.empty())
+            return false;
+
+        size_t threads = opts.threads > 0 ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+        if (bounds.size() < min_parallel_primitives)
+            threads = 1;
+
+        centroids.resize(bounds.size());
+        size_t chunks = std::max<size_t>(1, std::min(threads, bounds.size() / min_chunk));
+        parallel_chunks(chunks, [&](size_t c)
+                        {
+                            for (size_t i = bounds.size() * c / chunks; i < bounds.size() * (c + 1) / chunks; ++i)
+                                centroids[i] = bounds[i].centroid(); });
+
+        if (threads > 1)
+            build_parallel(bounds, threads);
+        else
+        {
+            scratch work(opts.bin_count);
+            build_nodes.reserve(2 * bounds.size());
+            build_range(build_nodes, work, bounds, 0, uint32_t(bounds.size()), 0);
+        }
+
+        centroids.clear();
+        centroids.shrink_to_fit();
+        return true;
+    }
+
+    void bvh_builder::build_parallel(const std::vector<aabb> &bounds, size_t threads)
+    {
+        size_t task_size = std::max(bounds.size() / (threads * tasks_per_thread), min_task_size);
+        std::vector<bvh_build_node> top;
+        std::vector<task> tasks;
+        build_top(top, tasks, bounds, 0, uint32_t(bounds.size()), 0, threads, task_size);
+
+        // Largest subtrees first, so that no thread is left with a big one at the end.
+        std::vector<size_t> schedule(tasks.size());
+        std::iota(schedule.begin(), schedule.end(), size_t(0));
+        std::stable_sort(schedule.begin(), schedule.end(), [&](size_t a, size_t b)
+                         { return tasks[a].end - tasks[a].start > tasks[b].end - tasks[b].start; });
+        std::atomic<size_t> next(0);
+        parallel_chunks(std::min(threads, tasks.size()), [&](size_t)
+                        {
+                            scratch work(opts.bin_count);
+                            for (size_t i = next++; i < schedule.size(); i = next++)
+                            {
+                                task &t = tasks[schedule[i]];
+                                t.nodes.reserve(2 * size_t(t.end - t.start));
+                                build_range(t.nodes, work, bounds, t.start, t.end, t.depth);
+                            } });
+
+        // Both the top and the subtrees are in depth-first order: replacing each placeholder
+        // by its subtree, in place, gives the order of a serial build.
+        std::vector<uint32_t> position(top.size());
+        uint32_t node_count = 0;
+        for (size_t i = 0; i < top.size(); ++i)
+        {
+            position[i] = node_count;
+            node_count += is_task_node(top[i]) ? uint32_t(tasks[top[i].children[0]].nodes.size()) : 1;
+        }
+
+        build_nodes.reserve(node_count);
+        for (size_t i = 0; i < top.size(); ++i)
+        {
+            bvh_build_node node = top[i];
+            if (is_task_node(node))
+            {
+                uint32_t offset = position[i];
+                for (bvh_build_node sub : tasks[node.children[0]].nodes)
+                {
+                    if (!sub.is_leaf())
+                    {
+                        sub.children[0] += offset;
+                        sub.children[1] += offset;
+                    }
+                    build_nodes.push_back(sub);
+                }
+                std::vector<bvh_build_node>().swap(tasks[node.children[0]].nodes);
+                continue;
+            }
+            if (!node.is_leaf())
+            {
+                node.children[0] = position[node.children[0]];
+                node.children[1] = position[node.children[1]];
+            }
+            build_nodes.push_back(node);
+        }
+    }
+
+    bvh_builder::range_bounds bvh_builder::measure(const std::vector<aabb> &bounds, uint32_t start, uint32_t end) const
+    {
+        range_bounds range;
+        for (uint32_t i = start; i < end; ++i)
+            range.add(bounds[order[i]], centroids[order[i]]);
+        return range;
+    }
+
+    void bvh_builder::fill_bins(scratch &work, const std::vector<aabb> &bounds, uint32_t start, uint32_t end,
+                                const range_bounds &range) const
+    {
+        // One pass over the primitives fills the bins of all three axes.
+        bool active[3];
+        for (int axis = 0; axis < 3; ++axis)
+            active[axis] = range.centroids[axis].size() > 0;
+
+        const size_t bin_count = opts.bin_count;
+        for (uint32_t i = start; i < end; ++i)
+        {
+            uint32_t prim = order[i];
+            const aabb &box = bounds[prim];
+            const vec3 &c = centroids[prim];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (!active[axis])
+                    continue;
+                auto &bin = work.bins[axis][bin_index(c[axis], range.centroids[axis], bin_count)];
+                bin.bbox = aabb(bin.bbox, box);
+                bin.count++;
+            }
+        }
+    }
+
+    bvh_builder::split bvh_builder::best_split(scratch &work, const range_bounds &range, uint32_t count) const
+    {
+        // Evaluate every bin boundary on every axis and keep the cheapest split.
+        const size_t bin_count = opts.bin_count;
+        double area = range.bbox.surface_area();
+        double inv_area = area > 0 ? 1.0 / area : 1.0;
+        split best;
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (range.centroids[axis].size() <= 0)
+                continue;
+            const std::vector<sah_bin> &bins = work.bins[axis];
+
+            // Sweep from the right to get the cost of everything above each boundary.
+            aabb right_box;
+            uint32_t right_count = 0;
+            for (size_t b = bin_count - 1; b > 0; --b)
+            {
+                right_box = aabb(right_box, bins[b].bbox);
+                right_count += bins[b].count;
+                work.right_cost[b - 1] = blocks(right_count) * right_box.surface_area();
+            }
+
+            // Then from the left, splitting between bin b and bin b + 1.
+            aabb left_box;
+            uint32_t left_count = 0;
+            for (size_t b = 0; b + 1 < bin_count; ++b)
+            {
+                left_box = aabb(left_box, bins[b].bbox);
+                left_count += bins[b].count;
+                if (left_count == 0 || left_count == count)
+                    continue;
+
+                double cost = opts.traversal_cost +
+                              opts.intersection_cost * (blocks(left_count) * left_box.surface_area() + work.right_cost[b]) * inv_area;
+                if (cost < best.cost)
+                {
+                    best.cost = cost;
+                    best.axis = axis;
+                    best.bin = b;
+                }
+            }
+        }
+        return best;
+    }
+
+    uint32_t bvh_builder::partition(uint32_t start, uint32_t end, split &s, const range_bounds &range)
+    {
+        if (s.axis < 0)
+        {
+            // Too deep, or all centroids coincide: cut the range in half along the widest axis.
+            uint32_t mid = start + (end - start) / 2;
+            int axis = 0;
+            for (int a = 1; a < 3; ++a)
+                if (range.centroids[a].size() > range.centroids[axis].size())
+                    axis = a;
+            s.axis = axis;
+            std::nth_element(order.begin() + start, order.begin() + mid, order.begin() + end,
+                             [&](uint32_t a, uint32_t b)
+                             { return centroids[a][axis] < centroids[b][axis]; });
+            return mid;
+        }
+
+        const interval &centroid_range = range.centroids[s.axis];
+        const size_t bin_count = opts.bin_count;
+        auto it = std::partition(order.begin() + start, order.begin() + end, [&](uint32_t prim)
+                                 { return bin_index(centroids[prim][s.axis], centroid_range, bin_count) <= s.bin; });
+        return uint32_t(it - order.begin());
+    }
+
+    uint32_t bvh_builder::build_range(std::vector<bvh_build_node> &nodes, scratch &work, const std::vector<aabb> &bounds,
+                                      uint32_t start, uint32_t end, int depth)
+    {
+        range_bounds range = measure(bounds, start, end);
+        uint32_t count = end - start;
+        if (count == 1)
+        {
+            nodes.push_back(make_leaf(range.bbox, start, end));
+            return uint32_t(nodes.size() - 1);
+        }
+
+        split s;
+        if (depth < bvh_build_options::max_sah_depth)
+        {
+            work.clear();
+            fill_bins(work, bounds, start, end, range);
+            s = best_split(work, range, count);
+        }
+
+        double leaf_cost = opts.intersection_cost * blocks(count);
+        if (count <= opts.max_leaf_size && (s.axis < 0 || leaf_cost <= s.cost))
+        {
+            nodes.push_back(make_leaf(range.bbox, start, end));
+            return uint32_t(nodes.size() - 1);
+        }
+
+        uint32_t mid = partition(start, end, s, range);
+        uint32_t index = uint32_t(nodes.size());
+        nodes.emplace_back();
+        uint32_t left = build_range(nodes, work, bounds, start, mid, depth + 1);
+        uint32_t right = build_range(nodes, work, bounds, mid, end, depth + 1);
+        nodes[index] = make_interior(range.bbox, left, right, s.axis);
+        return index;
+    }
+
+    uint32_t bvh_builder::build_top(std::vector<bvh_build_node> &nodes, std::vector<task> &tasks, const std::vector<aabb> &bounds,
+                                    uint32_t start, uint32_t end, int depth, size_t threads, size_t task_size)
+    {
+        uint32_t count = end - start;
+        if (count <= task_size)
+        {
+            nodes.push_back(make_task_node(tasks.size()));
+            tasks.push_back({start, end, depth, {}});
+            return uint32_t(nodes.size() - 1);
+        }
+
+        // The same decisions as build_range(), with the range cut into one part per thread.
+        size_t chunks = std::max<size_t>(1, std::min(threads, count / min_chunk));
+        auto chunk_start = [&](size_t c)
+        { return start + uint32_t(uint64_t(count) * c / chunks); };
+
+        std::vector<range_bounds> parts(chunks);
+        parallel_chunks(chunks, [&](size_t c)
+                        { parts[c] = measure(bounds, chunk_start(c), chunk_start(c + 1)); });
+        range_bounds range = parts[0];
+        for (size_t c = 1; c < chunks; ++c)
+            range.add(parts[c]);
+
+        split s;
+        if (depth < bvh_build_options::max_sah_depth)
+        {
+            std::vector<scratch> work(chunks, scratch(opts.bin_count));
+            parallel_chunks(chunks, [&](size_t c)
+                            { fill_bins(work[c], bounds, chunk_start(c), chunk_start(c + 1), range); });
+            for (size_t c = 1; c < chunks; ++c)
+                work[0].add(work[c]);
+            s = best_split(work[0], range, count);
+        }
+
+        double leaf_cost = opts.intersection_cost * blocks(count);
+        if (count <= opts.max_leaf_size && (s.axis < 0 || leaf_cost <= s.cost))
+        {
+            nodes.push_back(make_leaf(range.bbox, start, end));
+            return uint32_t(nodes.size() - 1);
+        }
+
+        uint32_t mid = partition(start, end, s, range);
+        uint32_t index = uint32_t(nodes.size());
+        nodes.emplace_back();
+        uint32_t left = build_top(nodes, tasks, bounds, start, mid, depth + 1, threads, task_size);
+        uint32_t right = build_top(nodes, tasks, bounds, mid, end, depth + 1, threads, task_size);
+        nodes[index] = make_interior(range.bbox, left, right, s.axis);
+        return index;
+    }
+
+    double bvh_builder::expected_cost() const
+    {
+        if (build_nodes.empty())
+            return 0;
+
+        double root_area = build_nodes[0].bbox.surface_area();
+        if (root_area <= 0)
+            return 0;
+
+        double cost = 0;
+        for (const auto &node : build_nodes)
+        {
+            double probability = node.bbox.surface_area() / root_area;
+            cost += probability * (node.is_leaf() ? opts.intersection_cost * blocks(node.primitive_count)
+                                                  : opts.traversal_cost);
+        }
+        return cost;
+    }
+} // namespace cobra
@@ -0,0 +1,130 @@
+#pragma once
+#include "core/aabb.h"
+#include "cobra.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief Tuning parameters of the surface area heuristic (SAH) BVH builder.
+     */
+    struct bvh_build_options
+    {
+        /// Depth after which the builder stops evaluating the SAH and splits at the object median,
+        /// so that the tree stays shallow enough for fixed-size traversal stacks.
+        static constexpr int max_sah_depth = 32;
+
+        size_t bin_count = 16;          ///< Number of centroid bins evaluated per axis.
+        size_t max_leaf_size = 4;       ///< Maximum number of primitives stored in a leaf (at most 65535).
+        double traversal_cost = 1.0;    ///< Relative cost of visiting an interior node.
+        double intersection_cost = 1.0; ///< Relative cost of testing one primitive.
+        size_t primitive_block = 1;     ///< Primitives tested together (SIMD packets); counts are rounded up to it.
+        size_t threads = 0;             ///< Build threads, 0 for the hardware concurrency; the tree does not depend on it.
+    };
+
+    /**
+     * @brief A node of a BVH under construction.
+     *
+     * Nodes live in a flat array. An interior node refers to its two children by index,
+     * a leaf refers to a range of the primitive order produced by the builder.
+     */
+    struct bvh_build_node
+    {
+        aabb bbox;                ///< Bounds of everything below the node.
+        uint32_t children[2];     ///< Child node indices (interior nodes only).
+        uint32_t first_primitive; ///< First entry in the primitive order (leaves only).
+        uint32_t primitive_count; ///< Number of primitives, 0 for interior nodes.
+        int split_axis;           ///< Axis the node was split along (interior nodes only).
+
+        /// @return True if the node is a leaf.
+        bool is_leaf() const { return primitive_count > 0; }
+    };
+
+    /**
+     * @class bvh_builder
+     * @brief Builds a BVH over a set of bounding boxes with the binned surface area heuristic.
+     *
+     * The builder only sees primitive bounds, so it can be shared by every acceleration
+     * structure of the renderer. Centroids are binned along each axis and the split of least
+     * expected cost is kept; a range becomes a leaf when splitting it is not worth it and it
+     * fits in `max_leaf_size` primitives.
+     *
+     * Large inputs are built in parallel. Near the root, where there are few ranges but
+     * many primitives each, the bounds and bins of a range are computed over chunks of it
+     * on every thread and merged; the ranges that get small enough become subtree tasks,
+     * handed out to the threads largest first, each with its own node array. The arrays
+     * are spliced back in depth-first order, so the tree is the same as a serial build,
+     * node for node.
+     */
+    class bvh_builder
+    {
+    public:
+        /**
+         * @brief Constructs a builder.
+         * @param options SAH parameters.
+         */
+        bvh_builder(const bvh_build_options &options = bvh_build_options());
+
+        /**
+         * @brief Builds the hierarchy.
+         *
+         * Node 0 is the root. The result is deterministic for a given input.
+         *
+         * @param bounds Bounding box of every primitive.
+         * @return True on success, false if there are no primitives.
+         */
+        bool build(const std::vector<aabb> &bounds);
+
+        /// @return The nodes of the hierarchy, root first.
+        const std::vector<bvh_build_node> &nodes() const { return build_nodes; }
+
+        /// @return Primitive indices in leaf order; leaves refer to ranges of it.
+        const std::vector<uint32_t> &primitive_order() const { return order; }
+
+        /**
+         * @brief Returns the SAH expected cost of tracing a ray through the hierarchy.
+         *
+         * Sum over the nodes of their traversal or intersection cost, weighted by the
+         * probability that a ray hitting the root also hits them (ratio of surface areas).
+         * Lower is better; use it to compare trees built from the same primitives.
+         */
+        double expected_cost() const;
+
+        /// @return The options the builder was created with.
+        const bvh_build_options &options() const { return opts; }
+
+    private:
+        struct range_bounds;
+        struct split;
+        struct scratch;
+        struct task;
+
+        bvh_build_options opts;
+        std::vector<bvh_build_node> build_nodes;
+        std::vector<uint32_t> order;
+        std::vector<vec3> centroids;
+
+        /// Builds the subtree of a range serially into `nodes`, returns its root index.
+        uint32_t build_range(std::vector<bvh_build_node> &nodes, scratch &work, const std::vector<aabb> &bounds,
+                             uint32_t start, uint32_t end, int depth);
+        /// Splits the top of the tree over every thread and leaves the rest to subtree tasks.
+        uint32_t build_top(std::vector<bvh_build_node> &nodes, std::vector<task> &tasks, const std::vector<aabb> &bounds,
+                           uint32_t start, uint32_t end, int depth, size_t threads, size_t task_size);
+        void build_parallel(const std::vector<aabb> &bounds, size_t threads);
+
+        /// Bounds of the primitives and of the centroids of a range.
+        range_bounds measure(const std::vector<aabb> &bounds, uint32_t start, uint32_t end) const;
+        /// Adds the primitives of a range to the bins of every axis worth splitting.
+        void fill_bins(scratch &work, const std::vector<aabb> &bounds, uint32_t start, uint32_t end,
+                       const range_bounds &range) const;
+        /// Sweeps the bins for the cheapest split of a range.
+        split best_split(scratch &work, const range_bounds &range, uint32_t count) const;
+        /// Reorders a range around a split, returns where the right part starts.
+        uint32_t partition(uint32_t start, uint32_t end, split &s, const range_bounds &range);
+
+        /// Primitive count rounded up to a whole number of blocks, as the SAH charges it.
+        double blocks(size_t count) const;
+    };
+} // namespace cobra
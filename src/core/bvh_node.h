@@ -1,19 +1,22 @@
 #pragma once
 #include "core/aabb.h"
+#include "core/bvh_builder.h"
+#include "core/linear_bvh.h"
 #include "geometry/hittable.h"
 #include "scene/scene.h"
 #include "cobra.h"
 
-#include <algorithm>
+#include <vector>
 
 namespace cobra
 {
     /**
      * @class bvh_node
-     * @brief A node in a Bounding Volume Hierarchy (BVH) for fast ray-object intersection.
+     * @brief A Bounding Volume Hierarchy (BVH) for fast ray-object intersection.
      *
-     * BVH is a binary tree structure that partitions the scene's hittable objects for efficient traversal.
-     * Each node stores a bounding box containing its child nodes or geometry.
+     * The hierarchy is built with the binned surface area heuristic (see bvh_builder), then
+     * flattened into a contiguous, pointer-free array of nodes (see linear_bvh). Only the
+     * objects in the leaves are reached through virtual calls.
      */
     class bvh_node : public hittable
     {
@@ -22,117 +25,113 @@ namespace cobra
          * @brief Constructs a BVH tree from a scene.
          *
          * Copies the hittable list from the scene and builds a hierarchical structure from it.
-         * 
+         *
          * @param world The scene containing hittable objects.
+         * @param options SAH build parameters.
          */
-        bvh_node(scene world)
-            : bvh_node(world.hittable_list, 0, world.hittable_list.size())
+        bvh_node(scene world, const bvh_build_options &options = bvh_build_options())
+            : bvh_node(world.hittable_list, 0, world.hittable_list.size(), options)
         {
             // C++ subtlety: this constructor copies hittable_list temporarily;
             // it's okay since the BVH structure gets built during the call.
         }
 
         /**
-         * @brief Recursively constructs a BVH from a subset of hittables.
-         *
-         * Selects a random axis (x, y, z), sorts the objects along that axis, and divides them.
+         * @brief Constructs a BVH over a subset of hittables.
          *
          * @param objects List of shared pointers to hittables.
          * @param start Start index (inclusive).
          * @param end End index (exclusive).
+         * @param options SAH build parameters.
          */
-        bvh_node(std::vector<shared_ptr<hittable>> &objects, size_t start, size_t end)
+        bvh_node(const std::vector<shared_ptr<hittable>> &objects, size_t start, size_t end,
+                 const bvh_build_options &options = bvh_build_options())
         {
-            int axis = random_int(0, 2);
-            auto comparator = (axis == 0) ? box_x_compare
-                              : (axis == 1) ? box_y_compare
-                                            : box_z_compare;
+            std::vector<aabb> bounds;
+            bounds.reserve(end - start);
+            for (size_t i = start; i < end; ++i)
+                bounds.push_back(objects[i]->bounding_box());
 
-            size_t object_span = end - start;
+            bvh_builder builder(options);
+            if (!builder.build(bounds))
+                return;
 
-            if (object_span == 1)
-            {
-                left = right = objects[start];
-            }
-            else if (object_span == 2)
-            {
-                left = objects[start];
-                right = objects[start + 1];
-            }
-            else
+            tree = linear_bvh(builder);
+            cost = builder.expected_cost();
+            bbox = builder.nodes()[0].bbox;
+
+            objects_in_order.reserve(bounds.size());
+            primitives.reserve(bounds.size());
+            for (auto index : builder.primitive_order())
             {
-                std::sort(objects.begin() + start, objects.begin() + end, comparator);
-                auto mid = start + object_span / 2;
-                left = make_shared<bvh_node>(objects, start, mid);
-                right = make_shared<bvh_node>(objects, mid, end);
+                objects_in_order.push_back(objects[start + index]);
+                primitives.push_back(objects[start + index].get());
             }
-
-            bbox = aabb(left->bounding_box(), right->bounding_box());
         }
 
         /**
          * @brief Tests if a ray hits any object in the BVH.
          *
-         * First tests the bounding box. If successful, recursively tests child nodes.
-         *
          * @param r The incoming ray.
          * @param ray_t The valid interval for ray parameter t.
          * @param rec The hit record to store intersection info.
-         * @return True if the ray hits any object in the subtree.
+         * @return True if the ray hits any object in the tree.
          */
         bool hit(const ray &r, interval ray_t, hit_record &rec) const override
         {
-            if (!bbox.hit(r, ray_t))
-                return false;
-
-            bool hit_left = left->hit(r, ray_t, rec);
-            bool hit_right = right->hit(r, interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+            return tree.traverse(r, ray_t, [&](uint32_t first, uint32_t count, interval &t)
+                                 {
+                                     bool hit_anything = false;
+                                     for (uint32_t i = first; i < first + count; ++i)
+                                     {
+                                         if (primitives[i]->hit(r, t, rec))
+                                         {
+                                             hit_anything = true;
+                                             t.max = rec.t;
+                                         }
+                                     }
+                                     return hit_anything; });
+        }
 
-            return hit_left || hit_right;
+        /**
+         * @brief Tells whether a ray hits any object, stopping at the first one found.
+         */
+        bool occluded(const ray &r, interval ray_t) const override
+        {
+            return tree.occluded(r, ray_t, [&](uint32_t first, uint32_t count, interval &t)
+                                 {
+                                     for (uint32_t i = first; i < first + count; ++i)
+                                         if (primitives[i]->occluded(r, t))
+                                             return true;
+                                     return false; });
         }
 
         /**
-         * @brief Returns the AABB bounding the entire subtree rooted at this node.
+         * @brief Returns the AABB bounding the entire tree.
          * @return The bounding box.
          */
         aabb bounding_box() const override { return bbox; }
 
-    private:
-        shared_ptr<hittable> left; ///< Left child node or object.
-        shared_ptr<hittable> right; ///< Right child node or object.
-        aabb bbox; ///< Bounding box for this node.
-
         /**
-         * @brief Compares two hittables based on their bounding box's minimum coordinate along an axis.
-         * @param a First hittable.
-         * @param b Second hittable.
-         * @param axis_index Axis (0 = x, 1 = y, 2 = z).
-         * @return True if a < b on the given axis.
+         * @brief Returns the SAH expected cost of a ray traversal, to compare trees.
+         * @return The cost in units of `intersection_cost`/`traversal_cost`.
          */
-        static bool box_compare(
-            const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis_index)
-        {
-            auto a_axis_interval = a->bounding_box().axis_interval(axis_index);
-            auto b_axis_interval = b->bounding_box().axis_interval(axis_index);
-            return a_axis_interval.min < b_axis_interval.min;
-        }
+        double expected_cost() const { return cost; }
 
-        /// Comparator for x-axis.
-        static bool box_x_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
-        {
-            return box_compare(a, b, 0);
-        }
+        /// @return Number of nodes in the tree.
+        size_t node_count() const { return tree.nodes().size(); }
 
-        /// Comparator for y-axis.
-        static bool box_y_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
-        {
-            return box_compare(a, b, 1);
-        }
+        /// @return The flattened hierarchy.
+        const linear_bvh &hierarchy() const { return tree; }
 
-        /// Comparator for z-axis.
-        static bool box_z_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b)
-        {
-            return box_compare(a, b, 2);
-        }
+        /// @return The objects in leaf order; leaves refer to ranges of this array.
+        const std::vector<const hittable *> &leaf_objects() const { return primitives; }
+
+    private:
+        linear_bvh tree;                                    ///< Flattened hierarchy.
+        std::vector<const hittable *> primitives;           ///< Leaf objects in leaf order, for traversal.
+        std::vector<shared_ptr<hittable>> objects_in_order; ///< Owns the objects of `primitives`.
+        aabb bbox;                                          ///< Bounding box of the whole tree.
+        double cost = 0;                                    ///< SAH expected traversal cost.
     };
 } // namespace cobra
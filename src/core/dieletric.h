@@ -5,15 +5,15 @@
 
 namespace cobra
 {
-    class dielectric : public material
+    class dielectric final : public material
     {
     public:
-        dielectric(double refraction_index) : refraction_index(refraction_index) {}
+        dielectric(double refraction_index) : material(material_kind::dielectric), refraction_index(refraction_index) {}
 
         bool scatter(const ray &r_in, const hit_record &rec, scatter_record &srec) const override
         {
+            COBRA_COUNT(dielectric_scatters);
             srec.attenuation = vec3(1.0, 1.0, 1.0);
-            srec.pdf_ptr = nullptr;
             srec.skip_pdf = true;      
             double ri = rec.front_face ? (1.0 / refraction_index) : refraction_index;
 
@@ -0,0 +1,175 @@
+#include "core/instrumentation.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace cobra
+{
+    const char *counter_name(counter c)
+    {
+        static const char *const names[] = {
+            "rays", "shadow_rays", "scene_tests", "bvh_nodes", "aabb_tests", "sphere_tests", "quad_tests",
+            "triangle_tests", "instance_tests", "lambertian_scatters", "metal_scatters",
+            "dielectric_scatters", "other_scatters"};
+        static_assert(sizeof(names) / sizeof(names[0]) == size_t(counter::count), "one name per counter");
+        return names[size_t(c)];
+    }
+
+    void instrumentation_counters::add(const instrumentation_counters &other)
+    {
+        for (size_t c = 0; c < size_t(counter::count); ++c)
+            values[c] += other.values[c];
+        for (size_t length = 0; length <= max_path_length; ++length)
+            path_lengths[length] += other.path_lengths[length];
+    }
+
+    void instrumentation_counters::print(std::ostream &out) const
+    {
+        for (size_t c = 0; c < size_t(counter::count); ++c)
+            if (values[c])
+                out << counter_name(counter(c)) << ": " << values[c] << "\n";
+
+        uint64_t paths = 0, bounces = 0;
+        for (size_t length = 0; length <= max_path_length; ++length)
+        {
+            paths += path_lengths[length];
+            bounces += path_lengths[length] * length;
+        }
+        if (paths == 0)
+            return;
+
+        out << "paths: " << paths << ", " << double(bounces) / paths << " bounces on average\n";
+        for (size_t length = 0; length <= max_path_length; ++length)
+            if (path_lengths[length])
+                out << "  " << length << (length == max_path_length ? "+" : "") << " bounces: "
+                    << path_lengths[length] << "\n";
+    }
+
+#ifdef COBRA_INSTRUMENTATION
+    namespace
+    {
+        const auto process_start = std::chrono::steady_clock::now();
+
+        /// Records of every thread that ever counted, in registration order.
+        struct registry
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<thread_instrumentation>> threads;
+        };
+
+        registry &instrumentation_registry()
+        {
+            static registry instance;
+            return instance;
+        }
+
+        /// @brief Writes `"key": value` pairs of the merged counters.
+        void write_counter_args(std::ostream &out, const instrumentation_counters &counters)
+        {
+            bool first = true;
+            for (size_t c = 0; c < size_t(counter::count); ++c)
+            {
+                out << (first ? "" : ", ") << "\"" << counter_name(counter(c)) << "\": " << counters.values[c];
+                first = false;
+            }
+            for (size_t length = 0; length <= max_path_length; ++length)
+                if (counters.path_lengths[length])
+                    out << ", \"paths_" << length << (length == max_path_length ? "+" : "") << "\": "
+                        << counters.path_lengths[length];
+        }
+    } // namespace
+
+    bool instrumentation_enabled() { return true; }
+
+    thread_instrumentation &register_instrumentation_thread()
+    {
+        registry &r = instrumentation_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.push_back(std::make_unique<thread_instrumentation>());
+        r.threads.back()->thread_id = uint32_t(r.threads.size() - 1);
+        return *r.threads.back();
+    }
+
+    int64_t trace_clock()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - process_start)
+            .count();
+    }
+
+    instrumentation_counters merged_counters()
+    {
+        registry &r = instrumentation_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        instrumentation_counters total;
+        for (const auto &thread : r.threads)
+            total.add(thread->counters);
+        return total;
+    }
+
+    void reset_instrumentation()
+    {
+        registry &r = instrumentation_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto &thread : r.threads)
+        {
+            thread->counters = instrumentation_counters();
+            thread->events.clear();
+        }
+    }
+
+    bool write_chrome_trace(const std::string &path, std::string *error)
+    {
+        instrumentation_counters counters = merged_counters();
+        std::ofstream out(path);
+        if (!out)
+        {
+            if (error)
+                *error = "cannot open " + path;
+            return false;
+        }
+
+        registry &r = instrumentation_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"cobra\"}}";
+        for (const auto &thread : r.threads)
+        {
+            if (thread->events.empty())
+                continue;
+            out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread->thread_id
+                << ", \"args\": {\"name\": \"thread " << thread->thread_id << "\"}}";
+            for (const trace_event &event : thread->events)
+                out << ",\n{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category
+                    << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->thread_id << ", \"ts\": " << event.start
+                    << ", \"dur\": " << event.duration << "}";
+        }
+        out << ",\n{\"name\": \"counters\", \"cat\": \"stats\", \"ph\": \"i\", \"s\": \"g\", \"pid\": 1, \"tid\": 0, "
+            << "\"ts\": " << trace_clock() << ", \"args\": {";
+        write_counter_args(out, counters);
+        out << "}}\n]}\n";
+
+        if (!out)
+        {
+            if (error)
+                *error = "cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+#else
+    bool instrumentation_enabled() { return false; }
+
+    instrumentation_counters merged_counters() { return instrumentation_counters(); }
+
+    void reset_instrumentation() {}
+
+    bool write_chrome_trace(const std::string &path, std::string *error)
+    {
+        if (error)
+            *error = "cannot write " + path + ": instrumentation is disabled (COBRA_INSTRUMENTATION)";
+        return false;
+    }
+#endif
+} // namespace cobra
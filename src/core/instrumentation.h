@@ -0,0 +1,164 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief Events counted by the instrumentation layer (see COBRA_COUNT).
+     */
+    enum class counter : int
+    {
+        rays,                ///< Path segments traced by the integrators.
+        shadow_rays,         ///< Shadow rays of next-event estimation.
+        scene_tests,         ///< Calls to scene::hit.
+        bvh_nodes,           ///< BVH nodes visited (binary or wide).
+        aabb_tests,          ///< Ray/box tests; a wide node tests all its children at once.
+        sphere_tests,        ///< Spheres tested, counting every lane of a sphere_set packet.
+        quad_tests,          ///< Calls to quad::hit.
+        triangle_tests,      ///< Triangles tested, counting every lane of a packet.
+        instance_tests,      ///< Rays transformed by instance, translate or rotate_y.
+        lambertian_scatters, ///< Calls to lambertian::scatter.
+        metal_scatters,      ///< Calls to metal::scatter.
+        dielectric_scatters, ///< Calls to dielectric::scatter.
+        other_scatters,      ///< Calls to the default material::scatter (lights).
+        count                ///< Number of counters.
+    };
+
+    /// @return The name of a counter, as printed and written in traces.
+    const char *counter_name(counter c);
+
+    /// Longest path length told apart in the histogram; longer paths share the last bin.
+    constexpr size_t max_path_length = 64;
+
+    /**
+     * @struct instrumentation_counters
+     * @brief Counter values, either of one thread or merged over all threads.
+     */
+    struct instrumentation_counters
+    {
+        uint64_t values[size_t(counter::count)] = {};  ///< Indexed by counter.
+        uint64_t path_lengths[max_path_length + 1] = {}; ///< Number of paths per bounce count.
+
+        /// @return The value of a counter.
+        uint64_t operator[](counter c) const { return values[size_t(c)]; }
+
+        /// @brief Adds the values of another set of counters.
+        void add(const instrumentation_counters &other);
+
+        /// @brief Prints the non-zero counters and the path length histogram.
+        void print(std::ostream &out) const;
+    };
+
+    /**
+     * @brief Tells whether the instrumentation is compiled in.
+     *
+     * The COBRA_COUNT and COBRA_TRACE_SPAN hooks expand to nothing unless the
+     * COBRA_INSTRUMENTATION CMake option is on, so they cost nothing in normal builds.
+     *
+     * @return True if the counters and traces are recorded.
+     */
+    bool instrumentation_enabled();
+
+    /// @return The counters of all threads merged, always zero when disabled.
+    instrumentation_counters merged_counters();
+
+    /// @brief Clears the counters and the recorded spans of every thread.
+    void reset_instrumentation();
+
+    /**
+     * @brief Writes the recorded spans as a Chrome `trace_event` JSON file.
+     *
+     * The file opens in chrome://tracing or Perfetto. The merged counters are attached
+     * as the arguments of a final instant event.
+     *
+     * @param path Output file.
+     * @param error If not null, receives a message when writing fails.
+     * @return True on success; false also when the instrumentation is disabled.
+     */
+    bool write_chrome_trace(const std::string &path, std::string *error = nullptr);
+
+#ifdef COBRA_INSTRUMENTATION
+    /**
+     * @struct trace_event
+     * @brief A completed timing span.
+     */
+    struct trace_event
+    {
+        const char *name;     ///< Span name, a string literal.
+        const char *category; ///< Span category, a string literal.
+        int64_t start;        ///< Start, in microseconds since the process started.
+        int64_t duration;     ///< Duration in microseconds.
+    };
+
+    /**
+     * @struct thread_instrumentation
+     * @brief What one thread records; owned by a global registry so that it outlives the thread.
+     */
+    struct thread_instrumentation
+    {
+        instrumentation_counters counters; ///< Counters of the thread.
+        std::vector<trace_event> events;   ///< Spans of the thread, in completion order.
+        uint32_t thread_id = 0;            ///< Index of the thread in the registry.
+    };
+
+    /// @brief Registers the calling thread; called once per thread by local_instrumentation().
+    thread_instrumentation &register_instrumentation_thread();
+
+    /// @return The record of the calling thread.
+    inline thread_instrumentation &local_instrumentation()
+    {
+        thread_local thread_instrumentation *local = &register_instrumentation_thread();
+        return *local;
+    }
+
+    /// @return Microseconds elapsed since the process started.
+    int64_t trace_clock();
+
+    /**
+     * @class trace_span
+     * @brief Records the lifetime of a scope as a span of the calling thread.
+     */
+    class trace_span
+    {
+    public:
+        trace_span(const char *name, const char *category) : name(name), category(category), start(trace_clock()) {}
+
+        ~trace_span()
+        {
+            local_instrumentation().events.push_back({name, category, start, trace_clock() - start});
+        }
+
+        trace_span(const trace_span &) = delete;
+        trace_span &operator=(const trace_span &) = delete;
+
+    private:
+        const char *name;
+        const char *category;
+        int64_t start;
+    };
+
+#define COBRA_INSTRUMENTATION_CONCAT_(a, b) a##b
+#define COBRA_INSTRUMENTATION_CONCAT(a, b) COBRA_INSTRUMENTATION_CONCAT_(a, b)
+
+/// Adds `n` to a counter of the calling thread.
+#define COBRA_COUNT_N(name, n) \
+    (::cobra::local_instrumentation().counters.values[size_t(::cobra::counter::name)] += uint64_t(n))
+/// Increments a counter of the calling thread.
+#define COBRA_COUNT(name) COBRA_COUNT_N(name, 1)
+/// Records the number of bounces of a finished path.
+#define COBRA_PATH_LENGTH(bounces) \
+    (++::cobra::local_instrumentation().counters.path_lengths[std::min<size_t>(bounces, ::cobra::max_path_length)])
+/// Times the rest of the enclosing scope as a span of the calling thread.
+#define COBRA_TRACE_SPAN(name, category) \
+    ::cobra::trace_span COBRA_INSTRUMENTATION_CONCAT(cobra_trace_span_, __LINE__)(name, category)
+#else
+#define COBRA_COUNT_N(name, n) ((void)0)
+#define COBRA_COUNT(name) ((void)0)
+#define COBRA_PATH_LENGTH(bounces) ((void)0)
+#define COBRA_TRACE_SPAN(name, category) ((void)0)
+#endif
+} // namespace cobra
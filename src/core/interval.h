@@ -5,36 +5,39 @@
 namespace cobra
 {
     /**
-     * @class interval
+     * @class basic_interval
      * @brief Represents a 1D interval on the real number line.
      *
      * Used for bounding ranges, such as in axis-aligned bounding boxes (AABB) or for clamping values.
      * An interval can be empty or cover the entire real line.
+     *
+     * @tparam T Scalar type of the bounds; the renderer uses interval (see real).
      */
-    class interval
+    template <typename T>
+    class basic_interval
     {
     public:
-        double min; ///< Minimum value of the interval.
-        double max; ///< Maximum value of the interval.
+        T min; ///< Minimum value of the interval.
+        T max; ///< Maximum value of the interval.
 
         /**
          * @brief Default constructor: creates an empty interval.
          */
-        interval() : min(+infinity), max(-infinity) {}
+        basic_interval() : min(+infinity), max(-infinity) {}
 
         /**
          * @brief Constructs an interval from a minimum and a maximum.
          * @param min Minimum value.
          * @param max Maximum value.
          */
-        interval(double min, double max) : min(min), max(max) {}
+        basic_interval(T min, T max) : min(min), max(max) {}
 
         /**
          * @brief Constructs the smallest interval that contains both input intervals.
          * @param a First interval.
          * @param b Second interval.
          */
-        interval(const interval &a, const interval &b)
+        basic_interval(const basic_interval &a, const basic_interval &b)
         {
             min = a.min <= b.min ? a.min : b.min;
             max = a.max >= b.max ? a.max : b.max;
@@ -44,7 +47,7 @@ namespace cobra
          * @brief Returns the size (length) of the interval.
          * @return max - min.
          */
-        double size() const
+        T size() const
         {
             return max - min;
         }
@@ -54,7 +57,7 @@ namespace cobra
          * @param x The value to check.
          * @return True if min <= x <= max.
          */
-        bool contains(double x) const
+        bool contains(T x) const
         {
             return min <= x && x <= max;
         }
@@ -64,7 +67,7 @@ namespace cobra
          * @param x The value to check.
          * @return True if min < x < max.
          */
-        bool surrounds(double x) const
+        bool surrounds(T x) const
         {
             return min < x && x < max;
         }
@@ -74,7 +77,7 @@ namespace cobra
          * @param x The value to clamp.
          * @return x clamped between min and max.
          */
-        double clamp(double x) const
+        T clamp(T x) const
         {
             if (x < min)
                 return min;
@@ -88,44 +91,49 @@ namespace cobra
          * @param delta Total amount to expand the interval.
          * @return A new interval expanded by delta.
          */
-        interval expand(double delta) const
+        basic_interval expand(T delta) const
         {
             auto padding = delta / 2;
-            return interval(min - padding, max + padding);
+            return basic_interval(min - padding, max + padding);
         }
 
         /// A constant representing the empty interval.
-        static const interval empty;
+        static const basic_interval empty;
 
         /// A constant representing the full universe interval (-∞, +∞).
-        static const interval universe;
+        static const basic_interval universe;
+
+        /**
+         * @brief Shifts an interval by a constant displacement.
+         * @param ival The interval to shift.
+         * @param displacement The amount to shift.
+         * @return A new interval shifted by the given amount.
+         */
+        friend basic_interval operator+(const basic_interval &ival, T displacement)
+        {
+            return basic_interval(ival.min + displacement, ival.max + displacement);
+        }
+
+        /**
+         * @brief Shifts an interval by a constant displacement (commutative overload).
+         * @param displacement The amount to shift.
+         * @param ival The interval to shift.
+         * @return A new interval shifted by the given amount.
+         */
+        friend basic_interval operator+(T displacement, const basic_interval &ival)
+        {
+            return ival + displacement;
+        }
     };
 
     /// Definition of the empty interval constant.
-    inline const interval interval::empty = interval(+infinity, -infinity);
+    template <typename T>
+    inline const basic_interval<T> basic_interval<T>::empty = basic_interval<T>(+infinity, -infinity);
 
     /// Definition of the universe interval constant.
-    inline const interval interval::universe = interval(-infinity, +infinity);
+    template <typename T>
+    inline const basic_interval<T> basic_interval<T>::universe = basic_interval<T>(-infinity, +infinity);
 
-    /**
-     * @brief Shifts an interval by a constant displacement.
-     * @param ival The interval to shift.
-     * @param displacement The amount to shift.
-     * @return A new interval shifted by the given amount.
-     */
-    inline interval operator+(const interval &ival, double displacement)
-    {
-        return interval(ival.min + displacement, ival.max + displacement);
-    }
-
-    /**
-     * @brief Shifts an interval by a constant displacement (commutative overload).
-     * @param displacement The amount to shift.
-     * @param ival The interval to shift.
-     * @return A new interval shifted by the given amount.
-     */
-    inline interval operator+(double displacement, const interval &ival)
-    {
-        return ival + displacement;
-    }
+    /// Interval of the renderer's scalar type.
+    using interval = basic_interval<real>;
 }
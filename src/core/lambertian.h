@@ -17,7 +17,7 @@ namespace cobra
      * When a ray hits a Lambertian surface, it is scattered in a random direction
      * biased by the surface normal.
      */
-    class lambertian : public material
+    class lambertian final : public material
     {
     private:
         shared_ptr<texture> tex; ///< The surface texture.
@@ -26,8 +26,8 @@ namespace cobra
          * @brief Constructs a Lambertian material with the given albedo.
          * @param albedo The color that the surface reflects.
          */
-        lambertian(const vec3 &albedo) : tex(make_shared<solid_color>(albedo)) {}
-        lambertian(std::shared_ptr<texture> tex) : tex(tex) {}
+        lambertian(const vec3 &albedo) : material(material_kind::lambertian), tex(make_shared<solid_color>(albedo)) {}
+        lambertian(std::shared_ptr<texture> tex) : material(material_kind::lambertian), tex(tex) {}
 
         /**
          * @brief Determines how the incoming ray is scattered upon hitting the surface.
@@ -39,11 +39,12 @@ namespace cobra
          * @param pdf The value of the pdf, for importance sampling.
          * @return true Always returns true for Lambertian surfaces.
          */
-        virtual bool scatter(const ray &r_in, const hit_record &rec, scatter_record &srec)
+        bool scatter(const ray &r_in, const hit_record &rec, scatter_record &srec)
         const override
         {
-            srec.attenuation = tex->value(rec.u,rec.v,rec.point);
-            srec.pdf_ptr = make_shared<cosine_pdf>(rec.normal);
+            COBRA_COUNT(lambertian_scatters);
+            srec.attenuation = texture_value(*tex, rec.u, rec.v, rec.point);
+            srec.scatter_pdf = cosine_pdf(rec.normal);
             srec.skip_pdf = false;
             return true;
         }
@@ -54,5 +55,7 @@ namespace cobra
             auto cos_theta = dot(rec.normal, unit_vector(scattered.get_direction()));
             return cos_theta < 0 ? 0 : cos_theta / pi;
         }
+
+        vec3 surface_albedo(const hit_record &rec) const override { return texture_value(*tex, rec.u, rec.v, rec.point); }
     };
 }
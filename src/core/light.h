@@ -12,21 +12,21 @@ namespace cobra
      * instead, it returns a color when its `emitted` function is called.
      * The light emission can be constant (solid color) or textured.
      */
-    class diffuse_light : public material
+    class diffuse_light final : public material
     {
     public:
         /**
          * @brief Constructs a diffuse light material using a texture.
          * @param tex A shared pointer to a texture representing light emission.
          */
-        diffuse_light(shared_ptr<texture> tex) : tex(tex) {}
+        diffuse_light(shared_ptr<texture> tex) : material(material_kind::diffuse_light), tex(tex) {}
 
         /**
          * @brief Constructs a diffuse light material using a constant color.
          * @param emit A vector representing the RGB emission color.
          */
         diffuse_light(const vec3 &emit)
-            : tex(make_shared<solid_color>(emit)) {}
+            : material(material_kind::diffuse_light), tex(make_shared<solid_color>(emit)) {}
 
         /**
          * @brief Returns the emitted color from the material at a point.
@@ -43,9 +43,12 @@ namespace cobra
         {
             if (!rec.front_face)
                 return vec3(0, 0, 0);
-            return tex->value(u, v, p);
+            return texture_value(*tex, u, v, p);
         }
 
+        /// @return The emission at the texture center, exact for a constant color.
+        vec3 emission() const override { return texture_value(*tex, 0.5, 0.5, vec3(0, 0, 0)); }
+
     private:
         shared_ptr<texture> tex; ///< Texture that defines the emission color.
     };
@@ -0,0 +1,279 @@
+#pragma once
+#include "core/aabb.h"
+#include "core/bvh_builder.h"
+#include "core/instrumentation.h"
+#include "core/interval.h"
+#include "core/ray.h"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief A 32-byte node of a flattened BVH.
+     *
+     * Bounds are stored in single precision, rounded outwards so that a box never shrinks.
+     * Nodes are laid out depth-first: the first child of an interior node immediately follows
+     * it, `offset` gives the index of the second one. For a leaf, `offset` is the first entry
+     * of the primitive range and `primitive_count` its length.
+     */
+    struct linear_bvh_node
+    {
+        float bounds_min[3];      ///< Lower corner of the node bounds.
+        float bounds_max[3];      ///< Upper corner of the node bounds.
+        uint32_t offset;          ///< Second child (interior) or first primitive (leaf).
+        uint16_t primitive_count; ///< Number of primitives, 0 for interior nodes.
+        uint8_t axis;             ///< Split axis of an interior node.
+        uint8_t pad;              ///< Unused, keeps the node at 32 bytes.
+
+        /// @return True if the node is a leaf.
+        bool is_leaf() const { return primitive_count > 0; }
+    };
+    static_assert(sizeof(linear_bvh_node) == 32, "linear_bvh_node must stay 32 bytes");
+
+    /**
+     * @brief Per-ray data reused by every box test of a traversal.
+     */
+    struct bvh_ray
+    {
+        vec3 origin;     ///< Ray origin.
+        vec3 inv_dir;    ///< Component-wise inverse of the ray direction.
+        int dir_neg[3];  ///< 1 when the direction is negative along an axis.
+
+        /**
+         * @brief Precomputes the inverse direction of a ray.
+         * @param r The ray to traverse with.
+         */
+        explicit bvh_ray(const ray &r) : origin(r.get_origin())
+        {
+            const vec3 &d = r.get_direction();
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                inv_dir[axis] = 1 / d[axis];
+                dir_neg[axis] = inv_dir[axis] < 0;
+            }
+        }
+    };
+
+    /**
+     * @class linear_bvh
+     * @brief Pointer-free BVH stored as a contiguous array of 32-byte nodes.
+     *
+     * Flattened from a bvh_builder result. It only knows about primitive ranges: the
+     * owner passes a callback that intersects the primitives of a leaf, so the same
+     * traversal serves every acceleration structure.
+     */
+    class linear_bvh
+    {
+    public:
+        /// Maximum depth the traversal stack can hold.
+        static constexpr int stack_size = 64;
+
+        /// @brief Constructs an empty hierarchy.
+        linear_bvh() {}
+
+        /**
+         * @brief Flattens the hierarchy held by a builder.
+         * @param builder A builder whose build() succeeded.
+         */
+        explicit linear_bvh(const bvh_builder &builder)
+        {
+            const auto &build_nodes = builder.nodes();
+            if (build_nodes.empty())
+                return;
+
+            linear_nodes.reserve(build_nodes.size());
+            flatten(build_nodes, 0);
+        }
+
+        /// @return True if the hierarchy has no node.
+        bool empty() const { return linear_nodes.empty(); }
+
+        /// @return The nodes, in depth-first order.
+        const std::vector<linear_bvh_node> &nodes() const { return linear_nodes; }
+
+        /**
+         * @brief Renumbers the primitive ranges of the leaves.
+         *
+         * Lets an owner that repacks its primitives per leaf (e.g. into SIMD packets) point
+         * the leaves at the new storage.
+         *
+         * @param remap Callable `uint32_t(uint32_t first, uint32_t count)` returning the new offset.
+         */
+        template <typename Remap>
+        void remap_leaves(Remap &&remap)
+        {
+            for (linear_bvh_node &node : linear_nodes)
+                if (node.is_leaf())
+                    node.offset = remap(node.offset, uint32_t(node.primitive_count));
+        }
+
+        /// @return The bounds of the root node.
+        aabb bounds() const
+        {
+            if (linear_nodes.empty())
+                return aabb();
+            const auto &root = linear_nodes[0];
+            return aabb(interval(root.bounds_min[0], root.bounds_max[0]),
+                        interval(root.bounds_min[1], root.bounds_max[1]),
+                        interval(root.bounds_min[2], root.bounds_max[2]));
+        }
+
+        /**
+         * @brief Slab test of a ray against the bounds of a node.
+         * @param node The node to test.
+         * @param r The precomputed ray.
+         * @param ray_t Valid range of the ray parameter.
+         * @return True if the ray overlaps the node within ray_t.
+         */
+        static bool hit_node(const linear_bvh_node &node, const bvh_ray &r, const interval &ray_t)
+        {
+            real t_min = ray_t.min;
+            real t_max = ray_t.max;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                real near_plane = r.dir_neg[axis] ? node.bounds_max[axis] : node.bounds_min[axis];
+                real far_plane = r.dir_neg[axis] ? node.bounds_min[axis] : node.bounds_max[axis];
+                real t0 = (near_plane - r.origin[axis]) * r.inv_dir[axis];
+                real t1 = (far_plane - r.origin[axis]) * r.inv_dir[axis] * slab_tolerance<real>;
+
+                // Written so that a NaN (ray in the plane of a face) leaves the range untouched.
+                t_min = t0 > t_min ? t0 : t_min;
+                t_max = t1 < t_max ? t1 : t_max;
+            }
+            return t_min <= t_max;
+        }
+
+        /**
+         * @brief Finds the closest hit along a ray.
+         *
+         * Stack-based traversal that visits the child on the ray's side of the split first,
+         * so that ray_t.max shrinks as early as possible.
+         *
+         * @param r The ray to trace.
+         * @param ray_t Valid range of t; ray_t.max is lowered to the closest hit found.
+         * @param leaf_hit Callable `bool(uint32_t first, uint32_t count, interval &ray_t)`
+         *        intersecting a primitive range and lowering ray_t.max on a hit.
+         * @return True if any primitive was hit.
+         */
+        template <typename LeafHit>
+        bool traverse(const ray &r, interval &ray_t, LeafHit &&leaf_hit) const
+        {
+            return search<false>(r, ray_t, leaf_hit);
+        }
+
+        /**
+         * @brief Tells whether a ray hits any primitive (shadow rays).
+         *
+         * Same traversal as traverse(), but it returns as soon as a leaf reports a hit.
+         *
+         * @param r The ray to trace.
+         * @param ray_t Valid range of t.
+         * @param leaf_hit Same callable as for traverse(); it may skip lowering ray_t.max.
+         * @return True if any primitive was hit.
+         */
+        template <typename LeafHit>
+        bool occluded(const ray &r, interval ray_t, LeafHit &&leaf_hit) const
+        {
+            return search<true>(r, ray_t, leaf_hit);
+        }
+
+    private:
+        std::vector<linear_bvh_node> linear_nodes; ///< Nodes in depth-first order.
+
+        /// Traversal of traverse() and occluded(); with `any_hit`, the first hit ends it.
+        template <bool any_hit, typename LeafHit>
+        bool search(const ray &r, interval &ray_t, LeafHit &leaf_hit) const
+        {
+            if (linear_nodes.empty())
+                return false;
+
+            bvh_ray rp(r);
+            uint32_t stack[stack_size];
+            int stack_top = 0;
+            uint32_t current = 0;
+            bool hit_anything = false;
+
+            while (true)
+            {
+                const linear_bvh_node &node = linear_nodes[current];
+                COBRA_COUNT(bvh_nodes);
+                COBRA_COUNT(aabb_tests);
+                if (hit_node(node, rp, ray_t))
+                {
+                    if (node.is_leaf())
+                    {
+                        if (leaf_hit(node.offset, node.primitive_count, ray_t))
+                        {
+                            if (any_hit)
+                                return true;
+                            hit_anything = true;
+                        }
+                    }
+                    else if (rp.dir_neg[node.axis])
+                    {
+                        stack[stack_top++] = current + 1;
+                        current = node.offset;
+                        continue;
+                    }
+                    else
+                    {
+                        stack[stack_top++] = node.offset;
+                        current = current + 1;
+                        continue;
+                    }
+                }
+                if (stack_top == 0)
+                    break;
+                current = stack[--stack_top];
+            }
+            return hit_anything;
+        }
+
+        /// Rounds a bound down to the nearest float that is not above it.
+        static float round_down(double v)
+        {
+            float f = float(v);
+            return double(f) > v ? std::nextafter(f, -INFINITY) : f;
+        }
+
+        /// Rounds a bound up to the nearest float that is not below it.
+        static float round_up(double v)
+        {
+            float f = float(v);
+            return double(f) < v ? std::nextafter(f, INFINITY) : f;
+        }
+
+        uint32_t flatten(const std::vector<bvh_build_node> &build_nodes, uint32_t index)
+        {
+            const bvh_build_node &build_node = build_nodes[index];
+            uint32_t linear_index = uint32_t(linear_nodes.size());
+            linear_nodes.emplace_back();
+
+            linear_bvh_node node = {};
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const interval &ival = build_node.bbox.axis_interval(axis);
+                node.bounds_min[axis] = round_down(ival.min);
+                node.bounds_max[axis] = round_up(ival.max);
+            }
+
+            if (build_node.is_leaf())
+            {
+                node.offset = build_node.first_primitive;
+                node.primitive_count = uint16_t(build_node.primitive_count);
+            }
+            else
+            {
+                node.axis = uint8_t(build_node.split_axis);
+                flatten(build_nodes, build_node.children[0]);
+                node.offset = flatten(build_nodes, build_node.children[1]);
+            }
+
+            linear_nodes[linear_index] = node;
+            return linear_index;
+        }
+    };
+} // namespace cobra
@@ -2,18 +2,42 @@
 #include "core/ray.h"
 #include "core/hit_record.h"
 #include "core/pdf.h"
+#include "core/instrumentation.h"
+
+#include <cstdint>
 
 namespace cobra
 
 {
 
+    /**
+     * @brief Result of a scattering event.
+     *
+     * The scattering density is stored by value, so filling a record never allocates.
+     */
     class scatter_record
     {
     public:
-        vec3 attenuation;
-        shared_ptr<pdf> pdf_ptr;
-        bool skip_pdf;
-        ray skip_pdf_ray;
+        vec3 attenuation; ///< Color attenuation of the scattered ray.
+        pdf scatter_pdf;  ///< Density the scattered direction is drawn from, unless skip_pdf.
+        bool skip_pdf;    ///< True for specular events, which use skip_pdf_ray directly.
+        ray skip_pdf_ray; ///< Scattered ray of a specular event.
+    };
+
+    /**
+     * @brief Concrete type of a material, used to dispatch without virtual calls.
+     *
+     * Every built-in material has its own kind; any other subclass of material is
+     * `custom` and goes through the virtual functions.
+     */
+    enum class material_kind : uint8_t
+    {
+        lambertian,    ///< cobra::lambertian
+        metal,         ///< cobra::metal
+        dielectric,    ///< cobra::dielectric
+        diffuse_light, ///< cobra::diffuse_light
+        custom,        ///< Any other material.
+        count          ///< Number of kinds.
     };
 
     /**
@@ -23,13 +47,23 @@ namespace cobra
      * Materials define how rays interact with surfaces. This base class provides the interface for
      * scattering behavior, such as reflection, refraction, or diffusion.
      * Derived classes must implement the `scatter` function to define their specific behavior.
+     *
+     * The built-in materials are final and tagged with their kind, so that the integrators
+     * call them through a switch (see material_dispatch.h) rather than through the virtual
+     * functions, which remain the extension point for custom materials.
      */
     class material
     {
     public:
+        /// @brief Constructs a custom material.
+        material() : _kind(material_kind::custom) {}
+
         /// Virtual destructor to ensure proper cleanup of derived material classes.
         virtual ~material() = default;
 
+        /// @return The concrete type of the material.
+        material_kind kind() const { return _kind; }
+
         /**
          * @brief Returns the emitted color from the material at a point.
          *
@@ -63,6 +97,7 @@ namespace cobra
          */
         virtual bool scatter(const ray &r_in, const hit_record &rec, scatter_record &srec) const
         {
+            COBRA_COUNT(other_scatters);
             return false;
         }
 
@@ -71,5 +106,33 @@ namespace cobra
         {
             return 0;
         }
+
+        /**
+         * @brief Typical emitted radiance, used to estimate the power of lights.
+         * @return Black for materials that do not emit.
+         */
+        virtual vec3 emission() const { return vec3(0, 0, 0); }
+
+        /**
+         * @brief Color the surface reflects at a hit, recorded in the albedo AOV.
+         *
+         * Only used to guide the denoiser, never for shading. Textured materials look the
+         * color up at the hit record; the others ignore it.
+         *
+         * @return White by default, as for materials that do not absorb light.
+         */
+        virtual vec3 surface_albedo(const hit_record &) const { return vec3(1, 1, 1); }
+
+    private:
+        friend class lambertian;
+        friend class metal;
+        friend class dielectric;
+        friend class diffuse_light;
+
+        /// @brief Constructs a built-in material. Private, so that no other subclass can
+        /// claim a kind and be downcast to the wrong type by the dispatch.
+        explicit material(material_kind kind) : _kind(kind) {}
+
+        material_kind _kind; ///< Concrete type, set once by the constructor.
     };
 }
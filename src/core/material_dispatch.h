@@ -0,0 +1,94 @@
+#pragma once
+#include "core/dieletric.h"
+#include "core/lambertian.h"
+#include "core/light.h"
+#include "core/material.h"
+#include "core/metal.h"
+
+namespace cobra
+{
+    /**
+     * @brief Emitted color of a material, the built-in materials being called directly.
+     *
+     * The built-in materials are final, so the qualified calls below are plain (inlinable)
+     * function calls; only custom materials go through the virtual table. The integrators
+     * call these functions instead of the virtual members.
+     *
+     * @see material::emitted for the parameters.
+     */
+    inline vec3 emitted(const material &m, const ray &r_in, const hit_record &rec, double u, double v,
+                        const vec3 &p)
+    {
+        switch (m.kind())
+        {
+        case material_kind::lambertian:
+        case material_kind::metal:
+        case material_kind::dielectric:
+            return vec3(0, 0, 0);
+        case material_kind::diffuse_light:
+            return static_cast<const diffuse_light &>(m).diffuse_light::emitted(r_in, rec, u, v, p);
+        default:
+            return m.emitted(r_in, rec, u, v, p);
+        }
+    }
+
+    /**
+     * @brief Scatters a ray on a material, the built-in materials being called directly.
+     * @see material::scatter for the parameters.
+     */
+    inline bool scatter(const material &m, const ray &r_in, const hit_record &rec, scatter_record &srec)
+    {
+        switch (m.kind())
+        {
+        case material_kind::lambertian:
+            return static_cast<const lambertian &>(m).lambertian::scatter(r_in, rec, srec);
+        case material_kind::metal:
+            return static_cast<const metal &>(m).metal::scatter(r_in, rec, srec);
+        case material_kind::dielectric:
+            return static_cast<const dielectric &>(m).dielectric::scatter(r_in, rec, srec);
+        case material_kind::diffuse_light:
+            return m.material::scatter(r_in, rec, srec);
+        default:
+            return m.scatter(r_in, rec, srec);
+        }
+    }
+
+    /**
+     * @brief Density of a scattered direction, the built-in materials being called directly.
+     * @see material::scattering_pdf for the parameters.
+     */
+    inline double scattering_pdf(const material &m, const ray &r_in, const hit_record &rec, const ray &scattered)
+    {
+        switch (m.kind())
+        {
+        case material_kind::lambertian:
+            return static_cast<const lambertian &>(m).lambertian::scattering_pdf(r_in, rec, scattered);
+        case material_kind::metal:
+        case material_kind::dielectric:
+        case material_kind::diffuse_light:
+            return m.material::scattering_pdf(r_in, rec, scattered);
+        default:
+            return m.scattering_pdf(r_in, rec, scattered);
+        }
+    }
+
+    /**
+     * @brief Albedo of a material at a hit, the built-in materials being called directly.
+     * @see material::surface_albedo for the parameters.
+     */
+    inline vec3 surface_albedo(const material &m, const hit_record &rec)
+    {
+        switch (m.kind())
+        {
+        case material_kind::lambertian:
+            return static_cast<const lambertian &>(m).lambertian::surface_albedo(rec);
+        case material_kind::metal:
+            return static_cast<const metal &>(m).metal::surface_albedo(rec);
+        case material_kind::dielectric:
+        case material_kind::diffuse_light:
+            return m.material::surface_albedo(rec);
+        default:
+            return m.surface_albedo(rec);
+        }
+    }
+} // namespace cobra
@@ -0,0 +1,52 @@
+#pragma once
+#include "core/material.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @class material_table
+     * @brief The materials of a scene, each stored once and referred to by a 32-bit index.
+     *
+     * Primitives that store many surfaces in packed arrays (sphere_set) keep a material
+     * index per surface instead of a shared pointer. The table also counts its materials
+     * per kind, which tells how many shading code paths a scene exercises.
+     */
+    class material_table
+    {
+    public:
+        /**
+         * @brief Adds a material, unless it is already in the table.
+         * @param mat The material.
+         * @return Its index.
+         */
+        uint32_t add(const std::shared_ptr<material> &mat)
+        {
+            auto found = index.emplace(mat.get(), uint32_t(materials.size()));
+            if (found.second)
+            {
+                materials.push_back(mat);
+                ++kind_counts[size_t(mat->kind())];
+            }
+            return found.first->second;
+        }
+
+        /// @return The material of an index returned by add().
+        const material *operator[](uint32_t i) const { return materials[i].get(); }
+
+        /// @return Number of distinct materials.
+        size_t size() const { return materials.size(); }
+
+        /// @return Number of materials of a kind.
+        size_t count(material_kind kind) const { return kind_counts[size_t(kind)]; }
+
+    private:
+        std::vector<std::shared_ptr<material>> materials;      ///< Materials, by index.
+        std::unordered_map<const material *, uint32_t> index;  ///< Index of each material.
+        size_t kind_counts[size_t(material_kind::count)] = {}; ///< Materials per kind.
+    };
+} // namespace cobra
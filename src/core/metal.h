@@ -1,3 +1,4 @@
+#pragma once
 #include "core/material.h"
 #include "cobra.h"
 #include "core/hit_record.h"
@@ -11,7 +12,7 @@ namespace cobra
      * This material models specular reflection similar to that of polished metals.
      * The `fuzz` factor introduces imperfection to the reflection, simulating brushed or rough surfaces.
      */
-    class metal : public material
+    class metal final : public material
     {
     private:
         vec3 albedo; ///< The base color of the metal surface.
@@ -23,7 +24,7 @@ namespace cobra
          * @param albedo The reflective color of the metal.
          * @param fuzz The fuzziness factor (clamped to [0, 1] in practice).
          */
-        metal(const vec3 &albedo, double fuzz) : albedo(albedo), fuzz(fuzz) {}
+        metal(const vec3 &albedo, double fuzz) : material(material_kind::metal), albedo(albedo), fuzz(fuzz) {}
 
         /**
          * @brief Computes the reflection of the incoming ray on a metallic surface.
@@ -37,14 +38,16 @@ namespace cobra
          */
         bool scatter(const ray &r_in, const hit_record &rec, scatter_record &srec) const override
         {
+            COBRA_COUNT(metal_scatters);
             vec3 reflected = reflect(r_in.get_direction(), rec.normal);
 
             srec.attenuation = albedo;
-            srec.pdf_ptr = nullptr;
             srec.skip_pdf = true;
             srec.skip_pdf_ray = ray(rec.point, reflected);
 
             return true;
         }
+
+        vec3 surface_albedo(const hit_record &) const override { return albedo; }
     };
 }
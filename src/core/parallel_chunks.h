@@ -0,0 +1,39 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief Number of chunks to split a parallel job into.
+     * @param size Input size, in bytes, records or primitives.
+     * @param min_chunk Smallest chunk worth a thread of its own.
+     * @return At least 1, at most the hardware concurrency.
+     */
+    inline size_t chunk_count(size_t size, size_t min_chunk)
+    {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        return std::max<size_t>(1, std::min(threads, size / std::max<size_t>(1, min_chunk)));
+    }
+
+    /**
+     * @brief Calls `work(chunk)` for chunk = 0 .. count - 1, each on its own thread.
+     *
+     * The calling thread runs chunk 0. Returns once every chunk is done.
+     */
+    template <typename Work>
+    void parallel_chunks(size_t count, const Work &work)
+    {
+        std::vector<std::thread> pool;
+        pool.reserve(count > 0 ? count - 1 : 0);
+        for (size_t c = 1; c < count; ++c)
+            pool.emplace_back([&work, c]()
+                              { work(c); });
+        if (count > 0)
+            work(0);
+        for (auto &thread : pool)
+            thread.join();
+    }
+} // namespace cobra
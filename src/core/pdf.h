@@ -4,42 +4,44 @@
 #include "core/onb.h"
 #include "geometry/hittable.h"
 
+#include <variant>
+
 namespace cobra
 {
-    class pdf
-    {
-    public:
-        ~pdf() = default;
-        virtual double value(const vec3 &direction) const = 0;
-        virtual vec3 generate() const = 0;
-    };
-    class sphere_pdf : public pdf
+    /**
+     * @brief Uniform distribution of directions over the unit sphere.
+     */
+    class sphere_pdf
     {
     public:
         sphere_pdf() {}
 
-        double value(const vec3 &direction) const override
+        double value(const vec3 &direction) const
         {
             return 1 / (4 * pi);
         }
 
-        vec3 generate() const override
+        vec3 generate() const
         {
             return random_unit_vector();
         }
     };
-    class cosine_pdf : public pdf
+
+    /**
+     * @brief Cosine-weighted distribution of directions around a normal.
+     */
+    class cosine_pdf
     {
     public:
         cosine_pdf(const vec3 &w) : uvw(w) {}
 
-        double value(const vec3 &direction) const override
+        double value(const vec3 &direction) const
         {
             auto cosine_theta = dot(unit_vector(direction), uvw.w());
             return std::fmax(0, cosine_theta / pi);
         }
 
-        vec3 generate() const override
+        vec3 generate() const
         {
             return uvw.transform(random_cosine_direction());
         }
@@ -47,51 +49,103 @@ namespace cobra
     private:
         onb uvw;
     };
-    class hittable_pdf : public pdf
+
+    /**
+     * @brief Distribution of the directions from a point towards a set of objects.
+     *
+     * Only refers to the objects, which must outlive it.
+     */
+    class hittable_pdf
     {
     public:
         hittable_pdf(const hittable &objects, const vec3 &origin)
-            : objects(objects), origin(origin)
+            : objects(&objects), origin(origin)
         {
         }
 
-        double value(const vec3 &direction) const override
+        double value(const vec3 &direction) const
         {
-            return objects.pdf_value(origin, direction);
+            return objects->pdf_value(origin, direction);
         }
 
-        vec3 generate() const override
+        vec3 generate() const
         {
-            return objects.random(origin);
+            return objects->random(origin);
         }
 
     private:
-        const hittable &objects;
+        const hittable *objects;
         vec3 origin;
     };
-    class mixture_pdf : public pdf
+
+    /**
+     * @class pdf
+     * @brief A probability density over directions, held by value.
+     *
+     * Closed set of the distributions above, stored inline in a std::variant so that
+     * scattering builds and combines them on the stack, without heap allocation or
+     * reference counting.
+     */
+    class pdf
+    {
+    public:
+        /// @brief Constructs a uniform sphere distribution.
+        pdf() {}
+
+        pdf(const sphere_pdf &p) : p(p) {}
+        pdf(const cosine_pdf &p) : p(p) {}
+        pdf(const hittable_pdf &p) : p(p) {}
+
+        /**
+         * @brief Evaluates the density.
+         * @param direction The direction to evaluate, not necessarily normalized.
+         * @return The density of direction.
+         */
+        double value(const vec3 &direction) const
+        {
+            return std::visit([&](const auto &d)
+                              { return d.value(direction); },
+                              p);
+        }
+
+        /// @return A direction drawn from the distribution.
+        vec3 generate() const
+        {
+            return std::visit([](const auto &d)
+                              { return d.generate(); },
+                              p);
+        }
+
+    private:
+        std::variant<sphere_pdf, cosine_pdf, hittable_pdf> p;
+    };
+
+    /**
+     * @brief Equal-weight mixture of two densities, both held by value.
+     */
+    class mixture_pdf
     {
     public:
-        mixture_pdf(shared_ptr<pdf> p0, shared_ptr<pdf> p1)
+        mixture_pdf(const pdf &p0, const pdf &p1)
         {
             p[0] = p0;
             p[1] = p1;
         }
 
-        double value(const vec3 &direction) const override
+        double value(const vec3 &direction) const
         {
-            return 0.5 * p[0]->value(direction) + 0.5 * p[1]->value(direction);
+            return 0.5 * p[0].value(direction) + 0.5 * p[1].value(direction);
         }
 
-        vec3 generate() const override
+        vec3 generate() const
         {
             if (random_double() < 0.5)
-                return p[0]->generate();
+                return p[0].generate();
             else
-                return p[1]->generate();
+                return p[1].generate();
         }
 
     private:
-        shared_ptr<pdf> p[2];
+        pdf p[2];
     };
 } // namespace cobra
@@ -0,0 +1,143 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace cobra
+{
+    /**
+     * @class rng
+     * @brief Small PCG32 pseudo-random number generator.
+     *
+     * Every render thread owns one generator (see thread_rng()). Rather than carrying
+     * state from one pixel to the next, the renderer re-keys it from the pixel, sample
+     * and bounce indices of the path being traced. The numbers a path consumes therefore
+     * do not depend on which thread traces it, nor in which order, so renders are
+     * bit-identical whatever the thread count.
+     */
+    class rng
+    {
+    public:
+        /// Seed used by generators that were never explicitly keyed (e.g. scene setup).
+        static constexpr uint64_t default_seed = 0x853c49e6748fea9bULL;
+
+        /**
+         * @brief Constructs a generator on the given seed.
+         * @param seed Initial key.
+         */
+        constexpr rng(uint64_t seed = default_seed) : state(0), inc(1), key(seed)
+        {
+            reseed(seed, 0);
+        }
+
+        /**
+         * @brief 64-bit finalizer (splitmix64), used to decorrelate keys.
+         * @param x The value to hash.
+         * @return A well-mixed 64-bit value.
+         */
+        static constexpr uint64_t mix(uint64_t x)
+        {
+            x += 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return x ^ (x >> 31);
+        }
+
+        /**
+         * @brief Computes the key identifying one camera sample.
+         * @param seed Render seed.
+         * @param pixel Linear pixel index.
+         * @param sample Sample index inside the pixel.
+         * @return The key of the sample.
+         */
+        static constexpr uint64_t sample_key(uint64_t seed, uint64_t pixel, uint64_t sample)
+        {
+            return mix(mix(mix(seed) ^ pixel) ^ sample);
+        }
+
+        /**
+         * @brief Restarts the generator on a (key, stream) pair.
+         * @param key The key selecting the sequence.
+         * @param stream The stream inside that sequence.
+         */
+        constexpr void reseed(uint64_t key, uint64_t stream)
+        {
+            state = 0;
+            inc = (mix(stream) << 1u) | 1u;
+            next_u32();
+            state += key;
+            next_u32();
+        }
+
+        /**
+         * @brief Keys the generator on a camera sample and selects its first stream.
+         *
+         * Draws made before the first begin_bounce() (sub-pixel jitter, lens sample)
+         * come from this stream.
+         */
+        void begin_sample(uint64_t seed, uint64_t pixel, uint64_t sample)
+        {
+            key = sample_key(seed, pixel, sample);
+            reseed(key, 0);
+        }
+
+        /**
+         * @brief Selects the stream of one bounce of the current sample.
+         * @param bounce Bounce index, 0 for the camera ray.
+         */
+        void begin_bounce(uint64_t bounce)
+        {
+            reseed(key, bounce + 1);
+        }
+
+        /// @return The next 32 uniformly distributed bits.
+        constexpr uint32_t next_u32()
+        {
+            uint64_t old_state = state;
+            state = old_state * 6364136223846793005ULL + inc;
+            uint32_t xorshifted = uint32_t(((old_state >> 18u) ^ old_state) >> 27u);
+            uint32_t rot = uint32_t(old_state >> 59u);
+            return (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+        }
+
+        /// @return A uniformly distributed double in [0, 1).
+        double next_double()
+        {
+            return next_u32() * 0x1p-32;
+        }
+
+        /**
+         * @brief Fills a buffer with uniformly distributed doubles in [0, 1).
+         * @param out Destination buffer.
+         * @param n Number of values to draw.
+         */
+        void next_doubles(double *out, size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+                out[i] = next_u32() * 0x1p-32;
+        }
+
+        /// @return N uniformly distributed doubles in [0, 1).
+        template <size_t N>
+        std::array<double, N> next_doubles()
+        {
+            std::array<double, N> values;
+            next_doubles(values.data(), N);
+            return values;
+        }
+
+    private:
+        uint64_t state; ///< PCG internal state.
+        uint64_t inc;   ///< PCG stream increment (always odd).
+        uint64_t key;   ///< Key of the current sample.
+    };
+
+    /**
+     * @brief Returns the generator owned by the calling thread.
+     */
+    inline rng &thread_rng()
+    {
+        thread_local rng generator;
+        return generator;
+    }
+}
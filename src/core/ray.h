@@ -7,18 +7,21 @@ namespace cobra
      * @brief Represents a ray in 3D space defined by an origin point and a direction vector.
      *
      * The direction vector is expected to be normalized for most ray tracing calculations.
+     *
+     * @tparam T Scalar type of the origin and direction; the renderer uses ray (see real).
      */
-    class ray
+    template <typename T>
+    class basic_ray
     {
     private:
-        vec3 origin;    ///< Starting point of the ray
-        vec3 direction; ///< Direction vector of the ray
+        basic_vec3<T> origin;    ///< Starting point of the ray
+        basic_vec3<T> direction; ///< Direction vector of the ray
 
     public:
         /**
          * @brief Default constructor for a ray.
          */
-        ray() {}
+        basic_ray() {}
 
         /**
          * @brief Constructs a ray given an origin and a direction.
@@ -26,12 +29,13 @@ namespace cobra
          * @param origin The starting point of the ray.
          * @param direction The direction vector of the ray (ideally normalized).
          */
-        ray(const vec3 &origin, const vec3 &direction) : origin(origin), direction(cobra::unit_vector(direction)) {}
+        basic_ray(const basic_vec3<T> &origin, const basic_vec3<T> &direction)
+            : origin(origin), direction(cobra::unit_vector(direction)) {}
 
         /**
          * @brief Destructor.
          */
-        ~ray()
+        ~basic_ray()
         {
         }
 
@@ -39,7 +43,7 @@ namespace cobra
          * @brief Get the origin of the ray.
          * @return The origin point as a const reference.
          */
-        const vec3 &get_origin() const
+        const basic_vec3<T> &get_origin() const
         {
             return origin;
         }
@@ -48,7 +52,7 @@ namespace cobra
          * @brief Get the direction of the ray.
          * @return The direction vector as a const reference.
          */
-        const vec3 &get_direction() const
+        const basic_vec3<T> &get_direction() const
         {
             return direction;
         }
@@ -61,12 +65,12 @@ namespace cobra
          * @param t The parameter along the ray.
          * @return The 3D point at parameter t.
          */
-        vec3 at(double t) const
+        basic_vec3<T> at(T t) const
         {
             return origin + t * direction;
         }
 
-        ray &operator=(const cobra::ray &other)
+        basic_ray &operator=(const basic_ray &other)
         {
             if (this != &other)
             {
@@ -76,4 +80,7 @@ namespace cobra
             return *this;
         }
     };
+
+    /// Ray of the renderer's scalar type.
+    using ray = basic_ray<real>;
 }
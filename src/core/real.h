@@ -0,0 +1,36 @@
+#pragma once
+#include <limits>
+
+namespace cobra
+{
+    /**
+     * @brief Scalar type of the geometry: vectors, rays, intervals, boxes and hit records.
+     *
+     * Double by default; the COBRA_SINGLE_PRECISION CMake option switches it to float,
+     * which halves the memory traffic of traversal and doubles the SIMD width.
+     */
+#ifdef COBRA_SINGLE_PRECISION
+    using real = float;
+#else
+    using real = double;
+#endif
+
+    /**
+     * @brief Bound on the relative error of `n` successive roundings, gamma(n) in PBRT.
+     * @tparam T Floating point type the operations are done in.
+     */
+    template <typename T>
+    constexpr T rounding_bound(int n)
+    {
+        constexpr T unit_roundoff = std::numeric_limits<T>::epsilon() / 2;
+        return n * unit_roundoff / (1 - n * unit_roundoff);
+    }
+
+    /**
+     * @brief Factor applied to the far distance of a ray/box slab test so that rounding never
+     * makes a ray miss a box it touches (the test does three roundings per distance).
+     * @tparam T Floating point type of the slab test.
+     */
+    template <typename T>
+    constexpr T slab_tolerance = 1 + 2 * rounding_bound<T>(3);
+} // namespace cobra
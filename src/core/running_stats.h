@@ -0,0 +1,65 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+
+namespace cobra
+{
+    /**
+     * @class running_stats
+     * @brief Running mean and variance of a stream of values (Welford's algorithm).
+     *
+     * Numerically stable and constant in memory, so it can be kept per pixel.
+     */
+    class running_stats
+    {
+    public:
+        /// @brief Constructs an empty stream.
+        running_stats() = default;
+
+        /**
+         * @brief Restores the statistics of a stream, as saved from count(), mean() and squared_deviations().
+         */
+        running_stats(size_t count, double mean, double squared_deviations) : n(count), m(mean), m2(squared_deviations) {}
+
+        /// @brief Adds a value to the stream.
+        void add(double x)
+        {
+            ++n;
+            double delta = x - m;
+            m += delta / n;
+            m2 += delta * (x - m);
+        }
+
+        /// @brief Adds the values of another stream (Chan et al.'s pairwise update).
+        void add(const running_stats &other)
+        {
+            if (other.n == 0)
+                return;
+            size_t total = n + other.n;
+            double delta = other.m - m;
+            m2 += other.m2 + delta * delta * (double(n) * double(other.n) / double(total));
+            m += delta * (double(other.n) / double(total));
+            n = total;
+        }
+
+        /// @return Number of values added.
+        size_t count() const { return n; }
+
+        /// @return Mean of the values, 0 if there are none.
+        double mean() const { return m; }
+
+        /// @return Sum of the squared deviations from the mean.
+        double squared_deviations() const { return m2; }
+
+        /// @return Unbiased sample variance, 0 with fewer than two values.
+        double variance() const { return n > 1 ? m2 / (n - 1) : 0; }
+
+        /// @return Estimated standard deviation of the mean.
+        double standard_error() const { return n > 1 ? std::sqrt(variance() / n) : 0; }
+
+    private:
+        size_t n = 0;
+        double m = 0;  ///< Running mean.
+        double m2 = 0; ///< Sum of squared deviations from the running mean.
+    };
+} // namespace cobra
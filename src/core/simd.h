@@ -0,0 +1,252 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define COBRA_SSE 1
+#endif
+
+#if defined(__AVX__)
+#define COBRA_AVX 1
+#endif
+
+namespace cobra
+{
+    /**
+     * @brief A pack of W single-precision lanes.
+     *
+     * The generic version is a plain array that the compiler may or may not vectorize.
+     * vfloat<4> maps to SSE and vfloat<8> to AVX when the target supports them, so the
+     * kernels written on top of it (BVH slab tests, triangle and sphere tests, filters)
+     * are portable and still use the widest registers available.
+     */
+    template <int W>
+    struct vfloat
+    {
+        float v[W];
+
+        static vfloat load(const float *p)
+        {
+            vfloat r;
+            std::copy(p, p + W, r.v);
+            return r;
+        }
+        static vfloat broadcast(float x)
+        {
+            vfloat r;
+            std::fill(r.v, r.v + W, x);
+            return r;
+        }
+        void store(float *p) const { std::copy(v, v + W, p); }
+        float operator[](int i) const { return v[i]; }
+    };
+
+    /**
+     * @brief Result of a lane-wise comparison of two vfloat.
+     */
+    template <int W>
+    struct vbool
+    {
+        bool v[W];
+
+        /// @return One bit per lane, lane 0 in the lowest bit.
+        int bits() const
+        {
+            int b = 0;
+            for (int i = 0; i < W; ++i)
+                b |= int(v[i]) << i;
+            return b;
+        }
+    };
+
+#define COBRA_VFLOAT_BINARY(op)                                  \
+    template <int W>                                             \
+    inline vfloat<W> operator op(const vfloat<W> &a, const vfloat<W> &b) \
+    {                                                            \
+        vfloat<W> r;                                             \
+        for (int i = 0; i < W; ++i)                              \
+            r.v[i] = a.v[i] op b.v[i];                           \
+        return r;                                                \
+    }
+    COBRA_VFLOAT_BINARY(+)
+    COBRA_VFLOAT_BINARY(-)
+    COBRA_VFLOAT_BINARY(*)
+    COBRA_VFLOAT_BINARY(/)
+#undef COBRA_VFLOAT_BINARY
+
+#define COBRA_VFLOAT_COMPARE(op)                                \
+    template <int W>                                            \
+    inline vbool<W> operator op(const vfloat<W> &a, const vfloat<W> &b) \
+    {                                                           \
+        vbool<W> r;                                             \
+        for (int i = 0; i < W; ++i)                             \
+            r.v[i] = a.v[i] op b.v[i];                          \
+        return r;                                               \
+    }
+    COBRA_VFLOAT_COMPARE(<)
+    COBRA_VFLOAT_COMPARE(<=)
+    COBRA_VFLOAT_COMPARE(>)
+    COBRA_VFLOAT_COMPARE(>=)
+#undef COBRA_VFLOAT_COMPARE
+
+    template <int W>
+    inline vbool<W> operator&(const vbool<W> &a, const vbool<W> &b)
+    {
+        vbool<W> r;
+        for (int i = 0; i < W; ++i)
+            r.v[i] = a.v[i] && b.v[i];
+        return r;
+    }
+
+    template <int W>
+    inline vbool<W> operator|(const vbool<W> &a, const vbool<W> &b)
+    {
+        vbool<W> r;
+        for (int i = 0; i < W; ++i)
+            r.v[i] = a.v[i] || b.v[i];
+        return r;
+    }
+
+    template <int W>
+    inline vfloat<W> vmin(const vfloat<W> &a, const vfloat<W> &b)
+    {
+        vfloat<W> r;
+        for (int i = 0; i < W; ++i)
+            r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+    template <int W>
+    inline vfloat<W> vmax(const vfloat<W> &a, const vfloat<W> &b)
+    {
+        vfloat<W> r;
+        for (int i = 0; i < W; ++i)
+            r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+    template <int W>
+    inline vfloat<W> vabs(const vfloat<W> &a)
+    {
+        vfloat<W> r;
+        for (int i = 0; i < W; ++i)
+            r.v[i] = std::fabs(a.v[i]);
+        return r;
+    }
+
+    template <int W>
+    inline vfloat<W> vsqrt(const vfloat<W> &a)
+    {
+        vfloat<W> r;
+        for (int i = 0; i < W; ++i)
+            r.v[i] = std::sqrt(a.v[i]);
+        return r;
+    }
+
+    /// @return For each lane, `a` where the mask is set and `b` elsewhere.
+    template <int W>
+    inline vfloat<W> select(const vbool<W> &m, const vfloat<W> &a, const vfloat<W> &b)
+    {
+        vfloat<W> r;
+        for (int i = 0; i < W; ++i)
+            r.v[i] = m.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+
+#ifdef COBRA_SSE
+    template <>
+    struct vfloat<4>
+    {
+        __m128 v;
+
+        vfloat() {}
+        vfloat(__m128 v) : v(v) {}
+        static vfloat load(const float *p) { return _mm_loadu_ps(p); }
+        static vfloat broadcast(float x) { return _mm_set1_ps(x); }
+        void store(float *p) const { _mm_storeu_ps(p, v); }
+        float operator[](int i) const
+        {
+            alignas(16) float tmp[4];
+            _mm_store_ps(tmp, v);
+            return tmp[i];
+        }
+    };
+
+    template <>
+    struct vbool<4>
+    {
+        __m128 v;
+
+        vbool(__m128 v) : v(v) {}
+        int bits() const { return _mm_movemask_ps(v); }
+    };
+
+    inline vfloat<4> operator+(const vfloat<4> &a, const vfloat<4> &b) { return _mm_add_ps(a.v, b.v); }
+    inline vfloat<4> operator-(const vfloat<4> &a, const vfloat<4> &b) { return _mm_sub_ps(a.v, b.v); }
+    inline vfloat<4> operator*(const vfloat<4> &a, const vfloat<4> &b) { return _mm_mul_ps(a.v, b.v); }
+    inline vfloat<4> operator/(const vfloat<4> &a, const vfloat<4> &b) { return _mm_div_ps(a.v, b.v); }
+    inline vbool<4> operator<(const vfloat<4> &a, const vfloat<4> &b) { return _mm_cmplt_ps(a.v, b.v); }
+    inline vbool<4> operator<=(const vfloat<4> &a, const vfloat<4> &b) { return _mm_cmple_ps(a.v, b.v); }
+    inline vbool<4> operator>(const vfloat<4> &a, const vfloat<4> &b) { return _mm_cmpgt_ps(a.v, b.v); }
+    inline vbool<4> operator>=(const vfloat<4> &a, const vfloat<4> &b) { return _mm_cmpge_ps(a.v, b.v); }
+    inline vbool<4> operator&(const vbool<4> &a, const vbool<4> &b) { return _mm_and_ps(a.v, b.v); }
+    inline vbool<4> operator|(const vbool<4> &a, const vbool<4> &b) { return _mm_or_ps(a.v, b.v); }
+    inline vfloat<4> vmin(const vfloat<4> &a, const vfloat<4> &b) { return _mm_min_ps(a.v, b.v); }
+    inline vfloat<4> vmax(const vfloat<4> &a, const vfloat<4> &b) { return _mm_max_ps(a.v, b.v); }
+    inline vfloat<4> vabs(const vfloat<4> &a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+    inline vfloat<4> vsqrt(const vfloat<4> &a) { return _mm_sqrt_ps(a.v); }
+    inline vfloat<4> select(const vbool<4> &m, const vfloat<4> &a, const vfloat<4> &b)
+    {
+        return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+    }
+#endif
+
+#ifdef COBRA_AVX
+    template <>
+    struct vfloat<8>
+    {
+        __m256 v;
+
+        vfloat() {}
+        vfloat(__m256 v) : v(v) {}
+        static vfloat load(const float *p) { return _mm256_loadu_ps(p); }
+        static vfloat broadcast(float x) { return _mm256_set1_ps(x); }
+        void store(float *p) const { _mm256_storeu_ps(p, v); }
+        float operator[](int i) const
+        {
+            alignas(32) float tmp[8];
+            _mm256_store_ps(tmp, v);
+            return tmp[i];
+        }
+    };
+
+    template <>
+    struct vbool<8>
+    {
+        __m256 v;
+
+        vbool(__m256 v) : v(v) {}
+        int bits() const { return _mm256_movemask_ps(v); }
+    };
+
+    inline vfloat<8> operator+(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_add_ps(a.v, b.v); }
+    inline vfloat<8> operator-(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_sub_ps(a.v, b.v); }
+    inline vfloat<8> operator*(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_mul_ps(a.v, b.v); }
+    inline vfloat<8> operator/(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_div_ps(a.v, b.v); }
+    inline vbool<8> operator<(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+    inline vbool<8> operator<=(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+    inline vbool<8> operator>(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+    inline vbool<8> operator>=(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+    inline vbool<8> operator&(const vbool<8> &a, const vbool<8> &b) { return _mm256_and_ps(a.v, b.v); }
+    inline vbool<8> operator|(const vbool<8> &a, const vbool<8> &b) { return _mm256_or_ps(a.v, b.v); }
+    inline vfloat<8> vmin(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_min_ps(a.v, b.v); }
+    inline vfloat<8> vmax(const vfloat<8> &a, const vfloat<8> &b) { return _mm256_max_ps(a.v, b.v); }
+    inline vfloat<8> vabs(const vfloat<8> &a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    inline vfloat<8> vsqrt(const vfloat<8> &a) { return _mm256_sqrt_ps(a.v); }
+    inline vfloat<8> select(const vbool<8> &m, const vfloat<8> &a, const vfloat<8> &b)
+    {
+        return _mm256_blendv_ps(b.v, a.v, m.v);
+    }
+#endif
+} // namespace cobra
@@ -1,21 +1,41 @@
 #pragma once
 #include "core/vec3.h"
+#include <cmath>
+#include <cstdint>
 #include <memory>
 
 namespace cobra
 {
+  /**
+   * @brief Concrete type of a texture, used by texture_value to dispatch without virtual calls.
+   */
+  enum class texture_kind : uint8_t
+  {
+    solid_color, ///< cobra::solid_color
+    checker,     ///< cobra::checker_texture
+    custom       ///< Any other texture.
+  };
+
   /**
    * @class texture
    * @brief Abstract base class for textures in the ray tracing engine.
    *
    * A texture can be evaluated at a 3D point with associated UV coordinates.
    * Subclasses implement concrete behaviors such as constant color, checker patterns, images, etc.
+   * The built-in textures are final and tagged with their kind; custom textures keep the
+   * default kind and are evaluated through the virtual `value`.
    */
   class texture
   {
   public:
+    /// @brief Constructs a custom texture.
+    texture() : _kind(texture_kind::custom) {}
+
     virtual ~texture() = default;
 
+    /// @return The concrete type of the texture.
+    texture_kind kind() const { return _kind; }
+
     /**
      * @brief Returns the color value of the texture at a given point.
      *
@@ -25,20 +45,29 @@ namespace cobra
      * @return The color at the given point.
      */
     virtual vec3 value(double u, double v, const vec3 &p) const = 0;
+
+  private:
+    friend class solid_color;
+    friend class checker_texture;
+
+    /// @brief Constructs a built-in texture; private for the same reason as material's.
+    explicit texture(texture_kind kind) : _kind(kind) {}
+
+    texture_kind _kind; ///< Concrete type, set once by the constructor.
   };
 
   /**
    * @class solid_color
    * @brief Texture that always returns a single constant color.
    */
-  class solid_color : public texture
+  class solid_color final : public texture
   {
   public:
     /**
      * @brief Constructs a solid color texture from a color vector.
      * @param albedo The constant color value.
      */
-    solid_color(const vec3 &albedo) : albedo(albedo) {}
+    solid_color(const vec3 &albedo) : texture(texture_kind::solid_color), albedo(albedo) {}
 
     /**
      * @brief Constructs a solid color texture from RGB components.
@@ -68,7 +97,7 @@ namespace cobra
    * The checker pattern alternates based on the 3D spatial coordinates (not UV),
    * creating a pattern of cubes in space.
    */
-  class checker_texture : public texture
+  class checker_texture final : public texture
   {
   public:
     /**
@@ -78,7 +107,7 @@ namespace cobra
      * @param odd Texture used for "odd" cells.
      */
     checker_texture(double scale, std::shared_ptr<texture> even, std::shared_ptr<texture> odd)
-        : inv_scale(1.0 / scale), even(even), odd(odd) {}
+        : texture(texture_kind::checker), inv_scale(1.0 / scale), even(even), odd(odd) {}
 
     /**
      * @brief Constructs a checker pattern from two solid colors.
@@ -96,20 +125,44 @@ namespace cobra
      *
      * Alternates between even and odd textures based on the sum of integer coordinates.
      */
-    vec3 value(double u, double v, const vec3 &p) const override
-    {
-      auto xInteger = int(std::floor(inv_scale * p.x()));
-      auto yInteger = int(std::floor(inv_scale * p.y()));
-      auto zInteger = int(std::floor(inv_scale * p.z()));
-
-      bool isEven = (xInteger + yInteger + zInteger) % 2 == 0;
-
-      return isEven ? even->value(u, v, p) : odd->value(u, v, p);
-    }
+    vec3 value(double u, double v, const vec3 &p) const override;
 
   private:
     double inv_scale;              ///< Inverse of the pattern scale (used for coordinate scaling).
     std::shared_ptr<texture> even; ///< Texture for even checker cells.
     std::shared_ptr<texture> odd;  ///< Texture for odd checker cells.
   };
+
+  /**
+   * @brief Evaluates a texture, calling the built-in textures directly.
+   *
+   * @param tex The texture.
+   * @param u Horizontal texture coordinate.
+   * @param v Vertical texture coordinate.
+   * @param p The 3D point in space where the texture is being sampled.
+   * @return The color at the given point.
+   */
+  inline vec3 texture_value(const texture &tex, double u, double v, const vec3 &p)
+  {
+    switch (tex.kind())
+    {
+    case texture_kind::solid_color:
+      return static_cast<const solid_color &>(tex).solid_color::value(u, v, p);
+    case texture_kind::checker:
+      return static_cast<const checker_texture &>(tex).checker_texture::value(u, v, p);
+    default:
+      return tex.value(u, v, p);
+    }
+  }
+
+  inline vec3 checker_texture::value(double u, double v, const vec3 &p) const
+  {
+    auto xInteger = int(std::floor(inv_scale * p.x()));
+    auto yInteger = int(std::floor(inv_scale * p.y()));
+    auto zInteger = int(std::floor(inv_scale * p.z()));
+
+    bool isEven = (xInteger + yInteger + zInteger) % 2 == 0;
+
+    return isEven ? texture_value(*even, u, v, p) : texture_value(*odd, u, v, p);
+  }
 } // namespace cobra
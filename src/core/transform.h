@@ -0,0 +1,180 @@
+#pragma once
+#include "core/aabb.h"
+#include "cobra.h"
+
+namespace cobra
+{
+    /**
+     * @class affine_transform
+     * @brief A 3x4 matrix: a linear part followed by a translation.
+     *
+     * Maps a point p to `linear * p + offset`. Transforms compose like matrices: `a * b`
+     * applies b first, then a.
+     */
+    class affine_transform
+    {
+    public:
+        double m[3][4]; ///< Rows of the matrix; column 3 is the translation.
+
+        /// @brief Constructs the identity.
+        affine_transform()
+        {
+            for (int row = 0; row < 3; ++row)
+                for (int col = 0; col < 4; ++col)
+                    m[row][col] = row == col ? 1.0 : 0.0;
+        }
+
+        /// @return A translation by `offset`.
+        static affine_transform translation(const vec3 &offset)
+        {
+            affine_transform t;
+            for (int row = 0; row < 3; ++row)
+                t.m[row][3] = offset[row];
+            return t;
+        }
+
+        /// @return A rotation of `angle` degrees around the Y axis, as done by rotate_y.
+        static affine_transform rotation_y(double angle)
+        {
+            double radians = degrees_to_radians(angle);
+            double s = std::sin(radians), c = std::cos(radians);
+            affine_transform t;
+            t.m[0][0] = c;
+            t.m[0][2] = s;
+            t.m[2][0] = -s;
+            t.m[2][2] = c;
+            return t;
+        }
+
+        /// @return A rotation of `angle` degrees around `axis` (right-handed).
+        static affine_transform rotation(const vec3 &axis, double angle)
+        {
+            vec3 a = unit_vector(axis);
+            double radians = degrees_to_radians(angle);
+            double s = std::sin(radians), c = std::cos(radians);
+            affine_transform t;
+            for (int row = 0; row < 3; ++row)
+                for (int col = 0; col < 3; ++col)
+                    t.m[row][col] = a[row] * a[col] * (1 - c) + (row == col ? c : 0.0);
+            t.m[0][1] -= a[2] * s;
+            t.m[0][2] += a[1] * s;
+            t.m[1][0] += a[2] * s;
+            t.m[1][2] -= a[0] * s;
+            t.m[2][0] -= a[1] * s;
+            t.m[2][1] += a[0] * s;
+            return t;
+        }
+
+        /// @return A scaling by `factors` along each axis.
+        static affine_transform scaling(const vec3 &factors)
+        {
+            affine_transform t;
+            for (int row = 0; row < 3; ++row)
+                t.m[row][row] = factors[row];
+            return t;
+        }
+
+        /// @return The transform applying `b` then `a`.
+        friend affine_transform operator*(const affine_transform &a, const affine_transform &b)
+        {
+            affine_transform t;
+            for (int row = 0; row < 3; ++row)
+            {
+                for (int col = 0; col < 4; ++col)
+                {
+                    double sum = col == 3 ? a.m[row][3] : 0.0;
+                    for (int k = 0; k < 3; ++k)
+                        sum += a.m[row][k] * b.m[k][col];
+                    t.m[row][col] = sum;
+                }
+            }
+            return t;
+        }
+
+        /// @return True if this is exactly the identity.
+        bool is_identity() const
+        {
+            for (int row = 0; row < 3; ++row)
+                for (int col = 0; col < 4; ++col)
+                    if (m[row][col] != (row == col ? 1.0 : 0.0))
+                        return false;
+            return true;
+        }
+
+        /// @return The image of a point.
+        vec3 point(const vec3 &p) const
+        {
+            return vec3(m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+                        m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+                        m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3]);
+        }
+
+        /// @return The image of a direction (translation ignored).
+        vec3 vector(const vec3 &v) const
+        {
+            return vec3(m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2],
+                        m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+                        m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2]);
+        }
+
+        /**
+         * @brief Applies the transposed linear part.
+         *
+         * Called on the inverse of a transform, this maps normals through the transform
+         * itself (normals transform by the inverse transpose).
+         */
+        vec3 transposed_vector(const vec3 &v) const
+        {
+            return vec3(m[0][0] * v[0] + m[1][0] * v[1] + m[2][0] * v[2],
+                        m[0][1] * v[0] + m[1][1] * v[1] + m[2][1] * v[2],
+                        m[0][2] * v[0] + m[1][2] * v[1] + m[2][2] * v[2]);
+        }
+
+        /// @return The box bounding the image of a box (its eight transformed corners).
+        aabb bounds(const aabb &box) const
+        {
+            vec3 lo(infinity, infinity, infinity);
+            vec3 hi(-infinity, -infinity, -infinity);
+            for (int corner = 0; corner < 8; ++corner)
+            {
+                vec3 p = point(vec3(corner & 1 ? box.x.max : box.x.min,
+                                    corner & 2 ? box.y.max : box.y.min,
+                                    corner & 4 ? box.z.max : box.z.min));
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    lo[axis] = std::fmin(lo[axis], p[axis]);
+                    hi[axis] = std::fmax(hi[axis], p[axis]);
+                }
+            }
+            return aabb(lo, hi);
+        }
+
+        /// @return The determinant of the linear part.
+        double determinant() const
+        {
+            return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                   m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                   m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        }
+
+        /// @return The inverse transform; the linear part must not be singular.
+        affine_transform inverse() const
+        {
+            double inv_det = 1.0 / determinant();
+            affine_transform t;
+            for (int row = 0; row < 3; ++row)
+            {
+                for (int col = 0; col < 3; ++col)
+                {
+                    // Cofactor of (col, row), i.e. the adjugate.
+                    int r0 = (col + 1) % 3, r1 = (col + 2) % 3;
+                    int c0 = (row + 1) % 3, c1 = (row + 2) % 3;
+                    t.m[row][col] = (m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0]) * inv_det;
+                }
+            }
+            for (int row = 0; row < 3; ++row)
+                t.m[row][3] = -(t.m[row][0] * m[0][3] + t.m[row][1] * m[1][3] + t.m[row][2] * m[2][3]);
+            return t;
+        }
+    };
+} // namespace cobra
@@ -1,56 +1,67 @@
 #pragma once
 #include <iostream>
 #include <cmath>
+#include "core/random.h"
+#include "core/real.h"
 
 namespace cobra
 {
   /**
-   * @class vec3
+   * @class basic_vec3
    * @brief A class representing a 3D vector.
    *
    * This class provides basic vector operations such as addition, subtraction,
    * scalar multiplication, dot product, cross product, and normalization.
+   *
+   * @tparam T Scalar type of the components; the renderer uses vec3 (see real).
    */
-  class vec3
+  template <typename T>
+  class basic_vec3
   {
   public:
-    double e[3]; ///< The vector components (x, y, z)
+    using scalar = T; ///< Type of the components.
+
+    T e[3]; ///< The vector components (x, y, z)
 
     /// Default constructor. Initializes the vector to (0, 0, 0).
-    vec3() : e{0, 0, 0} {}
+    basic_vec3() : e{0, 0, 0} {}
 
     /// Constructor with component values.
     /// @param e0 X component
     /// @param e1 Y component
     /// @param e2 Z component
-    vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+    basic_vec3(T e0, T e1, T e2) : e{e0, e1, e2} {}
+
+    /// Converts a vector of another precision.
+    template <typename U>
+    explicit basic_vec3(const basic_vec3<U> &v) : e{T(v.e[0]), T(v.e[1]), T(v.e[2])} {}
 
     /// @return The x-component of the vector.
-    double x() const { return e[0]; }
+    T x() const { return e[0]; }
 
     /// @return The y-component of the vector.
-    double y() const { return e[1]; }
+    T y() const { return e[1]; }
 
     /// @return The z-component of the vector.
-    double z() const { return e[2]; }
+    T z() const { return e[2]; }
 
     /// Unary minus operator.
     /// @return The negated vector.
-    vec3 operator-() const
+    basic_vec3 operator-() const
     {
-      return vec3(-e[0], -e[1], -e[2]);
+      return basic_vec3(-e[0], -e[1], -e[2]);
     }
 
     /// Const access to components via index.
     /// @param i Index (0 for x, 1 for y, 2 for z)
-    double operator[](int i) const
+    T operator[](int i) const
     {
       return e[i];
     }
 
     /// Mutable access to components via index.
     /// @param i Index (0 for x, 1 for y, 2 for z)
-    double &operator[](int i)
+    T &operator[](int i)
     {
       return e[i];
     }
@@ -58,7 +69,7 @@ namespace cobra
     /// Adds another vector to this one.
     /// @param v Vector to add.
     /// @return Reference to this vector after addition.
-    vec3 &operator+=(const vec3 &v)
+    basic_vec3 &operator+=(const basic_vec3 &v)
     {
       e[0] += v.e[0];
       e[1] += v.e[1];
@@ -69,7 +80,7 @@ namespace cobra
     /// Multiplies this vector by a scalar.
     /// @param t Scalar multiplier.
     /// @return Reference to this vector after scaling.
-    vec3 &operator*=(double t)
+    basic_vec3 &operator*=(T t)
     {
       e[0] *= t;
       e[1] *= t;
@@ -80,41 +91,49 @@ namespace cobra
     /// Divides this vector by a scalar.
     /// @param t Scalar divisor.
     /// @return Reference to this vector after division.
-    vec3 &operator/=(double t)
+    basic_vec3 &operator/=(T t)
     {
       return *this *= 1 / t;
     }
 
     /// @return The Euclidean length (magnitude) of the vector.
-    double length() const
+    T length() const
     {
       return std::sqrt(length_squared());
     }
 
     /// @return The squared length of the vector (more efficient when exact length not needed).
-    double length_squared() const
+    T length_squared() const
     {
       return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
     }
 
+    /// @return The largest of the three components.
+    T max_component() const
+    {
+      return std::fmax(e[0], std::fmax(e[1], e[2]));
+    }
+
     /**
      * @brief Generates a random vector with components in the range [0, 1).
-     * @return A random vec3.
+     * @return A random vector.
      */
-    static vec3 random()
+    static basic_vec3 random()
     {
-      return vec3(random_double(), random_double(), random_double());
+      auto r = thread_rng().next_doubles<3>();
+      return basic_vec3(T(r[0]), T(r[1]), T(r[2]));
     }
 
     /**
      * @brief Generates a random vector with components in the range [min, max).
      * @param min Minimum component value.
      * @param max Maximum component value.
-     * @return A random vec3.
+     * @return A random vector.
      */
-    static vec3 random(double min, double max)
+    static basic_vec3 random(double min, double max)
     {
-      return vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+      auto r = thread_rng().next_doubles<3>();
+      return basic_vec3(T(min + (max - min) * r[0]), T(min + (max - min) * r[1]), T(min + (max - min) * r[2]));
     }
 
     /**
@@ -126,68 +145,59 @@ namespace cobra
       auto s = 1e-8;
       return (std::fabs(e[0]) < s) && (std::fabs(e[1]) < s) && (std::fabs(e[2]) < s);
     }
-  };
 
-  // Vector Utility Function Declarations
+    // Arithmetic operators are hidden friends, so that a scalar of any arithmetic type
+    // (2, 0.5, a double in single precision builds) converts to T.
 
-  /**
-   * @brief Give a random point in a the unit disk.
-   * @return The random vector with z = 0.
-   */
-  inline vec3 random_in_unit_disk()
-  {
-    while (true)
+    /// Outputs a vector to an output stream.
+    friend std::ostream &operator<<(std::ostream &out, const basic_vec3 &v)
     {
-      auto p = vec3(random_double(-1, 1), random_double(-1, 1), 0);
-      if (p.length_squared() < 1)
-        return p;
+      return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
     }
-  }
 
-  /// Outputs a vector to an output stream.
-  inline std::ostream &operator<<(std::ostream &out, const vec3 &v)
-  {
-    return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
-  }
+    /// Adds two vectors.
+    friend basic_vec3 operator+(const basic_vec3 &u, const basic_vec3 &v)
+    {
+      return basic_vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+    }
 
-  /// Adds two vectors.
-  inline vec3 operator+(const vec3 &u, const vec3 &v)
-  {
-    return vec3(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
-  }
+    /// Subtracts one vector from another.
+    friend basic_vec3 operator-(const basic_vec3 &u, const basic_vec3 &v)
+    {
+      return basic_vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+    }
 
-  /// Subtracts one vector from another.
-  inline vec3 operator-(const vec3 &u, const vec3 &v)
-  {
-    return vec3(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
-  }
+    /// Performs component-wise multiplication of two vectors.
+    friend basic_vec3 operator*(const basic_vec3 &u, const basic_vec3 &v)
+    {
+      return basic_vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+    }
 
-  /// Performs component-wise multiplication of two vectors.
-  inline vec3 operator*(const vec3 &u, const vec3 &v)
-  {
-    return vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
-  }
+    /// Multiplies a vector by a scalar (scalar * vector).
+    friend basic_vec3 operator*(T t, const basic_vec3 &v)
+    {
+      return basic_vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
+    }
 
-  /// Multiplies a vector by a scalar (scalar * vector).
-  inline vec3 operator*(double t, const vec3 &v)
-  {
-    return vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
-  }
+    /// Multiplies a vector by a scalar (vector * scalar).
+    friend basic_vec3 operator*(const basic_vec3 &v, T t)
+    {
+      return t * v;
+    }
 
-  /// Multiplies a vector by a scalar (vector * scalar).
-  inline vec3 operator*(const vec3 &v, double t)
-  {
-    return t * v;
-  }
+    /// Divides a vector by a scalar.
+    friend basic_vec3 operator/(const basic_vec3 &v, T t)
+    {
+      return (1 / t) * v;
+    }
+  };
 
-  /// Divides a vector by a scalar.
-  inline vec3 operator/(const vec3 &v, double t)
-  {
-    return (1 / t) * v;
-  }
+  /// Vector of the renderer's scalar type.
+  using vec3 = basic_vec3<real>;
 
   /// Computes the dot product of two vectors.
-  inline double dot(const vec3 &u, const vec3 &v)
+  template <typename T>
+  inline T dot(const basic_vec3<T> &u, const basic_vec3<T> &v)
   {
     return u.e[0] * v.e[0] +
            u.e[1] * v.e[1] +
@@ -195,14 +205,39 @@ namespace cobra
   }
 
   /// Computes the cross product of two vectors.
-  inline vec3 cross(const vec3 &u, const vec3 &v)
+  template <typename T>
+  inline basic_vec3<T> cross(const basic_vec3<T> &u, const basic_vec3<T> &v)
   {
-    return vec3(
+    return basic_vec3<T>(
         u.e[1] * v.e[2] - u.e[2] * v.e[1],
         u.e[2] * v.e[0] - u.e[0] * v.e[2],
         u.e[0] * v.e[1] - u.e[1] * v.e[0]);
   }
 
+  /// Returns a normalized (unit length) version of the vector.
+  template <typename T>
+  inline basic_vec3<T> unit_vector(const basic_vec3<T> &v)
+  {
+    return v / v.length();
+  }
+
+  // Vector Utility Function Declarations
+
+  /**
+   * @brief Give a random point in a the unit disk.
+   * @return The random vector with z = 0.
+   */
+  inline vec3 random_in_unit_disk()
+  {
+    while (true)
+    {
+      auto r = thread_rng().next_doubles<2>();
+      auto p = vec3(2 * r[0] - 1, 2 * r[1] - 1, 0);
+      if (p.length_squared() < 1)
+        return p;
+    }
+  }
+
   /**
    * @brief Reflects a vector around a given normal.
    * @param v The incoming vector.
@@ -229,10 +264,10 @@ namespace cobra
     return r_out_perp + r_out_parallel;
   }
 
-  /// Returns a normalized (unit length) version of the vector.
-  inline vec3 unit_vector(const vec3 &v)
+  /// @return The relative luminance of a linear RGB color (Rec. 709 weights).
+  inline double luminance(const vec3 &c)
   {
-    return v / v.length();
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
   }
 
   /// Generate a random vector in the unit sphere.
@@ -264,8 +299,9 @@ namespace cobra
    */
   inline vec3 random_cosine_direction()
   {
-    auto r1 = random_double();
-    auto r2 = random_double();
+    auto r = thread_rng().next_doubles<2>();
+    auto r1 = r[0];
+    auto r2 = r[1];
 
     auto phi = 2 * pi * r1;
     auto x = std::cos(phi) * std::sqrt(r2);
@@ -0,0 +1,375 @@
+#pragma once
+#include "core/bvh_node.h"
+#include "core/instrumentation.h"
+#include "core/linear_bvh.h"
+#include "core/simd.h"
+#include "geometry/hittable.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief A node of a W-wide BVH.
+     *
+     * Child bounds are stored as structure-of-arrays (one row of W floats per face), so one
+     * SIMD slab test checks a ray against all the children at once. Row `2 * axis` holds the
+     * minimums along `axis`, row `2 * axis + 1` the maximums. A child is an interior node when
+     * its `count` is 0 and a leaf (range of `count` primitives starting at `child`) otherwise.
+     * Unused slots have empty bounds and are never hit.
+     */
+    template <int W>
+    struct wide_bvh_node
+    {
+        float bounds[6][W]; ///< Child bounds, one row per slab.
+        uint32_t child[W];  ///< Child node index, or first primitive of a leaf.
+        uint16_t count[W];  ///< Primitive count of a leaf child, 0 for an interior child.
+    };
+
+    /**
+     * @brief Per-ray data of a wide traversal, in single precision.
+     */
+    struct wide_ray
+    {
+        float origin[3];  ///< Ray origin.
+        float inv_dir[3]; ///< Component-wise inverse of the ray direction.
+        int dir_neg[3];   ///< 1 when the direction is negative along an axis.
+
+        explicit wide_ray(const ray &r)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                double inv = 1.0 / r.get_direction()[axis];
+                origin[axis] = float(r.get_origin()[axis]);
+                inv_dir[axis] = float(inv);
+                dir_neg[axis] = inv < 0;
+            }
+        }
+    };
+
+    /// Relative bound on the rounding error of the float slab test (3 roundings, see PBRT's gamma(3)).
+    constexpr float wide_slab_tolerance = slab_tolerance<float>;
+
+    /**
+     * @brief Tests a ray against the W children of a node.
+     *
+     * @param node The node whose children are tested.
+     * @param r The precomputed ray.
+     * @param t_min Start of the valid range of the ray.
+     * @param t_max End of the valid range of the ray.
+     * @param dist Receives the entry distance of each child.
+     * @return A mask with bit i set if child i is hit.
+     */
+    template <int W>
+    inline int intersect_children(const wide_bvh_node<W> &node, const wide_ray &r, float t_min, float t_max, float dist[W])
+    {
+        using vf = vfloat<W>;
+        vf t_near = vf::broadcast(t_min);
+        vf t_far = vf::broadcast(t_max);
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            vf near_plane = vf::load(node.bounds[2 * axis + r.dir_neg[axis]]);
+            vf far_plane = vf::load(node.bounds[2 * axis + 1 - r.dir_neg[axis]]);
+            vf o = vf::broadcast(r.origin[axis]);
+            vf inv = vf::broadcast(r.inv_dir[axis]);
+
+            // The slab distance comes first so that a NaN lane keeps the running value.
+            t_near = vmax((near_plane - o) * inv, t_near);
+            t_far = vmin((far_plane - o) * inv, t_far);
+        }
+
+        t_far = t_far * vf::broadcast(wide_slab_tolerance);
+        t_near.store(dist);
+        return (t_near <= t_far).bits();
+    }
+
+    /**
+     * @brief Outward padding of wide child bounds for a scene of the given size.
+     *
+     * A few float ulps of the largest coordinate, to absorb the rounding of the ray origin
+     * to single precision.
+     */
+    inline float wide_padding(const aabb &bounds)
+    {
+        double scale = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const interval &ival = bounds.axis_interval(axis);
+            scale = std::fmax(scale, std::fmax(std::fabs(ival.min), std::fabs(ival.max)));
+        }
+        return float(scale * 0x1p-21);
+    }
+
+    /**
+     * @class wide_hierarchy
+     * @brief The nodes of a W-wide BVH and their SIMD traversal.
+     *
+     * Built by collapsing a binary linear_bvh: each wide node pulls in the largest
+     * descendants of a binary node until it has W children. Children that are hit are
+     * visited nearest first. Like linear_bvh it only knows about primitive ranges, so any
+     * owner (wide_bvh, triangle_mesh) supplies the leaf test.
+     */
+    template <int W>
+    class wide_hierarchy
+    {
+    public:
+        /// @brief Constructs an empty hierarchy.
+        wide_hierarchy() {}
+
+        /**
+         * @brief Collapses a binary hierarchy.
+         * @param binary The binary hierarchy; leaf ranges are copied as they are.
+         * @param padding Outward padding of the child bounds (see wide_padding).
+         */
+        wide_hierarchy(const linear_bvh &binary, float padding) : padding(padding)
+        {
+            if (binary.empty())
+                return;
+            wide_nodes.reserve(binary.nodes().size() / 2 + 1);
+            collapse(binary.nodes(), 0);
+            wide_nodes.shrink_to_fit();
+        }
+
+        /// @return Number of wide nodes.
+        size_t node_count() const { return wide_nodes.size(); }
+
+        /// @return Bytes used by the nodes.
+        size_t memory_usage() const { return wide_nodes.capacity() * sizeof(wide_bvh_node<W>); }
+
+        /**
+         * @brief Finds the closest hit along a ray (see linear_bvh::traverse for the callback).
+         */
+        template <typename LeafHit>
+        bool traverse(const ray &r, interval &ray_t, LeafHit &&leaf_hit) const
+        {
+            return search<false>(r, ray_t, leaf_hit);
+        }
+
+        /**
+         * @brief Tells whether a ray hits any primitive (see linear_bvh::occluded).
+         */
+        template <typename LeafHit>
+        bool occluded(const ray &r, interval ray_t, LeafHit &&leaf_hit) const
+        {
+            return search<true>(r, ray_t, leaf_hit);
+        }
+
+    private:
+        std::vector<wide_bvh_node<W>> wide_nodes; ///< Wide nodes, root first.
+        float padding = 0;                        ///< Outward padding of child bounds.
+
+        /// Traversal of traverse() and occluded(); with `any_hit`, the first hit ends it.
+        template <bool any_hit, typename LeafHit>
+        bool search(const ray &r, interval &ray_t, LeafHit &leaf_hit) const
+        {
+            if (wide_nodes.empty())
+                return false;
+
+            struct entry
+            {
+                uint32_t child;
+                uint32_t count;
+                float dist;
+            };
+
+            wide_ray wr(r);
+            entry stack[linear_bvh::stack_size * W];
+            int stack_top = 0;
+            stack[stack_top++] = {0, 0, -std::numeric_limits<float>::infinity()};
+            bool hit_anything = false;
+
+            while (stack_top > 0)
+            {
+                entry e = stack[--stack_top];
+                if (e.dist > ray_t.max * wide_slab_tolerance)
+                    continue;
+
+                if (e.count > 0)
+                {
+                    if (leaf_hit(e.child, e.count, ray_t))
+                    {
+                        if (any_hit)
+                            return true;
+                        hit_anything = true;
+                    }
+                    continue;
+                }
+
+                const wide_bvh_node<W> &node = wide_nodes[e.child];
+                COBRA_COUNT(bvh_nodes);
+                COBRA_COUNT_N(aabb_tests, W);
+                float dist[W];
+                int mask = intersect_children(node, wr, float(ray_t.min), float(ray_t.max), dist);
+
+                // Push the hit children, then insertion-sort them in place (farthest at the
+                // bottom) so that the nearest one is popped next.
+                int first = stack_top;
+                while (mask)
+                {
+                    int i = __builtin_ctz(mask);
+                    mask &= mask - 1;
+                    stack[stack_top++] = {node.child[i], node.count[i], dist[i]};
+                }
+                for (int k = first + 1; k < stack_top; ++k)
+                {
+                    entry h = stack[k];
+                    int j = k;
+                    for (; j > first && stack[j - 1].dist < h.dist; --j)
+                        stack[j] = stack[j - 1];
+                    stack[j] = h;
+                }
+            }
+            return hit_anything;
+        }
+
+        static float area(const linear_bvh_node &node)
+        {
+            float dx = node.bounds_max[0] - node.bounds_min[0];
+            float dy = node.bounds_max[1] - node.bounds_min[1];
+            float dz = node.bounds_max[2] - node.bounds_min[2];
+            return dx * dy + dy * dz + dz * dx;
+        }
+
+        uint32_t collapse(const std::vector<linear_bvh_node> &binary, uint32_t index)
+        {
+            uint32_t wide_index = uint32_t(wide_nodes.size());
+            wide_nodes.emplace_back();
+
+            // Open the largest interior child until the node is full.
+            uint32_t children[W];
+            int n = 0;
+            if (binary[index].is_leaf())
+                children[n++] = index;
+            else
+            {
+                children[n++] = index + 1;
+                children[n++] = binary[index].offset;
+            }
+
+            while (n < W)
+            {
+                int largest = -1;
+                for (int i = 0; i < n; ++i)
+                    if (!binary[children[i]].is_leaf() &&
+                        (largest < 0 || area(binary[children[i]]) > area(binary[children[largest]])))
+                        largest = i;
+                if (largest < 0)
+                    break;
+
+                uint32_t opened = children[largest];
+                children[largest] = opened + 1;
+                children[n++] = binary[opened].offset;
+            }
+
+            wide_bvh_node<W> node;
+            for (int i = 0; i < W; ++i)
+            {
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    node.bounds[2 * axis][i] = std::numeric_limits<float>::infinity();
+                    node.bounds[2 * axis + 1][i] = -std::numeric_limits<float>::infinity();
+                }
+                node.child[i] = 0;
+                node.count[i] = 0;
+            }
+
+            for (int i = 0; i < n; ++i)
+            {
+                const linear_bvh_node &child = binary[children[i]];
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    node.bounds[2 * axis][i] = child.bounds_min[axis] - padding;
+                    node.bounds[2 * axis + 1][i] = child.bounds_max[axis] + padding;
+                }
+                if (child.is_leaf())
+                {
+                    node.child[i] = child.offset;
+                    node.count[i] = child.primitive_count;
+                }
+                else
+                    node.child[i] = collapse(binary, children[i]);
+            }
+
+            wide_nodes[wide_index] = node;
+            return wide_index;
+        }
+    };
+
+    /**
+     * @class wide_bvh
+     * @brief A BVH with W children per node (BVH4, BVH8), traversed with SIMD slab tests.
+     *
+     * Collapses the binary hierarchy of a bvh_node into a wide_hierarchy. It shares the
+     * objects of the bvh_node it was built from.
+     */
+    template <int W>
+    class wide_bvh : public hittable
+    {
+    public:
+        /**
+         * @brief Collapses a binary BVH into the wide layout.
+         * @param source The binary BVH, kept alive for its objects.
+         */
+        wide_bvh(shared_ptr<bvh_node> source)
+            : source(source), primitives(source->leaf_objects()),
+              tree(source->hierarchy(), wide_padding(source->bounding_box()))
+        {
+        }
+
+        bool hit(const ray &r, interval ray_t, hit_record &rec) const override
+        {
+            // A single object (such as a scene grouped into one sphere_set) has its own bounds test.
+            if (primitives.size() == 1)
+                return primitives[0]->hit(r, ray_t, rec);
+            return tree.traverse(r, ray_t, [&](uint32_t first, uint32_t count, interval &t)
+                                 {
+                                     bool hit_anything = false;
+                                     for (uint32_t i = first; i < first + count; ++i)
+                                     {
+                                         if (primitives[i]->hit(r, t, rec))
+                                         {
+                                             hit_anything = true;
+                                             t.max = rec.t;
+                                         }
+                                     }
+                                     return hit_anything; });
+        }
+
+        bool occluded(const ray &r, interval ray_t) const override
+        {
+            if (primitives.size() == 1)
+                return primitives[0]->occluded(r, ray_t);
+            return tree.occluded(r, ray_t, [&](uint32_t first, uint32_t count, interval &t)
+                                 {
+                                     for (uint32_t i = first; i < first + count; ++i)
+                                         if (primitives[i]->occluded(r, t))
+                                             return true;
+                                     return false; });
+        }
+
+        aabb bounding_box() const override { return source->bounding_box(); }
+
+        /// @return Number of wide nodes.
+        size_t node_count() const { return tree.node_count(); }
+
+        /**
+         * @brief Finds the closest hit along a ray (see linear_bvh::traverse for the callback).
+         */
+        template <typename LeafHit>
+        bool traverse(const ray &r, interval &ray_t, LeafHit &&leaf_hit) const
+        {
+            return tree.traverse(r, ray_t, leaf_hit);
+        }
+
+    private:
+        shared_ptr<bvh_node> source;              ///< Binary BVH owning the objects.
+        std::vector<const hittable *> primitives; ///< Leaf objects, in leaf order.
+        wide_hierarchy<W> tree;                   ///< Wide nodes over `primitives`.
+    };
+
+    using bvh4 = wide_bvh<4>; ///< 4-wide BVH, tested with SSE.
+    using bvh8 = wide_bvh<8>; ///< 8-wide BVH, tested with AVX.
+} // namespace cobra
@@ -3,6 +3,8 @@
 #include "core/hit_record.h"
 #include "core/interval.h"
 #include "core/aabb.h"
+#include "core/transform.h"
+#include "core/instrumentation.h"
 
 namespace cobra
 {
@@ -50,7 +52,23 @@ namespace cobra
          * @return An AABB representing the bounding volume of the object.
          */
         virtual aabb bounding_box() const = 0;
-        
+
+        /**
+         * @brief Tells whether anything blocks a ray within the given range (shadow rays).
+         *
+         * Unlike hit(), it may stop at the first intersection found, whichever it is, and
+         * fills no hit_record. The default implementation calls hit().
+         *
+         * @param r The ray to test.
+         * @param ray_t Interval of min and max of t.
+         * @return true if the ray intersects the object within ray_t.
+         */
+        virtual bool occluded(const ray &r, interval ray_t) const
+        {
+            hit_record rec;
+            return hit(r, ray_t, rec);
+        }
+
         virtual double pdf_value(const vec3 &origin, const vec3 &direction) const
         {
             return 0.0;
@@ -60,6 +78,13 @@ namespace cobra
         {
             return vec3(1, 0, 0);
         }
+
+        /**
+         * @brief Estimates the power the object emits, to weight light sampling.
+         * @return Emitting area times the luminance of the emitted radiance; 0 for objects
+         * that do not emit, or that cannot tell.
+         */
+        virtual double emitted_power() const { return 0.0; }
     };
 
     inline hittable::~hittable() {}
@@ -87,6 +112,7 @@ namespace cobra
          */
         bool hit(const ray &r, interval ray_t, hit_record &rec) const override
         {
+            COBRA_COUNT(instance_tests);
             ray offset_ray(r.get_origin() - offset, r.get_direction());
 
             if (!object->hit(offset_ray, ray_t, rec))
@@ -96,6 +122,12 @@ namespace cobra
             return true;
         }
 
+        bool occluded(const ray &r, interval ray_t) const override
+        {
+            COBRA_COUNT(instance_tests);
+            return object->occluded(ray(r.get_origin() - offset, r.get_direction()), ray_t);
+        }
+
         /**
          * @brief Returns the bounding box translated by the offset.
          */
@@ -104,6 +136,12 @@ namespace cobra
             return bbox;
         }
 
+        /// @return The translated object.
+        const shared_ptr<hittable> &wrapped() const { return object; }
+
+        /// @return The transform from the object's space to the world.
+        affine_transform transform() const { return affine_transform::translation(offset); }
+
     private:
         shared_ptr<hittable> object;
         vec3 offset;
@@ -164,19 +202,8 @@ namespace cobra
          */
         bool hit(const ray &r, interval ray_t, hit_record &rec) const override
         {
-            auto origin = vec3(
-                (cos_theta * r.get_origin().x()) - (sin_theta * r.get_origin().z()),
-                r.get_origin().y(),
-                (sin_theta * r.get_origin().x()) + (cos_theta * r.get_origin().z()));
-
-            auto direction = vec3(
-                (cos_theta * r.get_direction().x()) - (sin_theta * r.get_direction().z()),
-                r.get_direction().y(),
-                (sin_theta * r.get_direction().x()) + (cos_theta * r.get_direction().z()));
-
-            ray rotated_r(origin, direction);
-
-            if (!object->hit(rotated_r, ray_t, rec))
+            COBRA_COUNT(instance_tests);
+            if (!object->hit(to_object(r), ray_t, rec))
                 return false;
 
             rec.point = vec3(
@@ -192,15 +219,51 @@ namespace cobra
             return true;
         }
 
+        bool occluded(const ray &r, interval ray_t) const override
+        {
+            COBRA_COUNT(instance_tests);
+            return object->occluded(to_object(r), ray_t);
+        }
+
         /**
          * @brief Returns the bounding box of the rotated object.
          */
         aabb bounding_box() const override { return bbox; }
 
+        /// @return The rotated object.
+        const shared_ptr<hittable> &wrapped() const { return object; }
+
+        /// @return The transform from the object's space to the world.
+        affine_transform transform() const
+        {
+            affine_transform t;
+            t.m[0][0] = cos_theta;
+            t.m[0][2] = sin_theta;
+            t.m[2][0] = -sin_theta;
+            t.m[2][2] = cos_theta;
+            return t;
+        }
+
     private:
         shared_ptr<hittable> object;
         double sin_theta;
         double cos_theta;
         aabb bbox;
+
+        /// @return The ray in the space of the object, rotated by minus the angle.
+        ray to_object(const ray &r) const
+        {
+            auto origin = vec3(
+                (cos_theta * r.get_origin().x()) - (sin_theta * r.get_origin().z()),
+                r.get_origin().y(),
+                (sin_theta * r.get_origin().x()) + (cos_theta * r.get_origin().z()));
+
+            auto direction = vec3(
+                (cos_theta * r.get_direction().x()) - (sin_theta * r.get_direction().z()),
+                r.get_direction().y(),
+                (sin_theta * r.get_direction().x()) + (cos_theta * r.get_direction().z()));
+
+            return ray(origin, direction);
+        }
     };
 }
\ No newline at end of file
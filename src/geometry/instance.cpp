@@ -0,0 +1,56 @@
+#include "geometry/instance.h"
+
+namespace cobra
+{
+    instance::instance(shared_ptr<hittable> object, const affine_transform &to_world)
+        : object(object), to_world(to_world), to_object(to_world.inverse()), bbox(to_world.bounds(object->bounding_box()))
+    {
+    }
+
+    bool instance::hit(const ray &r, interval ray_t, hit_record &rec) const
+    {
+        COBRA_COUNT(instance_tests);
+        // Rays keep unit directions, so a scaling transform changes the ray parameter.
+        vec3 direction = to_object.vector(r.get_direction());
+        double scale = direction.length();
+        ray local(to_object.point(r.get_origin()), direction);
+
+        if (!object->hit(local, interval(ray_t.min * scale, ray_t.max * scale), rec))
+            return false;
+
+        rec.t /= scale;
+        rec.point = r.at(rec.t);
+        rec.normal = unit_vector(to_object.transposed_vector(rec.normal));
+        return true;
+    }
+
+    bool instance::occluded(const ray &r, interval ray_t) const
+    {
+        COBRA_COUNT(instance_tests);
+        vec3 direction = to_object.vector(r.get_direction());
+        double scale = direction.length();
+        ray local(to_object.point(r.get_origin()), direction);
+        return object->occluded(local, interval(ray_t.min * scale, ray_t.max * scale));
+    }
+
+    double instance::pdf_value(const vec3 &origin, const vec3 &direction) const
+    {
+        // The object's density is per object-space solid angle; a linear map M scales solid
+        // angles at a unit direction d by |det M| / |M d|^3.
+        vec3 local = to_object.vector(unit_vector(direction));
+        double length = local.length();
+        return object->pdf_value(to_object.point(origin), local / length) * std::fabs(to_object.determinant()) /
+               (length * length * length);
+    }
+
+    double instance::emitted_power() const
+    {
+        double area_scale = std::pow(std::fabs(to_object.determinant()), -2.0 / 3.0);
+        return object->emitted_power() * area_scale;
+    }
+
+    vec3 instance::random(const vec3 &origin) const
+    {
+        return to_world.vector(object->random(to_object.point(origin)));
+    }
+} // namespace cobra
@@ -0,0 +1,52 @@
+#pragma once
+#include "core/transform.h"
+#include "geometry/hittable.h"
+
+namespace cobra
+{
+    /**
+     * @class instance
+     * @brief A placed copy of a shared object, under a general affine transform.
+     *
+     * Rays are brought into the object's space with a single 3x4 matrix, so a chain of
+     * translate and rotate_y wrappers becomes one hop. The object (usually a bottom-level
+     * BVH or a triangle_mesh) is shared by every instance of it: an instance only stores
+     * its matrix, the inverse and its world bounds.
+     */
+    class instance : public hittable
+    {
+    public:
+        /**
+         * @brief Places an object in the world.
+         * @param object The shared object.
+         * @param to_world Transform from the object's space to the world; must be invertible.
+         */
+        instance(shared_ptr<hittable> object, const affine_transform &to_world);
+
+        bool hit(const ray &r, interval ray_t, hit_record &rec) const override;
+
+        bool occluded(const ray &r, interval ray_t) const override;
+
+        aabb bounding_box() const override { return bbox; }
+
+        /// The object's pdf, converted to world solid angles: exact under scales and shears too.
+        double pdf_value(const vec3 &origin, const vec3 &direction) const override;
+
+        vec3 random(const vec3 &origin) const override;
+
+        /// Scales the object's power by the area change of the transform (exact for uniform scales).
+        double emitted_power() const override;
+
+        /// @return The shared object.
+        const shared_ptr<hittable> &wrapped() const { return object; }
+
+        /// @return The transform from the object's space to the world.
+        const affine_transform &transform() const { return to_world; }
+
+    private:
+        shared_ptr<hittable> object; ///< Shared object, in its own space.
+        affine_transform to_world;   ///< Placement of the object.
+        affine_transform to_object;  ///< Inverse of the placement.
+        aabb bbox;                   ///< Bounds in world space.
+    };
+} // namespace cobra
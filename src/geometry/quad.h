@@ -1,5 +1,6 @@
 #pragma once
 #include "geometry/hittable.h"
+#include "core/material.h"
 
 namespace cobra
 {
@@ -75,10 +76,14 @@ namespace cobra
          */
         bool hit(const ray &r, interval ray_t, hit_record &rec) const override
         {
+            COBRA_COUNT(quad_tests);
             double denom = dot(normal, r.get_direction());
 
-            // No hit if ray is parallel to the quad's plane
-            if (std::fabs(denom) < 1e-8)
+            // No hit if ray is parallel to the quad's plane. In single precision a hit point
+            // is only known to about 1e-7, so a ray sampled from it toward another point of
+            // the same quad looks that far from parallel: the threshold follows the precision.
+            constexpr double parallel_threshold = sizeof(real) < sizeof(double) ? 1e-5 : 1e-8;
+            if (std::fabs(denom) < parallel_threshold)
                 return false;
 
             double t = (D - dot(normal, r.get_origin())) / denom;
@@ -97,7 +102,7 @@ namespace cobra
 
             rec.t = t;
             rec.point = intersection;
-            rec.mat = mat;
+            rec.mat = mat.get();
             rec.set_face_normal(r, normal);
 
             return true;
@@ -136,6 +141,8 @@ namespace cobra
             auto p = Q + (random_double() * u) + (random_double() * v);
             return p - origin;
         }
+
+        double emitted_power() const override { return mat ? area * luminance(mat->emission()) : 0.0; }
     };
 
     class cube : public scene
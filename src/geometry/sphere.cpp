@@ -4,6 +4,7 @@
 #include <cmath>
 #include "hittable.h"
 #include "core/onb.h"
+#include "core/material.h"
 
 cobra::sphere::sphere(const vec3 &center, double radius, std::shared_ptr<material> mat) : _mat(mat), _center(center), _radius(radius)
 {
@@ -15,19 +16,23 @@ cobra::sphere::~sphere()
 {
 }
 
-bool cobra::sphere::hit(const ray &r, interval ray_t, hit_record &rec) const
+bool cobra::sphere::solve(const vec3 &center, double radius, const ray &r, const interval &ray_t, double &root)
 {
-    vec3 oc = r.get_origin() - _center;
-    auto a = dot(r.get_direction(), r.get_direction());
-    auto half_b = dot(oc, r.get_direction());
-    auto c = dot(oc, oc) - _radius * _radius;
+    // Solved in double whatever the scalar type: for a large sphere (the ground of the demo
+    // scenes has a radius of 1000), c would lose every significant digit in single precision.
+    using dvec3 = basic_vec3<double>;
+    dvec3 direction(r.get_direction());
+    dvec3 oc = dvec3(r.get_origin()) - dvec3(center);
+    auto a = dot(direction, direction);
+    auto half_b = dot(oc, direction);
+    auto c = dot(oc, oc) - radius * radius;
     auto discriminant = half_b * half_b - a * c;
 
     if (discriminant < 0)
         return false;
 
     auto sqrt_d = std::sqrt(discriminant);
-    double root = (-half_b - sqrt_d) / a;
+    root = (-half_b - sqrt_d) / a;
 
     if (!ray_t.surrounds(root))
     {
@@ -35,16 +40,32 @@ bool cobra::sphere::hit(const ray &r, interval ray_t, hit_record &rec) const
         if (!ray_t.surrounds(root))
             return false;
     }
+    return true;
+}
+
+bool cobra::sphere::hit(const ray &r, interval ray_t, hit_record &rec) const
+{
+    COBRA_COUNT(sphere_tests);
+    double root;
+    if (!solve(_center, _radius, r, ray_t, root))
+        return false;
 
     rec.t = root;
     rec.point = r.at(rec.t);
     vec3 outward_normal = (rec.point - _center) / _radius;
     rec.set_face_normal(r, outward_normal);
-    rec.mat = mat();
+    rec.mat = _mat.get();
 
     return true;
 }
 
+bool cobra::sphere::occluded(const ray &r, interval ray_t) const
+{
+    COBRA_COUNT(sphere_tests);
+    double root;
+    return solve(_center, _radius, r, ray_t, root);
+}
+
 double cobra::sphere::pdf_value(const vec3 &origin, const vec3 &direction) const
 {
     // This method only works for stationary spheres.
@@ -60,6 +81,11 @@ double cobra::sphere::pdf_value(const vec3 &origin, const vec3 &direction) const
     return 1 / solid_angle;
 }
 
+double cobra::sphere::emitted_power() const
+{
+    return _mat ? 4 * pi * _radius * _radius * luminance(_mat->emission()) : 0.0;
+}
+
 cobra::vec3 cobra::sphere::random(const vec3 &origin) const
 {
     vec3 direction = _center - origin;
@@ -70,8 +96,9 @@ cobra::vec3 cobra::sphere::random(const vec3 &origin) const
 
 cobra::vec3 cobra::sphere::random_to_sphere(double radius, double distance_squared)
 {
-    auto r1 = random_double();
-    auto r2 = random_double();
+    auto r = thread_rng().next_doubles<2>();
+    auto r1 = r[0];
+    auto r2 = r[1];
     auto z = 1 + r2 * (std::sqrt(1 - radius * radius / distance_squared) - 1);
 
     auto phi = 2 * pi * r1;
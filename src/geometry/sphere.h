@@ -39,13 +39,28 @@ namespace cobra
          * @brief Gets the center of the sphere.
          * @return A reference to the center vector.
          */
-        const vec3 &center() { return _center; }
+        const vec3 &center() const { return _center; }
 
         /**
          * @brief Gets the radius of the sphere.
          * @return The radius value.
          */
-        double radius() { return _radius; }
+        double radius() const { return _radius; }
+
+        /**
+         * @brief Solves the ray/sphere quadratic, in double whatever the scalar type.
+         *
+         * Shared with sphere_set so that a grouped sphere is hit exactly where the
+         * sphere object would be.
+         *
+         * @param center The center of the sphere.
+         * @param radius The radius of the sphere.
+         * @param r The ray.
+         * @param ray_t Interval of min and max of t.
+         * @param root Receives the closest root inside `ray_t`.
+         * @return True if a root lies strictly inside `ray_t`.
+         */
+        static bool solve(const vec3 &center, double radius, const ray &r, const interval &ray_t, double &root);
 
         /**
          * @brief Determines if a ray hits the object within the given range.
@@ -61,6 +76,8 @@ namespace cobra
          */
         bool hit(const ray &r, interval ray_t, hit_record &rec) const override;
 
+        bool occluded(const ray &r, interval ray_t) const override;
+
         /**
          * @brief Returns the material of the object.
          * @return A pointer to the material.
@@ -81,5 +98,7 @@ namespace cobra
         
 
         vec3 random(const vec3 &origin) const override;
+
+        double emitted_power() const override;
     };
 }
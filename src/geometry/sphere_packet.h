@@ -0,0 +1,98 @@
+#pragma once
+#include "core/ray.h"
+#include "core/simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cobra
+{
+    /**
+     * @brief W spheres stored as structure-of-arrays, culled in one SIMD pass.
+     *
+     * Unused lanes hold NaN: every comparison fails on them, so they are never candidates.
+     */
+    template <int W>
+    struct sphere_packet
+    {
+        float center[3][W]; ///< Center of each sphere, one row per axis.
+        float radius[W];    ///< Radius of each sphere.
+    };
+
+    /**
+     * @brief Per-ray data of the sphere packet test.
+     */
+    struct sphere_ray
+    {
+        float origin[3];      ///< Ray origin.
+        float direction[3];   ///< Ray direction, not normalized.
+        float inv_length2;    ///< 1 / |direction|^2.
+        float position_error; ///< Bound on the error of a rounded center minus the rounded origin.
+
+        /**
+         * @param r The ray.
+         * @param scale Largest coordinate magnitude of the sphere centers tested.
+         */
+        sphere_ray(const ray &r, double scale)
+        {
+            double magnitude = scale;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                origin[axis] = float(r.get_origin()[axis]);
+                direction[axis] = float(r.get_direction()[axis]);
+                magnitude = std::max(magnitude, std::fabs(double(r.get_origin()[axis])));
+            }
+            inv_length2 = float(1 / r.get_direction().length_squared());
+            // Each coordinate of the center and of the origin is rounded once to float.
+            position_error = float(magnitude * 0x1p-21);
+        }
+    };
+
+    /**
+     * @brief Conservative single-precision test of the W spheres of a packet.
+     *
+     * The spheres are grown by a bound on the float rounding errors, so a lane that the
+     * exact double-precision solve (sphere::solve) would hit inside [t_min, t_max] is
+     * always returned; a few near misses are returned too and rejected by that solve.
+     *
+     * @param packet The spheres.
+     * @param r The precomputed ray.
+     * @param t_min Start of the valid range of the ray.
+     * @param t_max End of the valid range of the ray.
+     * @return Bit mask of the candidate lanes.
+     */
+    template <int W>
+    int cull_packet(const sphere_packet<W> &packet, const sphere_ray &r, float t_min, float t_max)
+    {
+        using vf = vfloat<W>;
+
+        // Center relative to the origin, and the closest approach of the ray to it.
+        vf dx = vf::broadcast(r.direction[0]), dy = vf::broadcast(r.direction[1]), dz = vf::broadcast(r.direction[2]);
+        vf ocx = vf::load(packet.center[0]) - vf::broadcast(r.origin[0]);
+        vf ocy = vf::load(packet.center[1]) - vf::broadcast(r.origin[1]);
+        vf ocz = vf::load(packet.center[2]) - vf::broadcast(r.origin[2]);
+        vf t_mid = (ocx * dx + ocy * dy + ocz * dz) * vf::broadcast(r.inv_length2);
+        vf fx = ocx - t_mid * dx, fy = ocy - t_mid * dy, fz = ocz - t_mid * dz;
+        vf distance2 = fx * fx + fy * fy + fz * fz;
+
+        // Radius grown by the position error, and squared distance grown by a relative bound
+        // on the rounding of the projection, which scales with the distance to the center.
+        vf radius = vf::load(packet.radius);
+        vf oc2 = ocx * ocx + ocy * ocy + ocz * ocz;
+        vf grown = radius + vf::broadcast(2 * r.position_error);
+        vf grown2 = grown * grown + vf::broadcast(4e-5f) * (radius * radius + oc2);
+        int inside = (distance2 <= grown2).bits();
+        if (!inside)
+            return 0;
+
+        // The roots lie within t_mid -/+ half_chord, half_chord^2 = (grown2 - distance2) / |d|^2;
+        // compared squared to avoid the square root.
+        vf half_chord2 = (grown2 - distance2) * vf::broadcast(r.inv_length2);
+        vf before = vf::broadcast(t_min) - t_mid; // > 0 when the center is before t_min
+        vf after = t_mid - vf::broadcast(t_max);  // > 0 when the center is beyond t_max
+        vf zero = vf::broadcast(0.0f);
+        inside &= ((before <= zero) | (before * before <= half_chord2)).bits() &
+                  ((after <= zero) | (after * after <= half_chord2)).bits();
+        return inside & ((1 << W) - 1);
+    }
+} // namespace cobra
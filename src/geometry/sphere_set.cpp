@@ -0,0 +1,135 @@
+#include "geometry/sphere_set.h"
+#include "geometry/sphere.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace cobra
+{
+    sphere_set::sphere_set(const std::vector<vec3> &centers, const std::vector<double> &radii,
+                           const std::vector<uint32_t> &material_ids, shared_ptr<const material_table> materials,
+                           const bvh_build_options &options)
+        : materials(std::move(materials)), count(radii.size())
+    {
+        std::vector<aabb> bounds;
+        bounds.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            vec3 extent(radii[i], radii[i], radii[i]);
+            bounds.push_back(aabb(centers[i] - extent, centers[i] + extent));
+            for (int axis = 0; axis < 3; ++axis)
+                scale = std::fmax(scale, std::fabs(double(centers[i][axis])));
+        }
+
+        bvh_build_options leaf_options = options;
+        leaf_options.max_leaf_size = std::min<size_t>(options.max_leaf_size, packet_width);
+        bvh_builder builder(leaf_options);
+        if (!builder.build(bounds))
+            return;
+
+        bbox = builder.nodes()[0].bbox;
+        linear_bvh binary(builder);
+
+        // One packet per leaf; the leaf offset becomes the packet index.
+        const std::vector<uint32_t> &order = builder.primitive_order();
+        size_t leaves = (binary.nodes().size() + 1) / 2;
+        packets.reserve(leaves);
+        this->centers.reserve(leaves * packet_width);
+        this->radii.reserve(leaves * packet_width);
+        this->material_ids.reserve(leaves * packet_width);
+        binary.remap_leaves([&](uint32_t first, uint32_t leaf_count)
+                          {
+            packet p;
+            const float nan = std::numeric_limits<float>::quiet_NaN();
+            for (int lane = 0; lane < packet_width; ++lane)
+            {
+                bool used = uint32_t(lane) < leaf_count;
+                uint32_t i = used ? order[first + lane] : 0;
+                for (int axis = 0; axis < 3; ++axis)
+                    p.center[axis][lane] = used ? float(centers[i][axis]) : nan;
+                p.radius[lane] = used ? float(radii[i]) : nan;
+                this->centers.push_back(used ? centers[i] : vec3());
+                this->radii.push_back(used ? radii[i] : 0.0);
+                this->material_ids.push_back(used ? material_ids[i] : 0);
+            }
+            packets.push_back(p);
+            return uint32_t(packets.size() - 1); });
+        tree = wide_hierarchy<packet_width>(binary, wide_padding(bbox));
+    }
+
+    bool sphere_set::hit(const ray &r, interval ray_t, hit_record &rec) const
+    {
+        sphere_ray sr(r, scale);
+        float t_min = float(ray_t.min);
+        size_t closest = 0;
+        double closest_t = 0;
+
+        bool found = tree.traverse(r, ray_t, [&](uint32_t first, uint32_t, interval &t)
+                                   {
+            COBRA_COUNT_N(sphere_tests, packet_width);
+            int candidates = cull_packet(packets[first], sr, t_min, float(t.max));
+            bool hit_any = false;
+            while (candidates)
+            {
+                int lane = __builtin_ctz(candidates);
+                candidates &= candidates - 1;
+                size_t i = size_t(first) * packet_width + lane;
+                double root;
+                if (sphere::solve(centers[i], radii[i], r, t, root))
+                {
+                    t.max = root;
+                    closest = i;
+                    closest_t = root;
+                    hit_any = true;
+                }
+            }
+            return hit_any; });
+        if (!found)
+            return false;
+
+        rec.t = closest_t;
+        rec.point = r.at(rec.t);
+        vec3 outward_normal = (rec.point - centers[closest]) / radii[closest];
+        rec.set_face_normal(r, outward_normal);
+        rec.mat = (*materials)[material_ids[closest]];
+        return true;
+    }
+
+    bool sphere_set::occluded(const ray &r, interval ray_t) const
+    {
+        sphere_ray sr(r, scale);
+        float t_min = float(ray_t.min);
+        return tree.occluded(r, ray_t, [&](uint32_t first, uint32_t, interval &t)
+                             {
+            COBRA_COUNT_N(sphere_tests, packet_width);
+            int candidates = cull_packet(packets[first], sr, t_min, float(t.max));
+            while (candidates)
+            {
+                int lane = __builtin_ctz(candidates);
+                candidates &= candidates - 1;
+                size_t i = size_t(first) * packet_width + lane;
+                double root;
+                if (sphere::solve(centers[i], radii[i], r, t, root))
+                    return true;
+            }
+            return false; });
+    }
+
+    size_t sphere_set::memory_usage() const
+    {
+        return sizeof(*this) + tree.memory_usage() +
+               packets.capacity() * sizeof(packet) + centers.capacity() * sizeof(vec3) +
+               radii.capacity() * sizeof(double) + material_ids.capacity() * sizeof(uint32_t);
+    }
+
+    bvh_build_options sphere_set::default_options()
+    {
+        bvh_build_options options;
+        options.max_leaf_size = packet_width;
+        options.primitive_block = packet_width;
+        // Charged per lane: a packet cull costs about two box tests.
+        options.intersection_cost = 2.0 / packet_width;
+        return options;
+    }
+} // namespace cobra
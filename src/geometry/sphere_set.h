@@ -0,0 +1,79 @@
+#pragma once
+#include "core/bvh_builder.h"
+#include "core/linear_bvh.h"
+#include "core/material_table.h"
+#include "core/wide_bvh.h"
+#include "geometry/hittable.h"
+#include "geometry/sphere_packet.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @class sphere_set
+     * @brief Many spheres in packed arrays, with their own BVH and a SIMD intersection kernel.
+     *
+     * Centers, radii and material indices are stored as plain arrays in leaf order; the
+     * indices refer to a material_table, usually shared by every set of a scene. As for
+     * triangle_mesh, the BVH is built over sphere bounds with bvh_builder and collapsed into
+     * a wide_hierarchy whose leaves hold at most `packet_width` spheres, repacked into one
+     * sphere_packet.
+     * A leaf is culled with one single-precision SIMD test; the few candidate lanes are
+     * then solved in double by sphere::solve, so that the hits are exactly those of the
+     * individual sphere objects. A sphere costs well under 100 bytes in total, where a
+     * sphere object alone is over 100.
+     */
+    class sphere_set : public hittable
+    {
+    public:
+#ifdef COBRA_AVX
+        /// Spheres per SIMD packet and per BVH leaf; also the width of the BVH.
+        static constexpr int packet_width = 8;
+#else
+        static constexpr int packet_width = 4;
+#endif
+
+        /**
+         * @brief Builds the BVH of a set of spheres.
+         * @param centers Center of each sphere.
+         * @param radii Radius of each sphere.
+         * @param material_ids Index in `materials` of the material of each sphere.
+         * @param materials Table of the materials; it may still grow, indices being stable.
+         * @param options SAH build parameters; `max_leaf_size` is capped to `packet_width`.
+         */
+        sphere_set(const std::vector<vec3> &centers, const std::vector<double> &radii,
+                   const std::vector<uint32_t> &material_ids, shared_ptr<const material_table> materials,
+                   const bvh_build_options &options = default_options());
+
+        bool hit(const ray &r, interval ray_t, hit_record &rec) const override;
+
+        bool occluded(const ray &r, interval ray_t) const override;
+
+        aabb bounding_box() const override { return bbox; }
+
+        /// @return Number of spheres.
+        size_t size() const { return count; }
+
+        /// @return Bytes used by the arrays, the BVH and the packets (not the material table).
+        size_t memory_usage() const;
+
+        /// @return Build options suited to packet leaves.
+        static bvh_build_options default_options();
+
+    private:
+        using packet = sphere_packet<packet_width>;
+
+        shared_ptr<const material_table> materials; ///< Materials referred to by material_ids.
+        wide_hierarchy<packet_width> tree;          ///< Leaves refer to a single packet each.
+        std::vector<packet> packets;                ///< Spheres of each leaf, in leaf order.
+        /// Exact data of lane `l` of packet `p` at index `p * packet_width + l`.
+        std::vector<vec3> centers;
+        std::vector<double> radii;
+        std::vector<uint32_t> material_ids;
+        size_t count = 0; ///< Number of spheres.
+        double scale = 0; ///< Largest coordinate magnitude of the centers.
+        aabb bbox;        ///< Bounds of the set.
+    };
+} // namespace cobra
@@ -0,0 +1,122 @@
+#include "geometry/triangle_mesh.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace cobra
+{
+    triangle_mesh::triangle_mesh(shared_ptr<const mesh_data> mesh, shared_ptr<material> mat,
+                                 const bvh_build_options &options)
+        : mesh(mesh), mat(mat)
+    {
+        const std::vector<float> &positions = mesh->positions;
+        const std::vector<uint32_t> &indices = mesh->indices;
+        auto vertex = [&](uint32_t index)
+        {
+            const float *p = &positions[3 * size_t(index)];
+            return vec3(p[0], p[1], p[2]);
+        };
+
+        size_t count = mesh->triangle_count();
+        std::vector<aabb> bounds;
+        bounds.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            vec3 a = vertex(indices[3 * i]), b = vertex(indices[3 * i + 1]), c = vertex(indices[3 * i + 2]);
+            bounds.push_back(aabb(aabb(a, b), aabb(c, c)));
+        }
+
+        bvh_build_options leaf_options = options;
+        leaf_options.max_leaf_size = std::min<size_t>(options.max_leaf_size, packet_width);
+        bvh_builder builder(leaf_options);
+        if (!builder.build(bounds))
+            return;
+
+        bbox = builder.nodes()[0].bbox;
+        linear_bvh binary(builder);
+
+        // One packet per leaf; the leaf offset becomes the packet index.
+        const std::vector<uint32_t> &order = builder.primitive_order();
+        packets.reserve((binary.nodes().size() + 1) / 2);
+        binary.remap_leaves([&](uint32_t first, uint32_t leaf_count)
+                          {
+            packet p;
+            const float nan = std::numeric_limits<float>::quiet_NaN();
+            for (int lane = 0; lane < packet_width; ++lane)
+            {
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    float(*row)[packet_width] = corner == 0 ? p.v0 : corner == 1 ? p.v1 : p.v2;
+                    const float *v = uint32_t(lane) < leaf_count
+                                         ? &positions[3 * size_t(indices[3 * size_t(order[first + lane]) + corner])]
+                                         : nullptr;
+                    for (int axis = 0; axis < 3; ++axis)
+                        row[axis][lane] = v ? v[axis] : nan;
+                }
+            }
+            packets.push_back(p);
+            return uint32_t(packets.size() - 1); });
+        tree = wide_hierarchy<packet_width>(binary, wide_padding(bbox));
+    }
+
+    bool triangle_mesh::hit(const ray &r, interval ray_t, hit_record &rec) const
+    {
+        triangle_ray tr(r);
+        triangle_hit closest;
+        closest.t = float(ray_t.max);
+        float t_min = float(ray_t.min);
+
+        bool found = tree.traverse(r, ray_t, [&](uint32_t first, uint32_t, interval &t)
+                                   {
+            COBRA_COUNT_N(triangle_tests, packet_width);
+            if (!intersect_packet(packets[first], first, tr, t_min, closest))
+                return false;
+            t.max = closest.t;
+            return true; });
+        if (!found)
+            return false;
+
+        const packet &p = packets[closest.packet];
+        int lane = closest.lane;
+        vec3 v0(p.v0[0][lane], p.v0[1][lane], p.v0[2][lane]);
+        vec3 v1(p.v1[0][lane], p.v1[1][lane], p.v1[2][lane]);
+        vec3 v2(p.v2[0][lane], p.v2[1][lane], p.v2[2][lane]);
+
+        rec.t = closest.t;
+        rec.point = r.at(rec.t);
+        rec.mat = mat.get();
+        rec.u = closest.b1;
+        rec.v = closest.b2;
+        rec.set_face_normal(r, unit_vector(cross(v1 - v0, v2 - v0)));
+        return true;
+    }
+
+    bool triangle_mesh::occluded(const ray &r, interval ray_t) const
+    {
+        triangle_ray tr(r);
+        triangle_hit closest;
+        closest.t = float(ray_t.max);
+        float t_min = float(ray_t.min);
+        return tree.occluded(r, ray_t, [&](uint32_t first, uint32_t, interval &)
+                             {
+            COBRA_COUNT_N(triangle_tests, packet_width);
+            return intersect_packet(packets[first], first, tr, t_min, closest); });
+    }
+
+    size_t triangle_mesh::memory_usage() const
+    {
+        return sizeof(*this) + mesh->positions.capacity() * sizeof(float) +
+               mesh->indices.capacity() * sizeof(uint32_t) +
+               tree.memory_usage() + packets.capacity() * sizeof(packet);
+    }
+
+    bvh_build_options triangle_mesh::default_options()
+    {
+        bvh_build_options options;
+        options.max_leaf_size = packet_width;
+        options.primitive_block = packet_width;
+        // Charged per lane: a packet test costs about two box tests.
+        options.intersection_cost = 2.0 / packet_width;
+        return options;
+    }
+} // namespace cobra
@@ -0,0 +1,70 @@
+#pragma once
+#include "core/bvh_builder.h"
+#include "core/linear_bvh.h"
+#include "core/wide_bvh.h"
+#include "geometry/hittable.h"
+#include "geometry/triangle_packet.h"
+#include "io/mesh_loader.h"
+
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @class triangle_mesh
+     * @brief A triangle mesh with its own BVH and a SIMD, watertight intersection kernel.
+     *
+     * The vertex and index buffers are shared (several meshes or instances can refer to
+     * the same mesh_data) and the whole mesh has a single material. The per-mesh BVH is
+     * built over triangle bounds with bvh_builder and collapsed into a wide_hierarchy;
+     * each leaf holds at most `packet_width` triangles, repacked into one triangle_packet
+     * so that a leaf is a single SIMD test. A triangle costs under 100 bytes in total
+     * (buffers, nodes and packets), where a quad object alone is over 200.
+     */
+    class triangle_mesh : public hittable
+    {
+    public:
+#ifdef COBRA_AVX
+        /// Triangles per SIMD packet and per BVH leaf; also the width of the mesh BVH.
+        static constexpr int packet_width = 8;
+#else
+        static constexpr int packet_width = 4;
+#endif
+
+        /**
+         * @brief Builds the BVH of a mesh.
+         * @param mesh Vertex and index buffers; degenerate triangles are kept but never hit.
+         * @param mat Material of the whole mesh.
+         * @param options SAH build parameters; `max_leaf_size` is capped to `packet_width`.
+         */
+        triangle_mesh(shared_ptr<const mesh_data> mesh, shared_ptr<material> mat,
+                      const bvh_build_options &options = default_options());
+
+        bool hit(const ray &r, interval ray_t, hit_record &rec) const override;
+
+        bool occluded(const ray &r, interval ray_t) const override;
+
+        aabb bounding_box() const override { return bbox; }
+
+        /// @return Number of triangles.
+        size_t triangle_count() const { return mesh->triangle_count(); }
+
+        /// @return The shared vertex and index buffers.
+        const shared_ptr<const mesh_data> &data() const { return mesh; }
+
+        /// @return Bytes used by the mesh buffers, the BVH and the packets.
+        size_t memory_usage() const;
+
+        /// @return Build options suited to packet leaves.
+        static bvh_build_options default_options();
+
+    private:
+        using packet = triangle_packet<packet_width>;
+
+        shared_ptr<const mesh_data> mesh;  ///< Shared vertex and index buffers.
+        shared_ptr<material> mat;          ///< Material of every triangle.
+        wide_hierarchy<packet_width> tree; ///< Leaves refer to a single packet each.
+        std::vector<packet> packets;       ///< Triangles of each leaf, in leaf order.
+        aabb bbox;                         ///< Bounds of the mesh.
+    };
+} // namespace cobra
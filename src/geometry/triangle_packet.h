@@ -0,0 +1,193 @@
+#pragma once
+#include "core/ray.h"
+#include "core/simd.h"
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace cobra
+{
+    /**
+     * @brief W triangles stored as structure-of-arrays, intersected in one SIMD pass.
+     *
+     * Row `axis` of each vertex array holds that coordinate for every lane. Unused lanes
+     * hold NaN vertices: every comparison fails on them, so they are never hit.
+     */
+    template <int W>
+    struct triangle_packet
+    {
+        float v0[3][W]; ///< First vertex of each triangle.
+        float v1[3][W]; ///< Second vertex of each triangle.
+        float v2[3][W]; ///< Third vertex of each triangle.
+    };
+
+    /**
+     * @brief Per-ray data of the watertight triangle test (Woop, Benthin and Wald, 2013).
+     *
+     * The ray is turned into the +z axis by a permutation and a shear, so that every
+     * triangle edge test is a 2D cross product in a space shared by neighbouring triangles.
+     * Edges are then classified consistently and rays cannot slip between triangles.
+     */
+    struct triangle_ray
+    {
+        float origin[3]; ///< Ray origin.
+        int kx, ky, kz;  ///< Axis permutation; kz is the dominant direction axis.
+        float sx, sy, sz; ///< Shear constants.
+
+        explicit triangle_ray(const ray &r)
+        {
+            const vec3 &d = r.get_direction();
+            kz = std::fabs(d.x()) > std::fabs(d.y()) ? (std::fabs(d.x()) > std::fabs(d.z()) ? 0 : 2)
+                                                     : (std::fabs(d.y()) > std::fabs(d.z()) ? 1 : 2);
+            kx = (kz + 1) % 3;
+            ky = (kx + 1) % 3;
+            // Keep the winding order when the dominant axis points backwards.
+            if (d[kz] < 0)
+                std::swap(kx, ky);
+
+            sx = float(d[kx] / d[kz]);
+            sy = float(d[ky] / d[kz]);
+            sz = float(1.0 / d[kz]);
+            for (int axis = 0; axis < 3; ++axis)
+                origin[axis] = float(r.get_origin()[axis]);
+        }
+    };
+
+    /**
+     * @brief The closest triangle hit found so far.
+     */
+    struct triangle_hit
+    {
+        float t;         ///< Ray parameter.
+        float b1, b2;    ///< Barycentric weights of v1 and v2.
+        uint32_t packet; ///< Packet of the triangle.
+        int lane;        ///< Lane of the triangle in its packet.
+    };
+
+    /**
+     * @brief Watertight test of one triangle of a packet, in double precision.
+     *
+     * Used for the lanes where the single-precision edge functions are exactly zero
+     * (the ray grazes an edge or a vertex), as recommended by the original paper.
+     */
+    template <int W>
+    bool intersect_lane_exact(const triangle_packet<W> &packet, int lane, const triangle_ray &r,
+                              float t_min, float t_max, float &t, float &b1, float &b2)
+    {
+        double a[3], b[3], c[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            a[axis] = double(packet.v0[axis][lane]) - r.origin[axis];
+            b[axis] = double(packet.v1[axis][lane]) - r.origin[axis];
+            c[axis] = double(packet.v2[axis][lane]) - r.origin[axis];
+        }
+        double ax = a[r.kx] - r.sx * a[r.kz], ay = a[r.ky] - r.sy * a[r.kz];
+        double bx = b[r.kx] - r.sx * b[r.kz], by = b[r.ky] - r.sy * b[r.kz];
+        double cx = c[r.kx] - r.sx * c[r.kz], cy = c[r.ky] - r.sy * c[r.kz];
+
+        double u = cx * by - cy * bx;
+        double v = ax * cy - ay * cx;
+        double w = bx * ay - by * ax;
+        if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+            return false;
+        double det = u + v + w;
+        if (det == 0)
+            return false;
+
+        double dist = (u * a[r.kz] + v * b[r.kz] + w * c[r.kz]) * r.sz / det;
+        if (!(dist > t_min && dist <= t_max))
+            return false;
+        t = float(dist);
+        b1 = float(v / det);
+        b2 = float(w / det);
+        return true;
+    }
+
+    /**
+     * @brief Intersects a ray with the W triangles of a packet at once.
+     *
+     * @param packet The triangles.
+     * @param index Index of the packet, recorded in `hit`.
+     * @param r The precomputed ray.
+     * @param t_min Start of the valid range of the ray.
+     * @param hit The closest hit so far; its `t` bounds the search and is lowered on a hit.
+     * @return True if a triangle closer than `hit.t` was found.
+     */
+    template <int W>
+    bool intersect_packet(const triangle_packet<W> &packet, uint32_t index, const triangle_ray &r,
+                          float t_min, triangle_hit &hit)
+    {
+        using vf = vfloat<W>;
+
+        // Vertices relative to the ray origin.
+        vf ox = vf::broadcast(r.origin[r.kx]), oy = vf::broadcast(r.origin[r.ky]), oz = vf::broadcast(r.origin[r.kz]);
+        vf az = vf::load(packet.v0[r.kz]) - oz;
+        vf bz = vf::load(packet.v1[r.kz]) - oz;
+        vf cz = vf::load(packet.v2[r.kz]) - oz;
+
+        // Shear into ray space.
+        vf sx = vf::broadcast(r.sx), sy = vf::broadcast(r.sy);
+        vf ax = (vf::load(packet.v0[r.kx]) - ox) - sx * az;
+        vf ay = (vf::load(packet.v0[r.ky]) - oy) - sy * az;
+        vf bx = (vf::load(packet.v1[r.kx]) - ox) - sx * bz;
+        vf by = (vf::load(packet.v1[r.ky]) - oy) - sy * bz;
+        vf cx = (vf::load(packet.v2[r.kx]) - ox) - sx * cz;
+        vf cy = (vf::load(packet.v2[r.ky]) - oy) - sy * cz;
+
+        // Scaled barycentric coordinates (2D edge functions).
+        vf u = cx * by - cy * bx;
+        vf v = ax * cy - ay * cx;
+        vf w = bx * ay - by * ax;
+
+        vf zero = vf::broadcast(0.0f);
+        int negative = ((u < zero) | (v < zero) | (w < zero)).bits();
+        int positive = ((u > zero) | (v > zero) | (w > zero)).bits();
+        int on_edge = (((u <= zero) & (u >= zero)) | ((v <= zero) & (v >= zero)) | ((w <= zero) & (w >= zero))).bits();
+        int inside = ~(negative & positive) & ~on_edge;
+
+        // Distance test without division: t_min * det < t * det <= t_max * det.
+        vf det = u + v + w;
+        vf dist = (u * az + v * bz + w * cz) * vf::broadcast(r.sz);
+        vf abs_det = vabs(det);
+        vf signed_dist = select(det < zero, zero - dist, dist);
+        inside &= (abs_det > zero).bits() &
+                  (signed_dist > vf::broadcast(t_min) * abs_det).bits() &
+                  (signed_dist <= vf::broadcast(hit.t) * abs_det).bits();
+        inside &= (1 << W) - 1;
+
+        bool found = false;
+        if (inside)
+        {
+            float t[W], b1[W], b2[W];
+            vf inv_det = vf::broadcast(1.0f) / det;
+            (dist * inv_det).store(t);
+            (v * inv_det).store(b1);
+            (w * inv_det).store(b2);
+            while (inside)
+            {
+                int i = __builtin_ctz(inside);
+                inside &= inside - 1;
+                if (t[i] <= hit.t)
+                {
+                    hit = {t[i], b1[i], b2[i], index, i};
+                    found = true;
+                }
+            }
+        }
+
+        on_edge &= (1 << W) - 1;
+        while (on_edge)
+        {
+            int i = __builtin_ctz(on_edge);
+            on_edge &= on_edge - 1;
+            float t, b1, b2;
+            if (intersect_lane_exact(packet, i, r, t_min, hit.t, t, b1, b2))
+            {
+                hit = {t, b1, b2, index, i};
+                found = true;
+            }
+        }
+        return found;
+    }
+} // namespace cobra
@@ -0,0 +1,294 @@
+#include "image/accumulation.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace cobra
+{
+    namespace
+    {
+        const char magic[8] = {'C', 'O', 'B', 'R', 'A', 'A', 'C', 'C'};
+        constexpr uint32_t version = 1;
+        constexpr size_t header_size = sizeof(magic) + 4 + 4 + 4 + 8 + 4 + 4 + 4 + 4 * 4 + 8 + 4;
+        constexpr size_t pixel_size = 5 * 8 + 4 + 1;
+        constexpr size_t pixel_aov_size = 7 * 8;
+        constexpr uint32_t flag_aovs = 1;
+
+        /// Appends little-endian values to a byte buffer.
+        struct encoder
+        {
+            unsigned char *out;
+
+            void u32(uint32_t v)
+            {
+                for (int b = 0; b < 4; ++b)
+                    *out++ = uint8_t(v >> (8 * b));
+            }
+
+            void u64(uint64_t v)
+            {
+                for (int b = 0; b < 8; ++b)
+                    *out++ = uint8_t(v >> (8 * b));
+            }
+
+            void f64(double v)
+            {
+                uint64_t bits;
+                std::memcpy(&bits, &v, sizeof(bits));
+                u64(bits);
+            }
+        };
+
+        /// Reads little-endian values from a byte buffer.
+        struct decoder
+        {
+            const unsigned char *in;
+
+            uint32_t u32()
+            {
+                uint32_t v = 0;
+                for (int b = 0; b < 4; ++b)
+                    v |= uint32_t(*in++) << (8 * b);
+                return v;
+            }
+
+            uint64_t u64()
+            {
+                uint64_t v = 0;
+                for (int b = 0; b < 8; ++b)
+                    v |= uint64_t(*in++) << (8 * b);
+                return v;
+            }
+
+            double f64()
+            {
+                uint64_t bits = u64();
+                double v;
+                std::memcpy(&v, &bits, sizeof(v));
+                return v;
+            }
+        };
+
+        bool fail(const std::string &message, std::string *error)
+        {
+            if (error)
+                *error = message;
+            return false;
+        }
+
+        std::unique_ptr<accumulation_buffer> fail_read(const std::string &message, std::string *error)
+        {
+            fail(message, error);
+            return nullptr;
+        }
+    } // namespace
+
+    size_t accumulation_buffer::sample_count() const
+    {
+        size_t count = 0;
+        for (const auto &p : pixels)
+            count += p.samples();
+        return count;
+    }
+
+    image accumulation_buffer::resolve(aov kind) const
+    {
+        image result(width, height);
+        if (kind != aov::color && !aovs)
+            return result;
+        for (size_t j = 0; j < height; ++j)
+            for (size_t i = 0; i < width; ++i)
+            {
+                const pixel_accumulator &p = at(i, j);
+                if (p.samples() == 0)
+                    continue;
+                double n = double(p.samples());
+                switch (kind)
+                {
+                case aov::color:
+                    result.set_pixel(j, i, p.sum / n);
+                    break;
+                case aov::albedo:
+                    result.set_pixel(j, i, p.aovs.albedo / n);
+                    break;
+                case aov::normal:
+                    result.set_pixel(j, i, 0.5 * (p.aovs.normal / n) + vec3(0.5, 0.5, 0.5));
+                    break;
+                case aov::depth:
+                    result.set_pixel(j, i, vec3(1, 1, 1) * (p.aovs.depth / n));
+                    break;
+                }
+            }
+        return result;
+    }
+
+    bool write_accumulation(const accumulation_buffer &buffer, const std::string &filename, std::string *error)
+    {
+        const size_t stride = pixel_size + (buffer.aovs ? pixel_aov_size : 0);
+        std::vector<unsigned char> data(header_size + stride * buffer.pixels.size());
+        std::memcpy(data.data(), magic, sizeof(magic));
+        encoder out{data.data() + sizeof(magic)};
+        out.u32(version);
+        out.u32(uint32_t(buffer.width));
+        out.u32(uint32_t(buffer.height));
+        out.u64(buffer.seed);
+        out.u32(uint32_t(buffer.batch_samples));
+        out.u32(buffer.adaptive ? 1 : 0);
+        out.u32(uint32_t(buffer.passes));
+        out.u32(uint32_t(buffer.x0));
+        out.u32(uint32_t(buffer.y0));
+        out.u32(uint32_t(buffer.image_width));
+        out.u32(uint32_t(buffer.image_height));
+        out.u64(buffer.sample_offset);
+        out.u32(buffer.aovs ? flag_aovs : 0);
+        for (const auto &p : buffer.pixels)
+        {
+            for (int c = 0; c < 3; ++c)
+                out.f64(p.sum[c]);
+            out.f64(p.luminance.mean());
+            out.f64(p.luminance.squared_deviations());
+            out.u32(uint32_t(p.samples()));
+            *out.out++ = p.done ? 1 : 0;
+            if (!buffer.aovs)
+                continue;
+            for (int c = 0; c < 3; ++c)
+                out.f64(p.aovs.albedo[c]);
+            for (int c = 0; c < 3; ++c)
+                out.f64(p.aovs.normal[c]);
+            out.f64(p.aovs.depth);
+        }
+
+        const std::string temporary = filename + ".tmp";
+        {
+            std::ofstream ofs(temporary, std::ios::binary);
+            if (!ofs.write(reinterpret_cast<const char *>(data.data()), std::streamsize(data.size())) || !(ofs.flush()))
+                return fail("cannot write " + temporary, error);
+        }
+        if (std::rename(temporary.c_str(), filename.c_str()) != 0)
+            return fail("cannot rename " + temporary + " to " + filename, error);
+        return true;
+    }
+
+    std::unique_ptr<accumulation_buffer> read_accumulation(const std::string &filename, std::string *error)
+    {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in)
+            return fail_read("cannot open " + filename, error);
+
+        unsigned char header[header_size];
+        if (!in.read(reinterpret_cast<char *>(header), sizeof(magic) + 4) || std::memcmp(header, magic, sizeof(magic)) != 0)
+            return fail_read(filename + ": not an accumulation file", error);
+        decoder h{header + sizeof(magic)};
+        if (h.u32() != version)
+            return fail_read(filename + ": unsupported accumulation file version", error);
+        if (!in.read(reinterpret_cast<char *>(header + sizeof(magic) + 4), header_size - sizeof(magic) - 4))
+            return fail_read(filename + ": truncated header", error);
+
+        auto buffer = std::make_unique<accumulation_buffer>();
+        buffer->width = h.u32();
+        buffer->height = h.u32();
+        buffer->seed = h.u64();
+        buffer->batch_samples = h.u32();
+        buffer->adaptive = h.u32() != 0;
+        buffer->passes = h.u32();
+        buffer->x0 = h.u32();
+        buffer->y0 = h.u32();
+        buffer->image_width = h.u32();
+        buffer->image_height = h.u32();
+        buffer->sample_offset = h.u64();
+        buffer->aovs = (h.u32() & flag_aovs) != 0;
+        if (buffer->x0 + buffer->width > buffer->image_width || buffer->y0 + buffer->height > buffer->image_height)
+            return fail_read(filename + ": region outside the image", error);
+
+        // Check the size the header announces against the file before allocating it.
+        const size_t stride = pixel_size + (buffer->aovs ? pixel_aov_size : 0);
+        const size_t pixel_count = buffer->width * buffer->height;
+        const std::streamoff start = in.tellg();
+        in.seekg(0, std::ios::end);
+        const std::streamoff end = in.tellg();
+        if (start < 0 || end < start || pixel_count > size_t(end - start) / stride)
+            return fail_read(filename + ": truncated pixel data", error);
+        in.seekg(start);
+        std::vector<unsigned char> data(stride * pixel_count);
+        if (!in.read(reinterpret_cast<char *>(data.data()), std::streamsize(data.size())))
+            return fail_read(filename + ": truncated pixel data", error);
+
+        buffer->pixels.resize(pixel_count);
+        decoder in_pixels{data.data()};
+        for (auto &p : buffer->pixels)
+        {
+            double sum[3];
+            for (double &c : sum)
+                c = in_pixels.f64();
+            p.sum = vec3(sum[0], sum[1], sum[2]);
+            double mean = in_pixels.f64();
+            double squared_deviations = in_pixels.f64();
+            size_t samples = in_pixels.u32();
+            p.luminance = running_stats(samples, mean, squared_deviations);
+            p.done = *in_pixels.in++ != 0;
+            if (!buffer->aovs)
+                continue;
+            double features[7];
+            for (double &f : features)
+                f = in_pixels.f64();
+            p.aovs.albedo = vec3(features[0], features[1], features[2]);
+            p.aovs.normal = vec3(features[3], features[4], features[5]);
+            p.aovs.depth = features[6];
+        }
+        return buffer;
+    }
+
+    bool merge_accumulations(const std::vector<const accumulation_buffer *> &parts, accumulation_buffer &result,
+                             std::string *error)
+    {
+        if (parts.empty())
+            return fail("nothing to merge", error);
+
+        const accumulation_buffer &first = *parts[0];
+        std::vector<size_t> max_samples(parts.size(), 0);
+        for (size_t k = 0; k < parts.size(); ++k)
+        {
+            const accumulation_buffer &part = *parts[k];
+            if (part.image_width != first.image_width || part.image_height != first.image_height || part.seed != first.seed)
+                return fail("the parts are not of the same image and seed", error);
+            for (const auto &p : part.pixels)
+                max_samples[k] = std::max(max_samples[k], p.samples());
+        }
+
+        // Parts that share pixels must have taken different samples of them.
+        for (size_t a = 0; a < parts.size(); ++a)
+            for (size_t b = a + 1; b < parts.size(); ++b)
+            {
+                const accumulation_buffer &pa = *parts[a], &pb = *parts[b];
+                bool shared = pa.x0 < pb.x0 + pb.width && pb.x0 < pa.x0 + pa.width &&
+                              pa.y0 < pb.y0 + pb.height && pb.y0 < pa.y0 + pa.height;
+                bool disjoint = pa.sample_offset + max_samples[a] <= pb.sample_offset ||
+                                pb.sample_offset + max_samples[b] <= pa.sample_offset;
+                if (shared && !disjoint && max_samples[a] > 0 && max_samples[b] > 0)
+                    return fail("parts " + std::to_string(a) + " and " + std::to_string(b) +
+                                    " took the same samples of some pixels",
+                                error);
+            }
+
+        result = accumulation_buffer(first.image_width, first.image_height, first.seed, first.batch_samples, first.adaptive);
+        result.aovs = std::all_of(parts.begin(), parts.end(), [](const accumulation_buffer *part)
+                                  { return part->aovs; });
+        std::vector<char> covered(result.pixels.size(), 0);
+        for (const accumulation_buffer *part : parts)
+            for (size_t j = 0; j < part->height; ++j)
+                for (size_t i = 0; i < part->width; ++i)
+                {
+                    const pixel_accumulator &p = part->at(i, j);
+                    size_t index = (part->y0 + j) * result.width + part->x0 + i;
+                    pixel_accumulator &merged = result.pixels[index];
+                    merged.sum += p.sum;
+                    merged.luminance.add(p.luminance);
+                    merged.aovs += p.aovs;
+                    merged.done = (merged.done || !covered[index]) && p.done;
+                    covered[index] = 1;
+                }
+        return true;
+    }
+} // namespace cobra
@@ -0,0 +1,154 @@
+#pragma once
+#include "cobra.h"
+#include "core/running_stats.h"
+#include "image/image.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief Features of the first hit of a sample (AOVs), or their sum over samples.
+     *
+     * A sample that hits nothing leaves them at zero.
+     */
+    struct aov_sample
+    {
+        vec3 albedo = vec3(0, 0, 0); ///< Albedo of the surface (material::surface_albedo).
+        vec3 normal = vec3(0, 0, 0); ///< Unit normal, facing the camera ray.
+        double depth = 0;            ///< Distance along the camera ray.
+
+        aov_sample &operator+=(const aov_sample &other)
+        {
+            albedo += other.albedo;
+            normal += other.normal;
+            depth += other.depth;
+            return *this;
+        }
+    };
+
+    /**
+     * @brief Image an accumulation buffer can be resolved to.
+     */
+    enum class aov
+    {
+        color,  ///< Mean sample color.
+        albedo, ///< Mean first-hit albedo.
+        normal, ///< Mean first-hit normal, mapped from [-1, 1] to [0, 1].
+        depth,  ///< Mean first-hit distance, in all three channels.
+    };
+
+    /**
+     * @brief What a progressive render knows about one pixel.
+     */
+    struct pixel_accumulator
+    {
+        vec3 sum = vec3(0, 0, 0); ///< Sum of the sample colors.
+        running_stats luminance;  ///< Count, mean and spread of the sample luminances.
+        bool done = false;        ///< The pixel gets no more samples.
+        aov_sample aovs;          ///< Sums of the first-hit features, if the buffer records them.
+
+        /// @return Number of samples taken.
+        size_t samples() const { return luminance.count(); }
+    };
+
+    /**
+     * @class accumulation_buffer
+     * @brief Per-pixel sample sums and counts of a render, which can be saved and resumed.
+     *
+     * Sample k of a pixel is keyed on (seed, pixel, k), so the counts are all the random
+     * state there is: a render resumed from a buffer draws the samples it would have drawn
+     * without stopping. The render settings the samples depend on are kept along, to
+     * refuse resuming with other ones.
+     *
+     * A buffer may hold a region of the image only, and samples starting at another index
+     * than 0, which is how the processes of a split render share a frame; the buffers of
+     * the parts are combined with merge_accumulations().
+     */
+    class accumulation_buffer
+    {
+    public:
+        size_t width = 0;                      ///< Width of the region held, in pixels.
+        size_t height = 0;                     ///< Height of the region held, in pixels.
+        size_t x0 = 0;                         ///< First column of the region in the image.
+        size_t y0 = 0;                         ///< First row of the region in the image.
+        size_t image_width = 0;                ///< Width of the whole image.
+        size_t image_height = 0;               ///< Height of the whole image.
+        size_t sample_offset = 0;              ///< Index of the first sample of every pixel.
+        uint64_t seed = 0;                     ///< Seed of the per-sample random sequences.
+        size_t batch_samples = 0;              ///< Samples of one stratified batch (square of the grid side).
+        bool adaptive = false;                 ///< The render stops sampling pixels that converged.
+        size_t passes = 0;                     ///< Passes over the image completed; each gives a batch to every pixel not done.
+        bool aovs = false;                     ///< The pixels hold the sums of the first-hit features too.
+        std::vector<pixel_accumulator> pixels; ///< Row-major.
+
+        /// @brief Constructs an empty buffer.
+        accumulation_buffer() = default;
+
+        /// @brief Constructs a buffer with no samples, covering the whole image.
+        accumulation_buffer(size_t width, size_t height, uint64_t seed, size_t batch_samples, bool adaptive)
+            : width(width), height(height), image_width(width), image_height(height), seed(seed),
+              batch_samples(batch_samples), adaptive(adaptive), pixels(width * height)
+        {
+        }
+
+        /// @return The pixel at column `i`, row `j`.
+        pixel_accumulator &at(size_t i, size_t j) { return pixels[j * width + i]; }
+        const pixel_accumulator &at(size_t i, size_t j) const { return pixels[j * width + i]; }
+
+        /// @return Total number of samples over all pixels.
+        size_t sample_count() const;
+
+        /**
+         * @brief Averages the samples of each pixel into an image.
+         * @param kind Color or feature to average; features are black if the buffer has none.
+         * @return The mean of the samples of each pixel, black where there are none.
+         */
+        image resolve(aov kind = aov::color) const;
+    };
+
+    /**
+     * @brief Writes an accumulation buffer to a binary file.
+     *
+     * The file is written next to `filename` and renamed over it, so an interruption
+     * never leaves a truncated file behind. Little-endian, a header with the settings and
+     * the region, then 45 bytes per pixel of the region: the sum as three doubles, the
+     * luminance mean and sum of squared deviations as doubles, the sample count as a
+     * 32-bit integer and the done flag as a byte. A buffer with AOVs has 7 more doubles
+     * per pixel: the albedo, normal and depth sums.
+     *
+     * @param buffer The buffer.
+     * @param filename Path of the file.
+     * @param error If not null, receives a message when writing fails.
+     * @return True on success.
+     */
+    bool write_accumulation(const accumulation_buffer &buffer, const std::string &filename, std::string *error = nullptr);
+
+    /**
+     * @brief Reads an accumulation file written by write_accumulation.
+     * @param filename Path of the file.
+     * @param error If not null, receives a message when reading fails.
+     * @return The buffer, or nullptr on failure.
+     */
+    std::unique_ptr<accumulation_buffer> read_accumulation(const std::string &filename, std::string *error = nullptr);
+
+    /**
+     * @brief Combines the buffers of the parts of a split render into one for the whole image.
+     *
+     * Sums, counts and luminance statistics are added pixel by pixel, so the mean of a
+     * pixel weighs each part by its number of samples. The result has AOVs if all the
+     * parts have them. Parts may cover different regions,
+     * or the same pixels with different sample ranges; pixels no part covers stay empty.
+     *
+     * @param parts The buffers; they must be of the same image and seed, and the sample
+     * ranges of the parts covering a pixel must not overlap.
+     * @param result Receives the merged buffer.
+     * @param error If not null, receives a message when the parts do not fit together.
+     * @return True on success.
+     */
+    bool merge_accumulations(const std::vector<const accumulation_buffer *> &parts, accumulation_buffer &result,
+                             std::string *error = nullptr);
+} // namespace cobra
@@ -0,0 +1,271 @@
+#include "image/denoiser.h"
+#include "core/simd.h"
+#include "core/parallel_chunks.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace cobra
+{
+    namespace
+    {
+#ifdef COBRA_AVX
+        constexpr int lanes = 8;
+#else
+        constexpr int lanes = 4;
+#endif
+        using vf = vfloat<lanes>;
+
+        /// B3-spline taps of the à-trous kernel, separable.
+        constexpr float taps[5] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+
+        /// Keeps the divisions of the weights finite where a feature is flat.
+        constexpr float epsilon = 1e-6f;
+
+        /// Albedo below which a channel is not divided out (black surfaces, background).
+        constexpr double min_albedo = 1e-3;
+
+        /// Number of planes that change at every iteration: color and variance.
+        constexpr int filtered_planes = 4;
+
+        /**
+         * @brief Image planes with a clamped border, so the kernel never tests its bounds.
+         */
+        struct planes
+        {
+            size_t width = 0, height = 0, pad = 0, stride = 0;
+            std::vector<std::vector<float>> data;
+
+            planes(size_t width, size_t height, size_t pad, size_t count)
+                : width(width), height(height), pad(pad), stride(width + 2 * pad),
+                  data(count, std::vector<float>(stride * (height + 2 * pad), 0.0f))
+            {
+            }
+
+            /// @return Offset of pixel (i, j) in a plane.
+            size_t offset(size_t i, size_t j) const { return (j + pad) * stride + pad + i; }
+
+            /// @brief Copies the edge pixels of rows [y0, y1) of a plane into the side borders.
+            void pad_rows(size_t plane, size_t y0, size_t y1)
+            {
+                std::vector<float> &p = data[plane];
+                for (size_t j = y0; j < y1; ++j)
+                {
+                    float *row = &p[offset(0, j)];
+                    std::fill(row - pad, row, row[0]);
+                    std::fill(row + width, row + width + pad, row[width - 1]);
+                }
+            }
+
+            /// @brief Copies the first and last rows of a plane, borders included, into the top and bottom borders.
+            void pad_columns(size_t plane)
+            {
+                std::vector<float> &p = data[plane];
+                const float *first = &p[pad * stride];
+                const float *last = &p[(pad + height - 1) * stride];
+                for (size_t j = 0; j < pad; ++j)
+                {
+                    std::copy(first, first + stride, &p[j * stride]);
+                    std::copy(last, last + stride, &p[(pad + height + j) * stride]);
+                }
+            }
+        };
+
+        /// exp(-x) for x >= 0, as (1 - x/16)^16: a few multiplies, within 0.02 of the exponential.
+        inline vf negative_exp(const vf &x)
+        {
+            vf y = vmax(vf::broadcast(0.0f), vf::broadcast(1.0f) - x * vf::broadcast(1.0f / 16));
+            y = y * y;
+            y = y * y;
+            y = y * y;
+            return y * y;
+        }
+
+        inline vf luminance(const vf &r, const vf &g, const vf &b)
+        {
+            return vf::broadcast(0.2126f) * r + vf::broadcast(0.7152f) * g + vf::broadcast(0.0722f) * b;
+        }
+
+        /// Plane indices: filtered color and variance, then the guides.
+        enum plane_index
+        {
+            red,
+            green,
+            blue,
+            variance,
+            albedo_r,
+            albedo_g,
+            albedo_b,
+            normal_x,
+            normal_y,
+            normal_z,
+            depth,
+            plane_count
+        };
+
+        /**
+         * @brief One à-trous pass over rows [y0, y1), reading `in` and writing the filtered planes of `out`.
+         */
+        void filter_rows(const planes &in, planes &out, size_t y0, size_t y1, size_t step, bool guided,
+                         const denoise_options &options)
+        {
+            const float inv_normal = float(1 / (options.sigma_normal * options.sigma_normal));
+            const float inv_albedo = float(1 / (options.sigma_albedo * options.sigma_albedo));
+            const float depth_scale = float(options.sigma_depth * options.sigma_depth);
+            const float color_scale = float(options.sigma_color * options.sigma_color);
+            const auto plane = [&](int k)
+            { return in.data[k].data(); };
+
+            for (size_t j = y0; j < y1; ++j)
+            {
+                for (size_t i = 0; i < in.width; i += lanes)
+                {
+                    const size_t p = in.offset(i, j);
+                    const vf zero = vf::broadcast(0.0f);
+                    vf l_p = luminance(vf::load(plane(red) + p), vf::load(plane(green) + p), vf::load(plane(blue) + p));
+
+                    // The variance of a lone pixel is noisy itself: its 3x3 neighbourhood sets the luminance weight.
+                    vf local_variance = zero;
+                    for (int dy = -1; dy <= 1; ++dy)
+                        for (int dx = -1; dx <= 1; ++dx)
+                            local_variance = local_variance + vf::load(plane(variance) + p + dy * ptrdiff_t(in.stride) + dx);
+                    vf inv_color = vf::broadcast(1.0f) / (vf::broadcast(color_scale / 9) * local_variance + vf::broadcast(epsilon));
+
+                    vf a_r = zero, a_g = zero, a_b = zero, n_x = zero, n_y = zero, n_z = zero, z_p = zero, inv_depth = zero;
+                    if (guided)
+                    {
+                        a_r = vf::load(plane(albedo_r) + p);
+                        a_g = vf::load(plane(albedo_g) + p);
+                        a_b = vf::load(plane(albedo_b) + p);
+                        n_x = vf::load(plane(normal_x) + p);
+                        n_y = vf::load(plane(normal_y) + p);
+                        n_z = vf::load(plane(normal_z) + p);
+                        z_p = vf::load(plane(depth) + p);
+                        inv_depth = vf::broadcast(1.0f) / (vf::broadcast(depth_scale) * z_p * z_p + vf::broadcast(epsilon));
+                    }
+
+                    vf weight_sum = zero, variance_sum = zero, r_sum = zero, g_sum = zero, b_sum = zero;
+                    for (int ky = 0; ky < 5; ++ky)
+                    {
+                        const ptrdiff_t row = (ky - 2) * ptrdiff_t(step * in.stride);
+                        for (int kx = 0; kx < 5; ++kx)
+                        {
+                            const size_t q = size_t(ptrdiff_t(p) + row + (kx - 2) * ptrdiff_t(step));
+                            vf r_q = vf::load(plane(red) + q), g_q = vf::load(plane(green) + q), b_q = vf::load(plane(blue) + q);
+                            vf dl = luminance(r_q, g_q, b_q) - l_p;
+                            vf distance = dl * dl * inv_color;
+                            if (guided)
+                            {
+                                vf dr = vf::load(plane(albedo_r) + q) - a_r, dg = vf::load(plane(albedo_g) + q) - a_g,
+                                   db = vf::load(plane(albedo_b) + q) - a_b;
+                                vf nx = vf::load(plane(normal_x) + q) - n_x, ny = vf::load(plane(normal_y) + q) - n_y,
+                                   nz = vf::load(plane(normal_z) + q) - n_z;
+                                vf dz = vf::load(plane(depth) + q) - z_p;
+                                distance = distance + (dr * dr + dg * dg + db * db) * vf::broadcast(inv_albedo) +
+                                           (nx * nx + ny * ny + nz * nz) * vf::broadcast(inv_normal) + dz * dz * inv_depth;
+                            }
+                            vf w = vf::broadcast(taps[ky] * taps[kx]) * negative_exp(distance);
+                            weight_sum = weight_sum + w;
+                            r_sum = r_sum + w * r_q;
+                            g_sum = g_sum + w * g_q;
+                            b_sum = b_sum + w * b_q;
+                            variance_sum = variance_sum + w * w * vf::load(plane(variance) + q);
+                        }
+                    }
+
+                    // The center weighs taps[2]^2 at least, so the sum is never 0.
+                    vf inv_sum = vf::broadcast(1.0f) / weight_sum;
+                    (r_sum * inv_sum).store(out.data[red].data() + p);
+                    (g_sum * inv_sum).store(out.data[green].data() + p);
+                    (b_sum * inv_sum).store(out.data[blue].data() + p);
+                    (variance_sum * inv_sum * inv_sum).store(out.data[variance].data() + p);
+                }
+                for (int k = 0; k < filtered_planes; ++k)
+                    out.pad_rows(k, j, j + 1);
+            }
+        }
+    } // namespace
+
+    image denoise(const accumulation_buffer &buffer, const denoise_options &options)
+    {
+        const size_t width = buffer.width, height = buffer.height;
+        image result(width, height);
+        if (width == 0 || height == 0)
+            return result;
+
+        const int iterations = std::max(1, options.iterations);
+        // Room for the widest hole, plus the lanes of the last pack of a row that run past the edge.
+        const size_t pad = (size_t(2) << (iterations - 1)) + lanes;
+        planes front(width, height, pad, plane_count);
+        planes back(width, height, pad, plane_count);
+
+        // Demodulated color, variance of its mean luminance, and guides.
+        std::vector<vec3> divisor(width * height, vec3(1, 1, 1));
+        for (size_t j = 0; j < height; ++j)
+            for (size_t i = 0; i < width; ++i)
+            {
+                const pixel_accumulator &p = buffer.at(i, j);
+                if (p.samples() == 0)
+                    continue;
+                const double n = double(p.samples());
+                const size_t o = front.offset(i, j);
+                vec3 &d = divisor[j * width + i];
+                if (buffer.aovs)
+                {
+                    const vec3 albedo = p.aovs.albedo / n, normal = p.aovs.normal / n;
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        d[c] = albedo[c] > min_albedo ? albedo[c] : 1;
+                        front.data[albedo_r + c][o] = float(albedo[c]);
+                        front.data[normal_x + c][o] = float(normal[c]);
+                    }
+                    front.data[depth][o] = float(p.aovs.depth / n);
+                }
+                const vec3 mean = p.sum / n;
+                for (int c = 0; c < 3; ++c)
+                    front.data[red + c][o] = float(mean[c] / d[c]);
+                const double scale = std::max(cobra::luminance(d), min_albedo);
+                front.data[variance][o] = float(p.luminance.variance() / (n * scale * scale));
+            }
+        for (int k = 0; k < plane_count; ++k)
+        {
+            front.pad_rows(k, 0, height);
+            front.pad_columns(k);
+        }
+        // The guides do not change: both sides share them.
+        for (int k = filtered_planes; k < plane_count; ++k)
+            back.data[k] = front.data[k];
+
+        const size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+        const size_t threads = std::min(options.threads > 0 ? options.threads : hardware, height);
+        for (int iteration = 0; iteration < iterations; ++iteration)
+        {
+            const size_t step = size_t(1) << iteration;
+            parallel_chunks(threads, [&](size_t chunk)
+                            { filter_rows(front, back, height * chunk / threads, height * (chunk + 1) / threads, step,
+                                          buffer.aovs, options); });
+            for (int k = 0; k < filtered_planes; ++k)
+                back.pad_columns(k);
+            std::swap(front.data, back.data);
+        }
+
+        for (size_t j = 0; j < height; ++j)
+            for (size_t i = 0; i < width; ++i)
+            {
+                const pixel_accumulator &p = buffer.at(i, j);
+                if (p.samples() == 0)
+                    continue;
+                if (p.samples() == 1)
+                {
+                    result.set_pixel(j, i, p.sum);
+                    continue;
+                }
+                const size_t o = front.offset(i, j);
+                const vec3 &d = divisor[j * width + i];
+                result.set_pixel(j, i, vec3(front.data[red][o] * d[0], front.data[green][o] * d[1], front.data[blue][o] * d[2]));
+            }
+        return result;
+    }
+} // namespace cobra
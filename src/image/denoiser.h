@@ -0,0 +1,47 @@
+#pragma once
+#include "image/accumulation.h"
+#include "image/image.h"
+
+#include <cstddef>
+
+namespace cobra
+{
+    /**
+     * @brief Parameters of denoise().
+     *
+     * The sigmas set how different two pixels may be before they stop being averaged
+     * together: larger values blur more across edges.
+     */
+    struct denoise_options
+    {
+        int iterations = 5;          ///< Passes of the 5x5 kernel, at spacings 1, 2, 4...; the footprint is 4 * 2^iterations pixels.
+        double sigma_color = 4;      ///< Luminance difference, in standard errors of the pixel's mean.
+        double sigma_normal = 0.3;   ///< Distance between the normals.
+        double sigma_albedo = 0.1;   ///< Distance between the albedos.
+        double sigma_depth = 0.05;   ///< Depth difference, relative to the pixel's depth.
+        size_t threads = 0;          ///< Worker threads, 0 for all hardware threads.
+    };
+
+    /**
+     * @brief Removes the sampling noise of a render, guided by its first-hit features.
+     *
+     * Edge-avoiding à-trous wavelet filter (Dammertz et al. 2010): a 5x5 B-spline kernel
+     * applied `iterations` times with holes growing by powers of two, each neighbour
+     * weighted by how close its albedo, normal, depth and luminance are to the pixel's.
+     * The color is divided by the albedo before filtering and multiplied back after, so
+     * that textures stay sharp and only the lighting is smoothed. The luminance weight is
+     * scaled by the standard error of the pixel's mean, from the luminance statistics of
+     * the buffer, and that variance is filtered along, so noisy pixels are smoothed more
+     * than converged ones and the filter eases off as it goes.
+     *
+     * Without AOVs in the buffer, only the luminance guides the filter. Pixels need at
+     * least two samples for their variance to be known; with one, they keep their sample.
+     * The planes are kept in single precision and the kernel runs on vfloat, with the
+     * rows split across threads.
+     *
+     * @param buffer Samples of the render (see camera::aovs).
+     * @param options Filter parameters.
+     * @return The denoised image, the size of the buffer.
+     */
+    image denoise(const accumulation_buffer &buffer, const denoise_options &options = denoise_options());
+} // namespace cobra
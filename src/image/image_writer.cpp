@@ -0,0 +1,44 @@
+#include "image/image_writer.h"
+#include "image/ppm_writer.h"
+#include "image/pfm_writer.h"
+#include <algorithm>
+#include <cctype>
+#include <thread>
+#include <vector>
+
+namespace cobra
+{
+    std::unique_ptr<image_writer> image_writer::create(const std::string &filename)
+    {
+        size_t dot = filename.find_last_of('.');
+        if (dot == std::string::npos)
+            return nullptr;
+
+        std::string extension = filename.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c)
+                       { return char(std::tolower(c)); });
+
+        if (extension == "ppm")
+            return std::make_unique<ppm_writer>();
+        if (extension == "pfm")
+            return std::make_unique<pfm_writer>();
+        return nullptr;
+    }
+
+    void image_writer::encode_rows(size_t height, const std::function<void(size_t, size_t)> &encode)
+    {
+        // Blocks of at least 16 rows keep small images on a single thread.
+        const size_t min_rows = 16;
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::max<size_t>(1, std::min(threads, height / min_rows));
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t t = 1; t < threads; ++t)
+            pool.emplace_back(encode, t * height / threads, (t + 1) * height / threads);
+        encode(0, height / threads);
+        for (auto &thread : pool)
+            thread.join();
+    }
+}
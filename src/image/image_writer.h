@@ -2,6 +2,8 @@
 
 #include <string>
 #include <iostream>
+#include <functional>
+#include <memory>
 #include "image/image.h"
 
 namespace cobra
@@ -49,6 +51,28 @@ namespace cobra
          * @return true if writing succeeded, false otherwise.
          */
         virtual bool write(const image &image, std::string filename) const = 0;
+
+        /**
+         * @brief Creates the writer matching the extension of a file name.
+         *
+         * `.ppm` gives a binary ppm_writer, `.pfm` a pfm_writer. The comparison ignores case.
+         *
+         * @param filename The path the image will be written to.
+         * @return The writer, or nullptr if the extension is not supported.
+         */
+        static std::unique_ptr<image_writer> create(const std::string &filename);
+
+    protected:
+        /**
+         * @brief Runs an encoding function over blocks of rows, in parallel.
+         *
+         * Each block is handled by one thread, so the function can write the rows
+         * straight into their place in a shared output buffer.
+         *
+         * @param height Number of rows.
+         * @param encode Called as `encode(first_row, end_row)` on disjoint row ranges.
+         */
+        static void encode_rows(size_t height, const std::function<void(size_t, size_t)> &encode);
     };
 
     inline image_writer::~image_writer()
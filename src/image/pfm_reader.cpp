@@ -0,0 +1,66 @@
+#include "image/pfm_reader.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace cobra
+{
+    namespace
+    {
+        std::unique_ptr<image> fail(const std::string &message, std::string *error)
+        {
+            if (error)
+                *error = message;
+            return nullptr;
+        }
+    } // namespace
+
+    std::unique_ptr<image> read_pfm(const std::string &filename, std::string *error)
+    {
+        std::ifstream in(filename, std::ios::binary);
+        if (!in)
+            return fail("cannot open " + filename, error);
+
+        std::string magic;
+        long width = 0, height = 0;
+        double scale = 0;
+        in >> magic >> width >> height >> scale;
+        if (!in || (magic != "PF" && magic != "Pf") || width <= 0 || height <= 0 || scale == 0)
+            return fail(filename + ": not a PFM file", error);
+        in.get(); // Single whitespace before the data.
+
+        const size_t channels = magic == "PF" ? 3 : 1;
+        std::vector<unsigned char> data(channels * sizeof(float) * size_t(width) * size_t(height));
+        if (!in.read(reinterpret_cast<char *>(data.data()), std::streamsize(data.size())))
+            return fail(filename + ": truncated pixel data", error);
+
+        // A negative scale marks little-endian data.
+        const bool little_endian = scale < 0;
+        auto value = [&](size_t index)
+        {
+            const unsigned char *b = data.data() + index * sizeof(float);
+            uint32_t bits = little_endian
+                                ? uint32_t(b[0]) | uint32_t(b[1]) << 8 | uint32_t(b[2]) << 16 | uint32_t(b[3]) << 24
+                                : uint32_t(b[3]) | uint32_t(b[2]) << 8 | uint32_t(b[1]) << 16 | uint32_t(b[0]) << 24;
+            float v;
+            std::memcpy(&v, &bits, sizeof(v));
+            return v;
+        };
+
+        auto img = std::make_unique<image>(size_t(width), size_t(height));
+        for (size_t y = 0; y < size_t(height); ++y)
+        {
+            size_t row = (size_t(height) - 1 - y) * size_t(width);
+            for (size_t x = 0; x < size_t(width); ++x)
+            {
+                size_t first = (row + x) * channels;
+                if (channels == 3)
+                    img->set_pixel(y, x, vec3(value(first), value(first + 1), value(first + 2)));
+                else
+                    img->set_pixel(y, x, vec3(value(first), value(first), value(first)));
+            }
+        }
+        return img;
+    }
+} // namespace cobra
@@ -0,0 +1,21 @@
+#pragma once
+#include "image/image.h"
+
+#include <memory>
+#include <string>
+
+namespace cobra
+{
+    /**
+     * @brief Reads a PFM (Portable Float Map) file, as written by pfm_writer.
+     *
+     * Accepts color ("PF") and grayscale ("Pf") maps in either byte order; grayscale
+     * values are copied to the three channels. Rows are stored bottom to top in the file
+     * and returned top to bottom.
+     *
+     * @param filename Path of the file.
+     * @param error If not null, receives a message when reading fails.
+     * @return The image, or nullptr on failure.
+     */
+    std::unique_ptr<image> read_pfm(const std::string &filename, std::string *error = nullptr);
+} // namespace cobra
@@ -0,0 +1,57 @@
+#include "image/pfm_writer.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace cobra
+{
+    pfm_writer::pfm_writer() {}
+
+    pfm_writer::~pfm_writer() {}
+
+    bool pfm_writer::write(const image &img, std::ostream &os) const
+    {
+        const size_t width = img.get_width();
+        const size_t height = img.get_height();
+
+        // A negative scale marks little-endian data.
+        std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+        std::vector<unsigned char> buffer(header.size() + 3 * sizeof(float) * width * height);
+        std::copy(header.begin(), header.end(), buffer.begin());
+        unsigned char *pixels = buffer.data() + header.size();
+
+        encode_rows(height, [&](size_t first_row, size_t end_row)
+                    {
+                        for (size_t y = first_row; y < end_row; ++y)
+                        {
+                            unsigned char *out = pixels + 3 * sizeof(float) * width * (height - 1 - y);
+                            for (size_t x = 0; x < width; ++x)
+                            {
+                                vec3 color = img.get_pixel(y, x);
+                                for (int c = 0; c < 3; ++c)
+                                {
+                                    float v = float(color[c]);
+                                    uint32_t bits;
+                                    std::memcpy(&bits, &v, sizeof(bits));
+                                    *out++ = uint8_t(bits);
+                                    *out++ = uint8_t(bits >> 8);
+                                    *out++ = uint8_t(bits >> 16);
+                                    *out++ = uint8_t(bits >> 24);
+                                }
+                            }
+                        } });
+
+        os.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size()));
+        return bool(os);
+    }
+
+    bool pfm_writer::write(const image &img, std::string filename) const
+    {
+        std::ofstream ofs(filename, std::ios::binary);
+        if (!ofs.is_open())
+            return false;
+
+        return write(img, ofs);
+    }
+}
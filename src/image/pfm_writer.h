@@ -0,0 +1,44 @@
+#pragma once
+#include "image/image_writer.h"
+
+namespace cobra
+{
+    /**
+     * @brief Concrete image writer for the PFM (Portable Float Map) format.
+     *
+     * Stores the linear colors as 32-bit floats, without gamma or clamping, so that
+     * HDR renders can be post-processed or compared. Rows are written bottom to top,
+     * in little-endian order, as the format requires.
+     */
+    class pfm_writer : public image_writer
+    {
+    public:
+        /**
+         * @brief Constructs a new pfm_writer object.
+         */
+        pfm_writer();
+
+        /**
+         * @brief Destructor for pfm_writer.
+         */
+        ~pfm_writer();
+
+        /**
+         * @brief Writes the given image to an output stream in PFM format.
+         *
+         * @param image The image to write.
+         * @param os The output stream to write to.
+         * @return true if writing succeeds, false otherwise.
+         */
+        bool write(const image &image, std::ostream &os) const override;
+
+        /**
+         * @brief Writes the given image to a file in PFM format.
+         *
+         * @param image The image to write.
+         * @param filename The file path to save the image.
+         * @return true if writing succeeds, false otherwise.
+         */
+        bool write(const image &image, std::string filename) const override;
+    };
+}
@@ -1,11 +1,13 @@
 #include "image/ppm_writer.h"
 #include <fstream>
 #include <cmath>
+#include <string>
+#include <vector>
 #include "image_writer.h"
 
 namespace cobra
 {
-    ppm_writer::ppm_writer() {}
+    ppm_writer::ppm_writer(bool ascii) : ascii(ascii) {}
 
     ppm_writer::~ppm_writer() {}
 
@@ -17,43 +19,62 @@ namespace cobra
         return 0;
     }
 
+    unsigned char ppm_writer::quantize(double linear_component) const
+    {
+        // NaN compares false and ends up as 0.
+        double v = linear_to_gamma(linear_component) * 255.0;
+        if (!(v > 0))
+            return 0;
+        return v >= 255 ? 255 : static_cast<unsigned char>(v);
+    }
+
     bool ppm_writer::write(const image &img, std::ostream &os) const
     {
         const size_t width = img.get_width();
         const size_t height = img.get_height();
 
-        os << "P3\n"
-           << width << " " << height << "\n255\n";
-        for (size_t y = 0; y < height; ++y)
+        if (ascii)
         {
-            for (size_t x = 0; x < width; ++x)
+            os << "P3\n"
+               << width << " " << height << "\n255\n";
+            for (size_t y = 0; y < height; ++y)
             {
-                vec3 color = img.get_pixel(y, x);
-                auto r = color.x();
-                auto g = color.y();
-                auto b = color.z();
-
-                if (r != r)
-                    r = 0.0;
-                if (g != g)
-                    g = 0.0;
-                if (b != b)
-                    b = 0.0;
-
-                r = std::min(255, std::max(0, static_cast<int>(linear_to_gamma(r) * 255.0)));
-                g = std::min(255, std::max(0, static_cast<int>(linear_to_gamma(g) * 255.0)));
-                b = std::min(255, std::max(0, static_cast<int>(linear_to_gamma(b) * 255.0)));
-                os << r << " " << g << " " << b << " ";
+                for (size_t x = 0; x < width; ++x)
+                {
+                    vec3 color = img.get_pixel(y, x);
+                    os << int(quantize(color.x())) << " " << int(quantize(color.y())) << " " << int(quantize(color.z())) << " ";
+                }
+                os << "\n";
             }
-            os << "\n";
+            return bool(os);
         }
 
-        return true;
+        std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+        std::vector<unsigned char> buffer(header.size() + 3 * width * height);
+        std::copy(header.begin(), header.end(), buffer.begin());
+        unsigned char *pixels = buffer.data() + header.size();
+
+        encode_rows(height, [&](size_t first_row, size_t end_row)
+                    {
+                        for (size_t y = first_row; y < end_row; ++y)
+                        {
+                            unsigned char *out = pixels + 3 * width * y;
+                            for (size_t x = 0; x < width; ++x)
+                            {
+                                vec3 color = img.get_pixel(y, x);
+                                *out++ = quantize(color.x());
+                                *out++ = quantize(color.y());
+                                *out++ = quantize(color.z());
+                            }
+                        } });
+
+        os.write(reinterpret_cast<const char *>(buffer.data()), std::streamsize(buffer.size()));
+        return bool(os);
     }
 
     bool ppm_writer::write(const image &img, std::string filename) const
     {
-        std::ofstream ofs(filename);
+        std::ofstream ofs(filename, std::ios::binary);
         if (!ofs.is_open())
             return false;
 
@@ -6,16 +6,20 @@ namespace cobra
     /**
      * @brief Concrete image writer for the PPM image format.
      * 
-     * Implements writing images in the plain PPM (Portable Pixmap) format,
+     * Implements writing images in the PPM (Portable Pixmap) format,
      * supporting output to both std::ostream and file paths.
+     * Writes binary P6 by default: colors are gamma-encoded and quantized in parallel
+     * row blocks into a single buffer, which is written at once. The plain-text P3
+     * variant is still available.
      */
     class ppm_writer : public image_writer
     {
     public:
         /**
          * @brief Constructs a new ppm_writer object.
+         * @param ascii Write plain-text P3 instead of binary P6.
          */
-        ppm_writer();
+        ppm_writer(bool ascii = false);
 
         /**
          * @brief Destructor for ppm_writer.
@@ -46,5 +50,15 @@ namespace cobra
          * @return The converted value.
          */
         double linear_to_gamma(double linear_component) const;
+
+        /**
+         * @brief Converts a linear value to an 8-bit gamma-encoded value.
+         * @param linear_component The value to convert; NaN and negatives give 0.
+         * @return The quantized value.
+         */
+        unsigned char quantize(double linear_component) const;
+
+    private:
+        bool ascii; ///< True to write P3 instead of P6.
     };
 }
@@ -0,0 +1,65 @@
+#include "io/mapped_file.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define COBRA_HAS_MMAP 1
+#endif
+
+namespace cobra
+{
+    mapped_file::mapped_file(const std::string &filename)
+    {
+#ifdef COBRA_HAS_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat info;
+        if (::fstat(fd, &info) == 0)
+        {
+            length = size_t(info.st_size);
+            if (length == 0)
+                opened = true;
+            else
+            {
+                void *p = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    // The parsers walk the file front to back, in a few parallel streams.
+                    ::madvise(p, length, MADV_SEQUENTIAL);
+                    bytes = static_cast<const char *>(p);
+                    opened = true;
+                    mapped = true;
+                }
+            }
+        }
+        ::close(fd);
+        if (opened)
+            return;
+#endif
+
+        std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+        if (!ifs.is_open())
+            return;
+        length = size_t(ifs.tellg());
+        fallback.resize(length);
+        ifs.seekg(0);
+        if (!ifs.read(fallback.data(), std::streamsize(length)))
+            return;
+        bytes = fallback.data();
+        opened = true;
+    }
+
+    mapped_file::~mapped_file()
+    {
+#ifdef COBRA_HAS_MMAP
+        if (mapped)
+            ::munmap(const_cast<char *>(bytes), length);
+#endif
+    }
+} // namespace cobra
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @class mapped_file
+     * @brief Read-only view of a whole file, memory-mapped where the platform allows it.
+     *
+     * On POSIX systems the file is mapped with mmap, so parsers read it straight from
+     * the page cache without copying it. Elsewhere it falls back to reading the file
+     * into memory once.
+     */
+    class mapped_file
+    {
+    public:
+        /**
+         * @brief Opens and maps a file.
+         * @param filename Path of the file; check is_open() for success.
+         */
+        explicit mapped_file(const std::string &filename);
+
+        ~mapped_file();
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        /// @return True if the file could be opened and mapped.
+        bool is_open() const { return opened; }
+
+        /// @return The first byte of the file (may be null for an empty file).
+        const char *data() const { return bytes; }
+
+        /// @return The size of the file in bytes.
+        size_t size() const { return length; }
+
+    private:
+        const char *bytes = nullptr;
+        size_t length = 0;
+        bool opened = false;
+        bool mapped = false;
+        std::vector<char> fallback; ///< File contents when mmap is not available.
+    };
+} // namespace cobra
@@ -0,0 +1,24 @@
+#include "io/mesh_loader.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace cobra
+{
+    bool load_mesh(const std::string &filename, mesh_data &mesh, std::string *error)
+    {
+        std::string extension = filename.substr(filename.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c)
+                       { return char(std::tolower(c)); });
+
+        if (extension == "obj")
+            return load_obj(filename, mesh, error);
+        if (extension == "ply")
+            return load_ply(filename, mesh, error);
+
+        if (error)
+            *error = "unknown mesh format: " + filename;
+        return false;
+    }
+} // namespace cobra
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief Triangle geometry loaded from a file, in compact flat arrays.
+     *
+     * Positions are single-precision xyz triples; each triangle is three indices into
+     * them. Polygons are fan-triangulated on load. A mesh costs 12 bytes per vertex and
+     * 12 bytes per triangle.
+     */
+    struct mesh_data
+    {
+        std::vector<float> positions;  ///< x, y, z of every vertex.
+        std::vector<uint32_t> indices; ///< Three vertex indices per triangle.
+
+        /// @return Number of vertices.
+        size_t vertex_count() const { return positions.size() / 3; }
+
+        /// @return Number of triangles.
+        size_t triangle_count() const { return indices.size() / 3; }
+    };
+
+    /**
+     * @brief Loads the geometry of a Wavefront OBJ file.
+     *
+     * Reads `v` and `f` statements (including negative, relative indices); texture
+     * coordinates, normals, groups and materials are ignored. The file is memory-mapped
+     * and parsed in parallel chunks: a first pass counts vertices and triangles per
+     * chunk, a second one writes them straight to their final place.
+     *
+     * @param filename Path of the file.
+     * @param mesh Receives the geometry.
+     * @param error If not null, receives a message when loading fails.
+     * @return True on success.
+     */
+    bool load_obj(const std::string &filename, mesh_data &mesh, std::string *error = nullptr);
+
+    /**
+     * @brief Loads the geometry of a binary (little or big endian) PLY file.
+     *
+     * Reads the x, y, z properties of the `vertex` element and the index list of the
+     * `face` element; other elements and properties are skipped. Vertices, and faces
+     * when they are all triangles, are decoded in parallel chunks.
+     *
+     * @param filename Path of the file.
+     * @param mesh Receives the geometry.
+     * @param error If not null, receives a message when loading fails.
+     * @return True on success.
+     */
+    bool load_ply(const std::string &filename, mesh_data &mesh, std::string *error = nullptr);
+
+    /**
+     * @brief Loads a mesh, choosing the format from the file extension (.obj or .ply).
+     * @param filename Path of the file.
+     * @param mesh Receives the geometry.
+     * @param error If not null, receives a message when loading fails.
+     * @return True on success.
+     */
+    bool load_mesh(const std::string &filename, mesh_data &mesh, std::string *error = nullptr);
+} // namespace cobra
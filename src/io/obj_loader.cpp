@@ -0,0 +1,234 @@
+#include "io/mesh_loader.h"
+#include "io/mapped_file.h"
+#include "core/parallel_chunks.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace cobra
+{
+    namespace
+    {
+        /// Smallest chunk of an OBJ file worth parsing on its own thread.
+        constexpr size_t min_obj_chunk = 1 << 20;
+
+        struct obj_chunk
+        {
+            const char *begin;
+            const char *end;
+            size_t vertices = 0;       ///< Vertices defined in the chunk.
+            size_t triangles = 0;      ///< Triangles defined in the chunk.
+            size_t first_vertex = 0;   ///< Vertices defined before the chunk.
+            size_t first_triangle = 0; ///< Triangles defined before the chunk.
+            const char *error = nullptr; ///< First malformed line, if any.
+        };
+
+        bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+        const char *skip_blanks(const char *p, const char *end)
+        {
+            while (p < end && is_blank(*p))
+                ++p;
+            return p;
+        }
+
+        const char *line_end(const char *p, const char *end)
+        {
+            const void *newline = std::memchr(p, '\n', size_t(end - p));
+            return newline ? static_cast<const char *>(newline) : end;
+        }
+
+        /// @return The statement of a line: 'v' or 'f' for the ones we read, 0 otherwise.
+        char statement(const char *&p, const char *end)
+        {
+            p = skip_blanks(p, end);
+            if (end - p >= 2 && (p[0] == 'v' || p[0] == 'f') && is_blank(p[1]))
+                return *p++;
+            return 0;
+        }
+
+        size_t count_tokens(const char *p, const char *end)
+        {
+            size_t count = 0;
+            while (true)
+            {
+                p = skip_blanks(p, end);
+                if (p >= end || *p == '#')
+                    return count;
+                ++count;
+                while (p < end && !is_blank(*p))
+                    ++p;
+            }
+        }
+
+        bool parse_float(const char *&p, const char *end, float &value)
+        {
+            p = skip_blanks(p, end);
+            if (p < end && *p == '+')
+                ++p;
+            auto result = std::from_chars(p, end, value);
+            if (result.ec != std::errc())
+                return false;
+            p = result.ptr;
+            return true;
+        }
+
+        /// Reads the vertex index of a face corner ("v", "v/vt", "v//vn" or "v/vt/vn").
+        bool parse_corner(const char *&p, const char *end, long &index)
+        {
+            p = skip_blanks(p, end);
+            auto result = std::from_chars(p, end, index);
+            if (result.ec != std::errc() || index == 0)
+                return false;
+            p = result.ptr;
+            while (p < end && !is_blank(*p))
+                ++p;
+            return true;
+        }
+
+        void count_chunk(obj_chunk &chunk)
+        {
+            for (const char *p = chunk.begin; p < chunk.end;)
+            {
+                const char *eol = line_end(p, chunk.end);
+                char kind = statement(p, eol);
+                if (kind == 'v')
+                    ++chunk.vertices;
+                else if (kind == 'f')
+                {
+                    size_t corners = count_tokens(p, eol);
+                    if (corners >= 3)
+                        chunk.triangles += corners - 2;
+                }
+                p = eol + 1;
+            }
+        }
+
+        void parse_chunk(obj_chunk &chunk, mesh_data &mesh)
+        {
+            float *position = mesh.positions.data() + 3 * chunk.first_vertex;
+            uint32_t *index = mesh.indices.data() + 3 * chunk.first_triangle;
+            size_t vertices = chunk.first_vertex;
+
+            for (const char *p = chunk.begin; p < chunk.end;)
+            {
+                const char *line = p;
+                const char *eol = line_end(p, chunk.end);
+                char kind = statement(p, eol);
+                if (kind == 'v')
+                {
+                    if (!parse_float(p, eol, position[0]) || !parse_float(p, eol, position[1]) ||
+                        !parse_float(p, eol, position[2]))
+                    {
+                        chunk.error = line;
+                        return;
+                    }
+                    position += 3;
+                    ++vertices;
+                }
+                else if (kind == 'f')
+                {
+                    size_t corners = count_tokens(p, eol);
+                    if (corners >= 3)
+                    {
+                        // Fan triangulation; negative indices count back from the last vertex.
+                        uint32_t first = 0, previous = 0;
+                        for (size_t c = 0; c < corners; ++c)
+                        {
+                            long i;
+                            if (!parse_corner(p, eol, i))
+                            {
+                                chunk.error = line;
+                                return;
+                            }
+                            uint32_t current = uint32_t(i > 0 ? i - 1 : long(vertices) + i);
+                            if (c == 0)
+                                first = current;
+                            else if (c >= 2)
+                            {
+                                index[0] = first;
+                                index[1] = previous;
+                                index[2] = current;
+                                index += 3;
+                            }
+                            previous = current;
+                        }
+                    }
+                }
+                p = eol + 1;
+            }
+        }
+    } // namespace
+
+    bool load_obj(const std::string &filename, mesh_data &mesh, std::string *error)
+    {
+        mapped_file file(filename);
+        if (!file.is_open())
+        {
+            if (error)
+                *error = "cannot open " + filename;
+            return false;
+        }
+
+        // Split at line boundaries.
+        const char *data = file.data();
+        const char *end = data + file.size();
+        size_t count = chunk_count(file.size(), min_obj_chunk);
+        std::vector<obj_chunk> chunks;
+        const char *begin = data;
+        for (size_t c = 0; c < count && begin < end; ++c)
+        {
+            const char *split = (c + 1 == count) ? end : data + file.size() * (c + 1) / count;
+            if (split < begin)
+                split = begin;
+            split = (split < end) ? line_end(split, end) : end;
+            if (split < end)
+                ++split;
+            chunks.push_back({begin, split});
+            begin = split;
+        }
+
+        parallel_chunks(chunks.size(), [&](size_t c)
+                        { count_chunk(chunks[c]); });
+
+        size_t vertices = 0, triangles = 0;
+        for (obj_chunk &chunk : chunks)
+        {
+            chunk.first_vertex = vertices;
+            chunk.first_triangle = triangles;
+            vertices += chunk.vertices;
+            triangles += chunk.triangles;
+        }
+        if (vertices > UINT32_MAX)
+        {
+            if (error)
+                *error = filename + ": too many vertices";
+            return false;
+        }
+
+        mesh.positions.resize(3 * vertices);
+        mesh.indices.resize(3 * triangles);
+        parallel_chunks(chunks.size(), [&](size_t c)
+                        { parse_chunk(chunks[c], mesh); });
+
+        for (const obj_chunk &chunk : chunks)
+        {
+            if (chunk.error)
+            {
+                if (error)
+                    *error = filename + ": malformed statement at byte " + std::to_string(chunk.error - data);
+                return false;
+            }
+        }
+        for (uint32_t i : mesh.indices)
+        {
+            if (i >= vertices)
+            {
+                if (error)
+                    *error = filename + ": face index out of range";
+                return false;
+            }
+        }
+        return true;
+    }
+} // namespace cobra
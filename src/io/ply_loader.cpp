@@ -0,0 +1,490 @@
+#include "io/mesh_loader.h"
+#include "io/mapped_file.h"
+#include "core/parallel_chunks.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace cobra
+{
+    namespace
+    {
+        /// Smallest number of PLY records worth decoding on their own thread.
+        constexpr size_t min_ply_records = 1 << 16;
+
+        enum class ply_type
+        {
+            int8,
+            uint8,
+            int16,
+            uint16,
+            int32,
+            uint32,
+            float32,
+            float64,
+            invalid
+        };
+
+        ply_type parse_type(const std::string &name)
+        {
+            if (name == "char" || name == "int8")
+                return ply_type::int8;
+            if (name == "uchar" || name == "uint8")
+                return ply_type::uint8;
+            if (name == "short" || name == "int16")
+                return ply_type::int16;
+            if (name == "ushort" || name == "uint16")
+                return ply_type::uint16;
+            if (name == "int" || name == "int32")
+                return ply_type::int32;
+            if (name == "uint" || name == "uint32")
+                return ply_type::uint32;
+            if (name == "float" || name == "float32")
+                return ply_type::float32;
+            if (name == "double" || name == "float64")
+                return ply_type::float64;
+            return ply_type::invalid;
+        }
+
+        size_t type_size(ply_type type)
+        {
+            switch (type)
+            {
+            case ply_type::int8:
+            case ply_type::uint8:
+                return 1;
+            case ply_type::int16:
+            case ply_type::uint16:
+                return 2;
+            case ply_type::int32:
+            case ply_type::uint32:
+            case ply_type::float32:
+                return 4;
+            case ply_type::float64:
+                return 8;
+            default:
+                return 0;
+            }
+        }
+
+        struct ply_property
+        {
+            std::string name;
+            ply_type type = ply_type::invalid;       ///< Value type (element type for lists).
+            ply_type count_type = ply_type::invalid; ///< Length type, for lists only.
+            size_t offset = 0;                       ///< Byte offset in fixed-size records.
+
+            bool is_list() const { return count_type != ply_type::invalid; }
+        };
+
+        struct ply_element
+        {
+            std::string name;
+            size_t count = 0;
+            std::vector<ply_property> properties;
+
+            /// @return True if every record has the same size (no list properties).
+            bool fixed_size() const
+            {
+                for (const ply_property &property : properties)
+                    if (property.is_list())
+                        return false;
+                return true;
+            }
+
+            /// @return Size of a record, for fixed-size elements.
+            size_t record_size() const
+            {
+                size_t size = 0;
+                for (const ply_property &property : properties)
+                    size += type_size(property.type);
+                return size;
+            }
+
+            /// @return Smallest possible size of a record: lists count as their count alone.
+            size_t min_record_size() const
+            {
+                size_t size = 0;
+                for (const ply_property &property : properties)
+                    size += type_size(property.is_list() ? property.count_type : property.type);
+                return size;
+            }
+
+            const ply_property *find(const std::string &property_name) const
+            {
+                for (const ply_property &property : properties)
+                    if (property.name == property_name)
+                        return &property;
+                return nullptr;
+            }
+        };
+
+        /// Decodes binary values of either byte order.
+        struct ply_reader
+        {
+            bool swap; ///< True when the file byte order differs from the host's.
+
+            template <typename T>
+            T load(const char *p) const
+            {
+                char bytes[sizeof(T)];
+                std::memcpy(bytes, p, sizeof(T));
+                if (swap)
+                    for (size_t b = 0; b < sizeof(T) / 2; ++b)
+                        std::swap(bytes[b], bytes[sizeof(T) - 1 - b]);
+                T value;
+                std::memcpy(&value, bytes, sizeof(T));
+                return value;
+            }
+
+            double real(const char *p, ply_type type) const
+            {
+                switch (type)
+                {
+                case ply_type::float32:
+                    return load<float>(p);
+                case ply_type::float64:
+                    return load<double>(p);
+                default:
+                    return double(integer(p, type));
+                }
+            }
+
+            int64_t integer(const char *p, ply_type type) const
+            {
+                switch (type)
+                {
+                case ply_type::int8:
+                    return load<int8_t>(p);
+                case ply_type::uint8:
+                    return load<uint8_t>(p);
+                case ply_type::int16:
+                    return load<int16_t>(p);
+                case ply_type::uint16:
+                    return load<uint16_t>(p);
+                case ply_type::int32:
+                    return load<int32_t>(p);
+                case ply_type::uint32:
+                    return load<uint32_t>(p);
+                case ply_type::float32:
+                    return int64_t(load<float>(p));
+                case ply_type::float64:
+                    return int64_t(load<double>(p));
+                default:
+                    return 0;
+                }
+            }
+        };
+
+        bool host_is_little_endian()
+        {
+            const uint16_t one = 1;
+            unsigned char first;
+            std::memcpy(&first, &one, 1);
+            return first == 1;
+        }
+
+        /**
+         * @brief Parses the text header.
+         * @return Offset of the binary body, or 0 on failure.
+         */
+        size_t parse_header(const char *data, size_t size, bool &little_endian,
+                            std::vector<ply_element> &elements, std::string &message)
+        {
+            const char *marker = "end_header";
+            const char *end = data + size;
+            const char *body = nullptr;
+            for (const char *p = data; p + 10 <= end; ++p)
+            {
+                if (std::memcmp(p, marker, 10) == 0)
+                {
+                    const void *newline = std::memchr(p, '\n', size_t(end - p));
+                    body = newline ? static_cast<const char *>(newline) + 1 : nullptr;
+                    break;
+                }
+            }
+            if (size < 4 || std::memcmp(data, "ply", 3) != 0 || !body)
+            {
+                message = "not a PLY file";
+                return 0;
+            }
+
+            std::istringstream header(std::string(data, body));
+            std::string line;
+            bool has_format = false;
+            while (std::getline(header, line))
+            {
+                std::istringstream words(line);
+                std::string keyword;
+                words >> keyword;
+                if (keyword == "format")
+                {
+                    std::string format;
+                    words >> format;
+                    if (format == "binary_little_endian")
+                        little_endian = true;
+                    else if (format == "binary_big_endian")
+                        little_endian = false;
+                    else
+                    {
+                        message = "unsupported PLY format " + format + " (only binary is read)";
+                        return 0;
+                    }
+                    has_format = true;
+                }
+                else if (keyword == "element")
+                {
+                    ply_element element;
+                    words >> element.name >> element.count;
+                    elements.push_back(element);
+                }
+                else if (keyword == "property")
+                {
+                    if (elements.empty())
+                    {
+                        message = "property outside of an element";
+                        return 0;
+                    }
+                    ply_property property;
+                    std::string type;
+                    words >> type;
+                    if (type == "list")
+                    {
+                        std::string count_type, value_type;
+                        words >> count_type >> value_type;
+                        property.count_type = parse_type(count_type);
+                        property.type = parse_type(value_type);
+                        if (property.count_type == ply_type::invalid)
+                        {
+                            message = "unknown property type " + count_type;
+                            return 0;
+                        }
+                    }
+                    else
+                        property.type = parse_type(type);
+                    words >> property.name;
+                    if (property.type == ply_type::invalid)
+                    {
+                        message = "unknown property type in: " + line;
+                        return 0;
+                    }
+                    ply_element &element = elements.back();
+                    if (!element.properties.empty())
+                    {
+                        const ply_property &last = element.properties.back();
+                        property.offset = last.offset + type_size(last.type);
+                    }
+                    element.properties.push_back(property);
+                }
+            }
+            if (!has_format)
+            {
+                message = "missing format line";
+                return 0;
+            }
+            return size_t(body - data);
+        }
+
+        /**
+         * @brief Walks one variable-size record, calling `list(property, count, first)` on its lists.
+         * @return The end of the record, or null if it overruns the file.
+         */
+        template <typename List>
+        const char *walk_record(const ply_element &element, const ply_reader &reader,
+                                const char *p, const char *end, const List &list)
+        {
+            for (const ply_property &property : element.properties)
+            {
+                if (!property.is_list())
+                {
+                    if (type_size(property.type) > size_t(end - p))
+                        return nullptr;
+                    p += type_size(property.type);
+                    continue;
+                }
+                size_t count_size = type_size(property.count_type);
+                if (count_size > size_t(end - p))
+                    return nullptr;
+                int64_t count = reader.integer(p, property.count_type);
+                p += count_size;
+                size_t index_size = type_size(property.type);
+                if (count < 0 || size_t(count) > size_t(end - p) / index_size)
+                    return nullptr;
+                list(property, size_t(count), p);
+                p += size_t(count) * index_size;
+            }
+            return p;
+        }
+
+        bool read_vertices(const ply_element &element, const ply_reader &reader,
+                           const char *body, const char *end, mesh_data &mesh, std::string &message)
+        {
+            const ply_property *axis[3] = {element.find("x"), element.find("y"), element.find("z")};
+            if (!axis[0] || !axis[1] || !axis[2] || !element.fixed_size())
+            {
+                message = "vertex element needs fixed-size x, y and z properties";
+                return false;
+            }
+            size_t stride = element.record_size();
+            if (element.count > size_t(end - body) / stride)
+            {
+                message = "truncated vertex data";
+                return false;
+            }
+
+            mesh.positions.resize(3 * element.count);
+            size_t chunks = chunk_count(element.count, min_ply_records);
+            parallel_chunks(chunks, [&](size_t c)
+                            {
+                size_t first = element.count * c / chunks;
+                size_t last = element.count * (c + 1) / chunks;
+                float *out = mesh.positions.data() + 3 * first;
+                const char *record = body + stride * first;
+                for (size_t v = first; v < last; ++v, record += stride, out += 3)
+                    for (int a = 0; a < 3; ++a)
+                        out[a] = float(reader.real(record + axis[a]->offset, axis[a]->type)); });
+            return true;
+        }
+
+        /**
+         * @brief Decodes a face element made only of triangles, in parallel.
+         * @return False if some face is not a triangle, so the caller falls back to walking.
+         */
+        bool read_triangles(const ply_element &element, const ply_property &list, const ply_reader &reader,
+                            const char *body, const char *end, mesh_data &mesh)
+        {
+            if (element.properties.size() != 1)
+                return false;
+            size_t count_size = type_size(list.count_type);
+            size_t index_size = type_size(list.type);
+            size_t stride = count_size + 3 * index_size;
+            if (element.count > size_t(end - body) / stride)
+                return false;
+
+            mesh.indices.resize(3 * element.count);
+            size_t chunks = chunk_count(element.count, min_ply_records);
+            std::vector<char> triangles_only(chunks, 1);
+            parallel_chunks(chunks, [&](size_t c)
+                            {
+                size_t first = element.count * c / chunks;
+                size_t last = element.count * (c + 1) / chunks;
+                uint32_t *out = mesh.indices.data() + 3 * first;
+                const char *record = body + stride * first;
+                for (size_t f = first; f < last; ++f, record += stride, out += 3)
+                {
+                    if (reader.integer(record, list.count_type) != 3)
+                    {
+                        triangles_only[c] = 0;
+                        return;
+                    }
+                    for (int k = 0; k < 3; ++k)
+                        out[k] = uint32_t(reader.integer(record + count_size + k * index_size, list.type));
+                } });
+            for (char ok : triangles_only)
+                if (!ok)
+                    return false;
+            return true;
+        }
+
+        /// Fan-triangulates a face element of arbitrary polygons, sequentially.
+        const char *read_polygons(const ply_element &element, const ply_property &list, const ply_reader &reader,
+                                  const char *p, const char *end, mesh_data &mesh)
+        {
+            mesh.indices.clear();
+            // Each record takes at least a byte, so the bytes left bound the triangles worth reserving.
+            mesh.indices.reserve(3 * std::min(element.count, size_t(end - p)));
+            for (size_t f = 0; f < element.count && p; ++f)
+            {
+                p = walk_record(element, reader, p, end, [&](const ply_property &property, size_t count, const char *first)
+                                {
+                    if (&property != &list || count < 3)
+                        return;
+                    size_t index_size = type_size(property.type);
+                    uint32_t a = uint32_t(reader.integer(first, property.type));
+                    for (size_t k = 2; k < count; ++k)
+                    {
+                        mesh.indices.push_back(a);
+                        mesh.indices.push_back(uint32_t(reader.integer(first + (k - 1) * index_size, property.type)));
+                        mesh.indices.push_back(uint32_t(reader.integer(first + k * index_size, property.type)));
+                    } });
+            }
+            return p;
+        }
+    } // namespace
+
+    bool load_ply(const std::string &filename, mesh_data &mesh, std::string *error)
+    {
+        auto fail = [&](const std::string &message)
+        {
+            if (error)
+                *error = filename + ": " + message;
+            return false;
+        };
+
+        mapped_file file(filename);
+        if (!file.is_open())
+        {
+            if (error)
+                *error = "cannot open " + filename;
+            return false;
+        }
+
+        bool little_endian = true;
+        std::vector<ply_element> elements;
+        std::string message;
+        size_t offset = parse_header(file.data(), file.size(), little_endian, elements, message);
+        if (offset == 0)
+            return fail(message);
+
+        ply_reader reader{little_endian != host_is_little_endian()};
+        const char *p = file.data() + offset;
+        const char *end = file.data() + file.size();
+        mesh.positions.clear();
+        mesh.indices.clear();
+
+        for (const ply_element &element : elements)
+        {
+            // Check the count the header announces against the file before sizing anything with it.
+            size_t min_size = element.min_record_size();
+            if (min_size > 0 && element.count > size_t(end - p) / min_size)
+                return fail("truncated " + element.name + " data");
+
+            if (element.name == "vertex")
+            {
+                if (!read_vertices(element, reader, p, end, mesh, message))
+                    return fail(message);
+                p += element.record_size() * element.count;
+            }
+            else if (element.name == "face")
+            {
+                const ply_property *list = element.find("vertex_indices");
+                if (!list)
+                    list = element.find("vertex_index");
+                if (!list || !list->is_list())
+                    return fail("face element without a vertex_indices list");
+
+                if (read_triangles(element, *list, reader, p, end, mesh))
+                    p += (type_size(list->count_type) + 3 * type_size(list->type)) * element.count;
+                else
+                    p = read_polygons(element, *list, reader, p, end, mesh);
+            }
+            else if (element.fixed_size())
+                p += element.record_size() * element.count;
+            else
+            {
+                for (size_t r = 0; r < element.count && p; ++r)
+                    p = walk_record(element, reader, p, end, [](const ply_property &, size_t, const char *) {});
+            }
+
+            if (!p || p > end)
+                return fail("truncated " + element.name + " data");
+        }
+
+        size_t vertices = mesh.vertex_count();
+        for (uint32_t i : mesh.indices)
+            if (i >= vertices)
+                return fail("face index out of range");
+        return true;
+    }
+} // namespace cobra
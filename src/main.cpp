@@ -2,266 +2,628 @@
 #include "camera/camera.h"
 #include "image/image.h"
 #include "scene/scene.h"
-#include "image/ppm_writer.h"
-#include "geometry/sphere.h"
+#include "scene/demo_scenes.h"
+#include "scene/scene_parser.h"
+#include "image/image_writer.h"
+#include "image/accumulation.h"
+#include "image/denoiser.h"
 #include <memory>
+#include <new>
+#include <atomic>
 #include <chrono>
-#include "core/lambertian.h"
-#include "core/metal.h"
-#include "core/dieletric.h"
+#include <csignal>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <string>
+#include <utility>
+#include <vector>
 #include "core/bvh_node.h"
-#include "geometry/quad.h"
-#include "core/light.h"
+#include "core/wide_bvh.h"
+#include "scene/instancing.h"
+#include "scene/light_sampler.h"
+#include "core/instrumentation.h"
+#include "tools/command_line.h"
 
 using namespace cobra;
 
-const image quads()
-{
-    scene world;
-
-    // Materials
-    auto left_red = make_shared<lambertian>(vec3(1.0, 0.2, 0.2));
-    auto back_green = make_shared<lambertian>(vec3(0.2, 1.0, 0.2));
-    auto right_blue = make_shared<lambertian>(vec3(0.2, 0.2, 1.0));
-    auto upper_orange = make_shared<lambertian>(vec3(1.0, 0.5, 0.0));
-    auto lower_teal = make_shared<lambertian>(vec3(0.2, 0.8, 0.8));
+extern char **environ;
 
-    // Quads
-    world.add_hittable(make_shared<quad>(vec3(-3, -2, 5), vec3(0, 0, -4), vec3(0, 4, 0), left_red));
-    world.add_hittable(make_shared<quad>(vec3(-2, -2, 0), vec3(4, 0, 0), vec3(0, 4, 0), back_green));
-    world.add_hittable(make_shared<quad>(vec3(3, -2, 1), vec3(0, 0, 4), vec3(0, 4, 0), right_blue));
-    world.add_hittable(make_shared<quad>(vec3(-2, 3, 1), vec3(4, 0, 0), vec3(0, 0, 4), upper_orange));
-    world.add_hittable(make_shared<quad>(vec3(-2, -3, 5), vec3(4, 0, 0), vec3(0, 0, -4), lower_teal));
+namespace
+{
+    using clock_type = std::chrono::steady_clock;
 
-    camera cam;
+    /// Set by SIGINT and SIGTERM while checkpointing: the render stops and saves its samples.
+    std::atomic<bool> stop_requested{false};
 
-    cam.aspect_ratio = 1.0;
-    cam.width = 400;
-    cam.nb_samples = 1000;
-    cam.depth = 50;
+    void request_stop(int signal)
+    {
+        stop_requested = true;
+        // A second signal ends the program at once.
+        std::signal(signal, SIG_DFL);
+    }
 
-    cam.vfov = 80;
-    cam.lookfrom = vec3(0, 0, 9);
-    cam.lookat = vec3(0, 0, 0);
-    cam.vup = vec3(0, 1, 0);
+    /// Command line settings; negative numbers keep the scene's own value.
+    struct options
+    {
+        std::vector<std::string> scenes; ///< Scene files, or "demo:NAME".
+        std::string output;              ///< Output path, only with a single scene.
+        std::string trace;               ///< Chrome trace output, with the instrumentation compiled in.
+        std::string checkpoint;          ///< Accumulation file, only with a single scene.
+        std::string program;             ///< Path the program was started with, to start workers.
+        std::vector<std::string> forwarded; ///< Render settings given on the command line, passed on to workers.
+        tile region = {0, 0, 0, 0};
+        long sample_offset = -1;
+        long sample_count = -1;
+        long workers = -1;
+        bool split_samples = false;      ///< Workers share the samples of every pixel rather than rows.
+        bool partial = false;            ///< Write the accumulation file only, as a worker.
+        long width = -1;
+        long spp = -1;
+        long depth = -1;
+        long threads = -1;
+        long checkpoint_interval = -1;
+        bool resume = false;
+        bool adaptive = false;
+        bool wavefront = false;
+        bool no_nee = false;
+        bool aovs = false;               ///< Record the first-hit features (implied by the two below).
+        bool denoise = false;            ///< Denoise the image.
+        std::string aov_output;          ///< Prefix of the AOV images, only with a single scene.
+        light_sampling sampling = light_sampling::bvh;
+    };
+
+    void print_usage(const char *program)
+    {
+        std::cout << "Usage: " << program << " [options] [scene files...]\n"
+                  << "\n"
+                  << "Renders each scene file (see scene/scene_parser.h for the format), or the\n"
+                  << "Cornell box demo when none is given.\n"
+                  << "\n"
+                  << "  -w, --width N      image width in pixels\n"
+                  << "  -s, --spp N        samples per pixel\n"
+                  << "  -d, --depth N      maximum bounces\n"
+                  << "  -t, --threads N    render threads (0: all hardware threads)\n"
+                  << "  -o, --output PATH  output image (.ppm or .pfm); default: scene name + .ppm\n"
+                  << "      --demo NAME    render a built-in demo scene\n"
+                  << "      --list-demos   print the demo names\n"
+                  << "      --adaptive     adaptive sampling, spp being the maximum\n"
+                  << "      --wavefront    use the wavefront integrator\n"
+                  << "      --no-nee       no shadow rays: sample lights through the bounce direction only\n"
+                  << "      --light-sampling uniform|power|bvh\n"
+                  << "                     how to choose among several lights (default bvh)\n"
+                  << "      --denoise      filter the noise out, guided by the albedo, normal and depth\n"
+                  << "                     of the first hits\n"
+                  << "      --aov-output PREFIX\n"
+                  << "                     also write the albedo, normal and depth images to PREFIX_albedo,\n"
+                  << "                     PREFIX_normal and PREFIX_depth, with the output's extension\n"
+                  << "      --aovs         record the first-hit features in the samples (--partial,\n"
+                  << "                     --checkpoint), for cobra_merge --denoise\n"
+                  << "      --checkpoint PATH\n"
+                  << "                     save the per-pixel samples to PATH periodically, at the end\n"
+                  << "                     and on SIGINT/SIGTERM\n"
+                  << "      --checkpoint-interval SECONDS\n"
+                  << "                     time between two checkpoints (default 60)\n"
+                  << "      --resume       continue from the samples in the --checkpoint file, if any\n"
+                  << "      --workers N    render in N processes of this program and merge their samples\n"
+                  << "      --split rows|samples\n"
+                  << "                     give each worker a band of rows (default) or a share of the\n"
+                  << "                     samples of every pixel\n"
+                  << "      --region X0,Y0,X1,Y1\n"
+                  << "                     render only the pixels [X0, X1) x [Y0, Y1)\n"
+                  << "      --sample-offset N\n"
+                  << "                     number the samples of every pixel from N\n"
+                  << "      --sample-count N\n"
+                  << "                     take only N of the spp samples of every pixel, from the\n"
+                  << "                     offset (not with --adaptive)\n"
+                  << "      --partial PATH write the samples to PATH (as --checkpoint) and no image,\n"
+                  << "                     to be combined with cobra_merge\n"
+                  << "      --trace PATH   write a Chrome trace and print the counters (needs the\n"
+                  << "                     COBRA_INSTRUMENTATION build option)\n"
+                  << "  -h, --help         print this help\n";
+    }
 
-    cam.defocus_angle = 0;
-    cam.background = vec3(0.70, 0.80, 1.00);
+    double milliseconds_since(clock_type::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(clock_type::now() - start).count();
+    }
 
-    return cam.render_image(world, world);
-}
+    /// @return The file name of a path without directory and extension ("cornell" for "scenes/cornell.cobra").
+    std::string stem(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        size_t dot = name.find_last_of('.');
+        return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+    }
 
-const image fill_with_spheres()
-{
-    camera cam;
+    /**
+     * @brief Writes the image of a render's samples, denoised if asked, and its AOV images.
+     * @return False if a file could not be written.
+     */
+    bool write_images(const accumulation_buffer &accumulation, const std::string &output, const options &opts)
+    {
+        auto start = clock_type::now();
+        image img = opts.denoise ? denoise(accumulation) : accumulation.resolve();
+        if (opts.denoise)
+            std::cout << "Denoise: " << milliseconds_since(start) << " ms" << std::endl;
+        auto img_writer = image_writer::create(output);
+        if (!img_writer || !img_writer->write(img, output))
+        {
+            std::cerr << "Could not write " << output << std::endl;
+            return false;
+        }
+        if (opts.aov_output.empty())
+            return true;
 
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.width = 1200;
-    cam.nb_samples = 500;
-    cam.depth = 50;
+        size_t dot = output.find_last_of('.');
+        const std::string extension = dot == std::string::npos ? ".ppm" : output.substr(dot);
+        const std::pair<aov, const char *> aovs[] = {{aov::albedo, "_albedo"}, {aov::normal, "_normal"}, {aov::depth, "_depth"}};
+        for (const auto &entry : aovs)
+        {
+            const std::string path = opts.aov_output + entry.second + extension;
+            if (!img_writer->write(accumulation.resolve(entry.first), path))
+            {
+                std::cerr << "Could not write " << path << std::endl;
+                return false;
+            }
+        }
+        std::cout << "AOVs: " << opts.aov_output << "_{albedo,normal,depth}" << extension << std::endl;
+        return true;
+    }
 
-    cam.vfov = 20;
-    cam.lookfrom = vec3(13, 2, 3);
-    cam.lookat = vec3(0, 0, 0);
-    cam.vup = vec3(0, 1, 0);
+    /// Reads "X0,Y0,X1,Y1" into a tile, or returns false.
+    bool parse_region(const std::string &text, tile &region)
+    {
+        long values[4];
+        size_t start = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            size_t comma = k < 3 ? text.find(',', start) : text.size();
+            if (comma == std::string::npos || (values[k] = parse_count(text.substr(start, comma - start).c_str())) < 0)
+                return false;
+            start = comma + 1;
+        }
+        region = {uint32_t(values[0]), uint32_t(values[1]), uint32_t(values[2]), uint32_t(values[3])};
+        return region.x0 < region.x1 && region.y0 < region.y1;
+    }
 
-    cam.defocus_angle = 0.6;
-    cam.focus_dist = 10.0;
-    cam.background = vec3(0.70, 0.80, 1.00);
+    /**
+     * @brief Renders a scene in `opts.workers` processes of this program and merges their samples.
+     *
+     * A stand-in for a render farm on one host: each worker renders a band of rows, or a
+     * share of the samples of every pixel, into a partial accumulation file next to the
+     * output, exactly as a worker on another machine would with --region or
+     * --sample-offset and --partial. The partial files are removed once merged, and kept
+     * if a worker fails or is stopped, for --resume.
+     */
+    bool render_split(const std::string &source, const std::string &name, const options &opts, camera &cam)
+    {
+        cam.init();
+        const size_t count = size_t(opts.workers);
+        const std::string output = opts.output.empty() ? name + ".ppm" : opts.output;
+        const size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency() / count);
+
+        auto start = clock_type::now();
+        std::vector<std::string> partials;
+        std::vector<pid_t> pids;
+        for (size_t k = 0; k < count; ++k)
+        {
+            std::vector<std::string> args = {opts.program};
+            args.insert(args.end(), opts.forwarded.begin(), opts.forwarded.end());
+            if (source.rfind("demo:", 0) == 0)
+                args.insert(args.end(), {"--demo", name});
+            else
+                args.push_back(source);
+            if (opts.threads < 0)
+                args.insert(args.end(), {"-t", std::to_string(threads)});
+            if (opts.split_samples)
+            {
+                // Shares of the single stratified batch a one-process render takes.
+                const size_t samples = size_t(cam.strata()) * cam.strata();
+                size_t first = samples * k / count, end = samples * (k + 1) / count;
+                if (first == end)
+                    continue;
+                args.insert(args.end(), {"--sample-offset", std::to_string(first), "--sample-count", std::to_string(end - first)});
+            }
+            else
+            {
+                size_t first = cam.image_height() * k / count, end = cam.image_height() * (k + 1) / count;
+                if (first == end)
+                    continue;
+                args.insert(args.end(), {"--region", "0," + std::to_string(first) + "," + std::to_string(cam.image_width()) + "," + std::to_string(end)});
+            }
+            partials.push_back(output + ".part" + std::to_string(k) + ".acc");
+            args.insert(args.end(), {"--partial", partials.back()});
+            if (opts.checkpoint_interval >= 0)
+                args.insert(args.end(), {"--checkpoint-interval", std::to_string(opts.checkpoint_interval)});
+            if (opts.resume)
+                args.push_back("--resume");
+
+            std::vector<char *> argv;
+            for (auto &arg : args)
+                argv.push_back(&arg[0]);
+            argv.push_back(nullptr);
+            pid_t pid;
+            if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0)
+            {
+                std::cerr << "Could not start " << opts.program << std::endl;
+                break;
+            }
+            pids.push_back(pid);
+        }
 
-    scene world = scene();
+        // Poll rather than block, so that a stop request can be passed on to the workers,
+        // which then save their samples.
+        bool ok = pids.size() == partials.size();
+        bool stop_forwarded = false;
+        std::vector<bool> finished(pids.size(), false);
+        for (size_t running = pids.size(); running > 0;)
+        {
+            for (size_t k = 0; k < pids.size(); ++k)
+            {
+                int status = 0;
+                if (finished[k] || waitpid(pids[k], &status, WNOHANG) <= 0)
+                    continue;
+                finished[k] = true;
+                --running;
+                ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            }
+            if (stop_requested && !stop_forwarded)
+            {
+                for (size_t k = 0; k < pids.size(); ++k)
+                    if (!finished[k])
+                        kill(pids[k], SIGTERM);
+                stop_forwarded = true;
+            }
+            if (running > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        if (!ok)
+        {
+            std::cerr << "A worker failed or was stopped; its partial file is kept, continue with --resume" << std::endl;
+            return false;
+        }
+        std::cout << "Workers: " << pids.size() << " in " << milliseconds_since(start) << " ms" << std::endl;
 
-    auto checker = std::make_shared<checker_texture>(0.32, vec3(.2, .3, .1), vec3(.9, .9, .9));
-    world.add_hittable(std::make_shared<sphere>(vec3(0, -1000, 0), 1000, std::make_shared<lambertian>(checker)));
+        // Merge the partial files and write the image.
+        std::string error;
+        std::vector<std::unique_ptr<accumulation_buffer>> buffers;
+        std::vector<const accumulation_buffer *> parts;
+        for (const auto &partial : partials)
+        {
+            buffers.push_back(read_accumulation(partial, &error));
+            if (!buffers.back())
+            {
+                std::cerr << error << std::endl;
+                return false;
+            }
+            parts.push_back(buffers.back().get());
+        }
+        accumulation_buffer merged;
+        if (!merge_accumulations(parts, merged, &error))
+        {
+            std::cerr << error << std::endl;
+            return false;
+        }
+        if (!write_images(merged, output, opts))
+            return false;
+        for (const auto &partial : partials)
+            std::remove(partial.c_str());
+        std::cout << "Output: " << output << ", " << merged.sample_count() << " samples" << std::endl;
+        return true;
+    }
 
-    for (int a = -11; a < 11; a++)
+    bool render(const std::string &source, const options &opts)
     {
-        for (int b = -11; b < 11; b++)
+        std::cout << "== " << source << std::endl;
+        COBRA_TRACE_SPAN("scene", "main");
+
+        // Parsing.
+        auto start = clock_type::now();
+        demo_scene description;
+        std::string error;
+        bool is_demo = source.rfind("demo:", 0) == 0;
+        std::string name = is_demo ? source.substr(5) : stem(source);
+        if (is_demo ? !make_demo_scene(name, description) : !load_scene_file(source, description, &error))
         {
-            auto choose_mat = random_double();
-            vec3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
-
-            if ((center - vec3(4, 0.2, 0)).length() > 0.9)
+            std::cerr << (is_demo ? "Unknown demo scene " + name : error) << std::endl;
+            return false;
+        }
+        // The bottom-level BVHs a scene file builds as it goes are reported with the top level.
+        std::cout << "Parse: " << description.world.hittable_list.size() << " objects in "
+                  << milliseconds_since(start) - description.build_ms << " ms" << std::endl;
+
+        camera &cam = description.cam;
+        if (opts.width >= 0)
+            cam.width = size_t(opts.width);
+        if (opts.spp >= 0)
+            cam.nb_samples = size_t(opts.spp);
+        if (opts.depth >= 0)
+            cam.depth = size_t(opts.depth);
+        if (opts.threads >= 0)
+            cam.nb_threads = size_t(opts.threads);
+        cam.adaptive_sampling = cam.adaptive_sampling || opts.adaptive;
+        cam.wavefront = cam.wavefront || opts.wavefront;
+        cam.next_event_estimation = cam.next_event_estimation && !opts.no_nee;
+        cam.aovs = opts.aovs;
+        cam.region = opts.region;
+        if (opts.sample_offset >= 0)
+            cam.sample_offset = size_t(opts.sample_offset);
+        if (opts.sample_count > 0)
+            cam.sample_count = size_t(opts.sample_count);
+        if (!cam.image_size_ok())
+        {
+            std::cerr << "The image is larger than " << size_t(camera::max_pixels) << " pixels" << std::endl;
+            return false;
+        }
+        if (cam.adaptive_sampling && (cam.sample_count > 0 || (opts.workers > 0 && opts.split_samples)))
+        {
+            std::cerr << "--sample-count and --split samples do not work with adaptive sampling" << std::endl;
+            return false;
+        }
+        if (opts.workers > 0)
+            return render_split(source, name, opts, cam);
+
+        // Acceleration structure: transformed objects become instances of shared bottom-level BVHs.
+        start = clock_type::now();
+        instance_builder instances;
+        auto bvh = make_shared<bvh_node>(instances.build(description.world));
+        scene world(make_shared<bvh8>(bvh));
+        std::cout << "BVH: " << bvh->node_count() << " nodes, expected cost " << bvh->expected_cost() << ", "
+                  << instances.instance_count() << " instances of " << instances.bottom_level_count()
+                  << " objects, " << instances.grouped_sphere_count() << " spheres grouped, built in "
+                  << description.build_ms + milliseconds_since(start) << " ms" << std::endl;
+
+        // Checkpointing: the samples already taken, if resuming.
+        accumulation_buffer accumulation;
+        if (!opts.checkpoint.empty())
+        {
+            cam.checkpoint_path = opts.checkpoint;
+            if (opts.checkpoint_interval >= 0)
+                cam.checkpoint_interval = double(opts.checkpoint_interval);
+            cam.stop_request = &stop_requested;
+            if (opts.resume && std::ifstream(opts.checkpoint))
             {
-                shared_ptr<material> sphere_material;
-
-                if (choose_mat < 0.8)
+                auto saved = read_accumulation(opts.checkpoint, &error);
+                if (!saved)
                 {
-                    // diffuse
-                    auto albedo = vec3::random() * vec3::random();
-                    sphere_material = std::make_shared<lambertian>(albedo);
-                    world.add_hittable(make_shared<sphere>(center, 0.2, sphere_material));
+                    std::cerr << error << std::endl;
+                    return false;
                 }
-                else if (choose_mat < 0.95)
+                if (!cam.can_resume(*saved))
                 {
-                    // metal
-                    auto albedo = vec3::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = std::make_shared<metal>(albedo, fuzz);
-                    world.add_hittable(make_shared<sphere>(center, 0.2, sphere_material));
-                }
-                else
-                {
-                    // glass
-                    sphere_material = std::make_shared<dielectric>(1.5);
-                    world.add_hittable(make_shared<sphere>(center, 0.2, sphere_material));
+                    std::cerr << opts.checkpoint << " was saved with other render settings (size, seed, samples or AOVs)" << std::endl;
+                    return false;
                 }
+                accumulation = std::move(*saved);
+                std::cout << "Resume: " << accumulation.sample_count() << " samples from " << opts.checkpoint << std::endl;
             }
         }
-    }
-
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add_hittable(make_shared<sphere>(vec3(0, 1, 0), 1.0, material1));
-
-    auto material2 = std::make_shared<lambertian>(vec3(0.4, 0.2, 0.1));
-    world.add_hittable(std::make_shared<sphere>(vec3(-4, 1, 0), 1.0, material2));
-
-    auto material3 = std::make_shared<metal>(vec3(0.7, 0.6, 0.5), 0.0);
-    world.add_hittable(std::make_shared<sphere>(vec3(4, 1, 0), 1.0, material3));
-
-    world = scene(make_shared<bvh_node>(world));
-    return cam.render_image(world, world);
-}
-
-const image checkered_spheres()
-{
-    scene world;
-
-    auto checker = make_shared<checker_texture>(0.32, vec3(.2, .3, .1), vec3(.9, .9, .9));
-
-    world.add_hittable(make_shared<sphere>(vec3(0, -10, 0), 10, make_shared<lambertian>(checker)));
-    world.add_hittable(make_shared<sphere>(vec3(0, 10, 0), 10, make_shared<lambertian>(checker)));
-
-    camera cam;
-
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.width = 400;
-    cam.nb_samples = 100;
-    cam.depth = 50;
-
-    cam.vfov = 20;
-    cam.lookfrom = vec3(13, 2, 3);
-    cam.lookat = vec3(0, 0, 0);
-    cam.vup = vec3(0, 1, 0);
-    cam.background = vec3(0.70, 0.80, 1.00);
-
-    cam.defocus_angle = 0;
-
-    return cam.render_image(world, world);
-}
-
-const image simple_light()
-{
-    scene world;
-
-    shared_ptr<texture> pertext = make_shared<solid_color>(vec3(0.4, 0.4, 0.4));
-    world.add_hittable(make_shared<sphere>(vec3(0, -1000, 0), 1000, make_shared<lambertian>(pertext)));
-    world.add_hittable(make_shared<sphere>(vec3(0, 2, 0), 2, make_shared<lambertian>(pertext)));
-
-    auto difflight = make_shared<diffuse_light>(vec3(4, 4, 4));
-    world.add_hittable(make_shared<sphere>(vec3(0, 7, 0), 2, difflight));
-
-    world.add_hittable(make_shared<quad>(vec3(3, 1, -2), vec3(2, 0, 0), vec3(0, 2, 0), difflight));
 
-    camera cam;
-
-    cam.aspect_ratio = 16.0 / 9.0;
-    cam.width = 400;
-    cam.nb_samples = 100;
-    cam.depth = 50;
-    cam.background = vec3(0, 0, 0);
-
-    cam.vfov = 20;
-    cam.lookfrom = vec3(26, 3, 6);
-    cam.lookat = vec3(0, 2, 0);
-    cam.vup = vec3(0, 1, 0);
-
-    cam.defocus_angle = 0;
-
-    return cam.render_image(world, world);
-}
-
-const image cornell_box()
-{
-    scene world;
-
-    auto red = make_shared<lambertian>(vec3(.65, .05, .05));
-    auto white = make_shared<lambertian>(vec3(.73, .73, .73));
-    auto green = make_shared<lambertian>(vec3(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(vec3(15, 15, 15));
-
-    world.add_hittable(make_shared<quad>(vec3(555, 0, 0), vec3(0, 555, 0), vec3(0, 0, 555), green));
-    world.add_hittable(make_shared<quad>(vec3(0, 0, 0), vec3(0, 555, 0), vec3(0, 0, 555), red));
-    world.add_hittable(make_shared<quad>(vec3(343, 554, 332), vec3(-130, 0, 0), vec3(0, 0, -105), light));
-    world.add_hittable(make_shared<quad>(vec3(0, 0, 0), vec3(555, 0, 0), vec3(0, 0, 555), white));
-    world.add_hittable(make_shared<quad>(vec3(555, 555, 555), vec3(-555, 0, 0), vec3(0, 0, -555), white));
-    world.add_hittable(make_shared<quad>(vec3(0, 0, 555), vec3(555, 0, 0), vec3(0, 555, 0), white));
-
-     // Box
-    shared_ptr<hittable> box1 = make_shared<cube>(vec3(0,0,0), vec3(165,330,165), white);
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, vec3(265,0,295));
-    world.add_hittable(box1);
-
-    // Glass Sphere
-    auto glass = make_shared<dielectric>(1.5);
-    world.add_hittable(make_shared<sphere>(vec3(190,90,190), 90, glass));
-
-    // Light Sources
-    auto empty_material = shared_ptr<material>();
-    quad lights(vec3(343, 554, 332), vec3(-130, 0, 0), vec3(0, 0, -105), empty_material);
-
-    camera cam;
-
-    cam.aspect_ratio = 1.0;
-    cam.width = 600;
-    cam.nb_samples = 1000;
-    cam.depth = 20;
-    cam.background = vec3(0, 0, 0);
-
-    cam.vfov = 40;
-    cam.lookfrom = vec3(278, 278, -800);
-    cam.lookat = vec3(278, 278, 0);
-    cam.vup = vec3(0, 1, 0);
-
-    cam.defocus_angle = 0;
+        start = clock_type::now();
+        shared_ptr<hittable> sampled = make_light_sampler(description.lights, opts.sampling);
+        scene no_lights;
+        const hittable &lights = sampled ? *sampled : static_cast<const hittable &>(no_lights);
+        image img = cam.render_image(world, lights, accumulation);
+        std::cout << "Render: " << img.get_width() << "x" << img.get_height() << ", " << cam.samples_taken
+                  << " samples in " << milliseconds_since(start) << " ms" << std::endl;
+        if (cam.interrupted)
+        {
+            std::cout << "Stopped: samples saved to " << opts.checkpoint << ", continue with --resume" << std::endl;
+            return false;
+        }
+        if (opts.partial)
+        {
+            std::cout << "Partial: samples saved to " << opts.checkpoint << std::endl;
+            return true;
+        }
 
-    return cam.render_image(world, lights);
+        // Output.
+        start = clock_type::now();
+        const std::string output = opts.output.empty() ? name + ".ppm" : opts.output;
+        if (!write_images(accumulation, output, opts))
+            return false;
+        std::cout << "Output: " << output << " in " << milliseconds_since(start) << " ms" << std::endl;
+        return true;
+    }
 }
 
-int main()
+int main(int argc, char **argv)
 {
-    auto start = std::chrono::high_resolution_clock::now();
-
-    std::unique_ptr<image> img;
-
-    switch (5)
+    options opts;
+    opts.program = argv[0];
+    for (int a = 1; a < argc; ++a)
     {
-    case 1:
-        img = std::make_unique<image>(fill_with_spheres());
-        break;
-    case 2:
-        img = std::make_unique<image>(quads());
-        break;
-    case 3:
-        img = std::make_unique<image>(checkered_spheres());
-        break;
-    case 4:
-        img = std::make_unique<image>(simple_light());
-        break;
-    case 5:
-        img = std::make_unique<image>(cornell_box());
-        break;
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        long *count = nullptr;
+        if (arg == "-w" || arg == "--width")
+            count = &opts.width;
+        else if (arg == "-s" || arg == "--spp")
+            count = &opts.spp;
+        else if (arg == "-d" || arg == "--depth")
+            count = &opts.depth;
+        else if (arg == "-t" || arg == "--threads")
+            count = &opts.threads;
+        else if (arg == "--checkpoint-interval")
+            count = &opts.checkpoint_interval;
+
+        else if (arg == "--sample-offset")
+            count = &opts.sample_offset;
+        else if (arg == "--sample-count")
+            count = &opts.sample_count;
+        else if (arg == "--workers")
+            count = &opts.workers;
+
+        if (count)
+        {
+            if (!has_value || (*count = parse_count(argv[++a])) < 0)
+            {
+                std::cerr << arg << " expects a non-negative integer" << std::endl;
+                return 1;
+            }
+            if (*count == 0 && (count == &opts.width || count == &opts.spp))
+            {
+                std::cerr << arg << " expects a positive integer" << std::endl;
+                return 1;
+            }
+            if (count == &opts.width || count == &opts.spp || count == &opts.depth || count == &opts.threads)
+                opts.forwarded.insert(opts.forwarded.end(), {arg, argv[a]});
+        }
+        else if ((arg == "-o" || arg == "--output") && has_value)
+            opts.output = argv[++a];
+        else if (arg == "--trace" && has_value)
+            opts.trace = argv[++a];
+        else if (arg == "--checkpoint" && has_value)
+            opts.checkpoint = argv[++a];
+        else if (arg == "--resume")
+            opts.resume = true;
+        else if (arg == "--partial" && has_value)
+        {
+            opts.checkpoint = argv[++a];
+            opts.partial = true;
+        }
+        else if (arg == "--region" && has_value)
+        {
+            if (!parse_region(argv[++a], opts.region))
+            {
+                std::cerr << "--region expects X0,Y0,X1,Y1 with X0 < X1 and Y0 < Y1" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--split" && has_value)
+        {
+            std::string mode = argv[++a];
+            if (mode != "rows" && mode != "samples")
+            {
+                std::cerr << "Unknown split " << mode << std::endl;
+                return 1;
+            }
+            opts.split_samples = mode == "samples";
+        }
+        else if (arg == "--demo" && has_value)
+            opts.scenes.push_back("demo:" + std::string(argv[++a]));
+        else if (arg == "--list-demos")
+        {
+            for (const auto &name : demo_scene_names())
+                std::cout << name << std::endl;
+            return 0;
+        }
+        else if (arg == "--adaptive")
+        {
+            opts.adaptive = true;
+            opts.forwarded.push_back(arg);
+        }
+        else if (arg == "--wavefront")
+        {
+            opts.wavefront = true;
+            opts.forwarded.push_back(arg);
+        }
+        else if (arg == "--no-nee")
+        {
+            opts.no_nee = true;
+            opts.forwarded.push_back(arg);
+        }
+        else if (arg == "--denoise")
+            opts.denoise = opts.aovs = true;
+        else if (arg == "--aovs")
+            opts.aovs = true;
+        else if (arg == "--aov-output" && has_value)
+        {
+            opts.aov_output = argv[++a];
+            opts.aovs = true;
+        }
+        else if (arg == "--light-sampling" && has_value)
+        {
+            if (!parse_light_sampling(argv[++a], opts.sampling))
+            {
+                std::cerr << "Unknown light sampling " << argv[a] << std::endl;
+                return 1;
+            }
+            opts.forwarded.insert(opts.forwarded.end(), {arg, argv[a]});
+        }
+        else if (arg == "-h" || arg == "--help")
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown or incomplete option " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+        else
+            opts.scenes.push_back(arg);
     }
 
-    ppm_writer img_writer;
-
-    img_writer.write(*img, "../output.ppm");
+    if (!opts.trace.empty() && !instrumentation_enabled())
+    {
+        std::cerr << "--trace needs a build with the COBRA_INSTRUMENTATION option" << std::endl;
+        return 1;
+    }
+    if (opts.scenes.empty())
+        opts.scenes.push_back("demo:cornell_box");
+    if ((!opts.output.empty() || !opts.aov_output.empty()) && opts.scenes.size() > 1)
+    {
+        std::cerr << "--output and --aov-output need a single scene" << std::endl;
+        return 1;
+    }
+    if (opts.aovs)
+        opts.forwarded.push_back("--aovs");
+    if ((!opts.checkpoint.empty() || opts.workers > 0) && opts.scenes.size() > 1)
+    {
+        std::cerr << "--checkpoint, --partial and --workers need a single scene" << std::endl;
+        return 1;
+    }
+    if (opts.resume && opts.checkpoint.empty() && opts.workers <= 0)
+    {
+        std::cerr << "--resume needs --checkpoint or --workers" << std::endl;
+        return 1;
+    }
+    if (opts.workers > 0 && (!opts.checkpoint.empty() || opts.sample_offset >= 0 || opts.sample_count >= 0 || opts.region.x1 > 0))
+    {
+        std::cerr << "--workers chooses the regions, sample offsets and partial files itself" << std::endl;
+        return 1;
+    }
+    // The workers of a split render get the signal too, and save their samples.
+    if (!opts.checkpoint.empty() || opts.workers > 0)
+    {
+        std::signal(SIGINT, request_stop);
+        std::signal(SIGTERM, request_stop);
+    }
 
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    auto start = clock_type::now();
+    int failures = 0;
+    for (const auto &source : opts.scenes)
+    {
+        try
+        {
+            failures += render(source, opts) ? 0 : 1;
+        }
+        catch (const std::bad_alloc &)
+        {
+            std::cerr << source << ": out of memory" << std::endl;
+            ++failures;
+        }
+    }
 
-    std::cout << "Render time: " << duration.count() << " ms" << std::endl;
+    std::cout << "Total time: " << milliseconds_since(start) << " ms" << std::endl;
 
-    return 0;
-}
\ No newline at end of file
+    if (!opts.trace.empty())
+    {
+        std::string error;
+        if (!write_chrome_trace(opts.trace, &error))
+        {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        merged_counters().print(std::cout);
+        std::cout << "Trace: " << opts.trace << std::endl;
+    }
+    return failures == 0 ? 0 : 1;
+}
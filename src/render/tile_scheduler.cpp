@@ -0,0 +1,166 @@
+#include "render/tile_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace cobra
+{
+    namespace
+    {
+        /// Keeps the even bits of a Morton code, compacted into the low half.
+        uint32_t compact_bits(uint32_t v)
+        {
+            v &= 0x55555555;
+            v = (v | (v >> 1)) & 0x33333333;
+            v = (v | (v >> 2)) & 0x0f0f0f0f;
+            v = (v | (v >> 4)) & 0x00ff00ff;
+            v = (v | (v >> 8)) & 0x0000ffff;
+            return v;
+        }
+
+        /**
+         * @brief Queue of tile indices owned by one thread.
+         *
+         * The owner takes from the front, thieves from the back. Tiles are coarse enough
+         * for a plain mutex to stay uncontended.
+         */
+        struct alignas(64) tile_queue
+        {
+            std::mutex lock;
+            std::deque<uint32_t> tiles;
+
+            bool pop_front(uint32_t &index)
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (tiles.empty())
+                    return false;
+                index = tiles.front();
+                tiles.pop_front();
+                return true;
+            }
+
+            bool steal_back(uint32_t &index)
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (tiles.empty())
+                    return false;
+                index = tiles.back();
+                tiles.pop_back();
+                return true;
+            }
+        };
+    } // namespace
+
+    double tile_stats::imbalance() const
+    {
+        if (busy_seconds.empty())
+            return 1;
+        double total = 0;
+        double busiest = 0;
+        for (double t : busy_seconds)
+        {
+            total += t;
+            busiest = std::max(busiest, t);
+        }
+        double mean = total / busy_seconds.size();
+        return mean > 0 ? busiest / mean : 1;
+    }
+
+    void tile_stats::add(const tile_stats &other)
+    {
+        tile_count += other.tile_count;
+        steals += other.steals;
+        wall_seconds += other.wall_seconds;
+        busy_seconds.resize(std::max(busy_seconds.size(), other.busy_seconds.size()), 0);
+        tiles_per_thread.resize(busy_seconds.size(), 0);
+        for (size_t t = 0; t < other.busy_seconds.size(); ++t)
+        {
+            busy_seconds[t] += other.busy_seconds[t];
+            tiles_per_thread[t] += other.tiles_per_thread[t];
+        }
+    }
+
+    tile_scheduler::tile_scheduler(size_t width, size_t height, size_t tile_size, size_t nb_threads)
+        : nb_threads(nb_threads)
+    {
+        tile_size = std::clamp<size_t>(tile_size, 1, 256);
+        if (this->nb_threads == 0)
+            this->nb_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (size_t y = 0; y < height; y += tile_size)
+            for (size_t x = 0; x < width; x += tile_size)
+                tiles.push_back({uint32_t(x), uint32_t(y),
+                                 uint32_t(std::min(x + tile_size, width)),
+                                 uint32_t(std::min(y + tile_size, height))});
+
+        // Decode every Morton code of the smallest power-of-two square holding a tile.
+        size_t side = 1;
+        while (side < tile_size)
+            side *= 2;
+        morton_order.reserve(tile_size * tile_size);
+        for (uint32_t code = 0; code < side * side; ++code)
+        {
+            uint32_t x = compact_bits(code);
+            uint32_t y = compact_bits(code >> 1);
+            if (x < tile_size && y < tile_size)
+                morton_order.push_back({uint16_t(x), uint16_t(y)});
+        }
+    }
+
+    tile_stats tile_scheduler::run(const std::function<void(const tile &, size_t)> &render_tile) const
+    {
+        using clock = std::chrono::steady_clock;
+
+        size_t threads = std::max<size_t>(1, std::min(nb_threads, tiles.size()));
+        tile_stats stats;
+        stats.tile_count = tiles.size();
+        stats.busy_seconds.assign(threads, 0);
+        stats.tiles_per_thread.assign(threads, 0);
+        std::vector<size_t> steals(threads, 0);
+
+        // Hand each thread a contiguous run of rows of tiles.
+        std::vector<tile_queue> queues(threads);
+        for (size_t i = 0; i < tiles.size(); ++i)
+            queues[i * threads / tiles.size()].tiles.push_back(uint32_t(i));
+
+        auto worker = [&](size_t self)
+        {
+            uint32_t index;
+            while (true)
+            {
+                bool found = queues[self].pop_front(index);
+                for (size_t k = 1; !found && k < threads; ++k)
+                    if (queues[(self + k) % threads].steal_back(index))
+                    {
+                        found = true;
+                        ++steals[self];
+                    }
+                // Tiles are never added back, so empty queues everywhere means the end.
+                if (!found)
+                    break;
+
+                auto start = clock::now();
+                render_tile(tiles[index], self);
+                stats.busy_seconds[self] += std::chrono::duration<double>(clock::now() - start).count();
+                ++stats.tiles_per_thread[self];
+            }
+        };
+
+        auto start = clock::now();
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (size_t t = 1; t < threads; ++t)
+            pool.emplace_back(worker, t);
+        worker(0);
+        for (auto &thread : pool)
+            thread.join();
+        stats.wall_seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+        for (size_t s : steals)
+            stats.steals += s;
+        return stats;
+    }
+} // namespace cobra
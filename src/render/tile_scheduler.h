@@ -0,0 +1,106 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief A rectangle of pixels, [x0, x1) x [y0, y1).
+     */
+    struct tile
+    {
+        uint32_t x0; ///< First column.
+        uint32_t y0; ///< First row.
+        uint32_t x1; ///< One past the last column.
+        uint32_t y1; ///< One past the last row.
+    };
+
+    /**
+     * @brief How the work of a run was spread over the threads.
+     */
+    struct tile_stats
+    {
+        size_t tile_count = 0;                ///< Number of tiles rendered.
+        size_t steals = 0;                    ///< Tiles taken from another thread's queue.
+        double wall_seconds = 0;              ///< Duration of the run.
+        std::vector<double> busy_seconds;     ///< Time each thread spent working on tiles.
+        std::vector<size_t> tiles_per_thread; ///< Number of tiles each thread rendered.
+
+        /**
+         * @brief Load imbalance of the run.
+         * @return Busiest thread time over mean thread time; 1 is a perfect balance.
+         */
+        double imbalance() const;
+
+        /// @brief Accumulates the statistics of another run on the same threads.
+        void add(const tile_stats &other);
+    };
+
+    /**
+     * @class tile_scheduler
+     * @brief Splits an image into tiles and renders them on a pool of std::threads.
+     *
+     * Each thread starts with a queue holding a contiguous run of tiles, which it takes from
+     * the front. A thread whose queue is empty steals from the back of the queues of the
+     * others, so expensive regions get shared out without a central queue. Pixels of a tile
+     * are visited in Morton order so that consecutive rays stay close in the image, and in
+     * the BVH. Does not depend on OpenMP.
+     */
+    class tile_scheduler
+    {
+    public:
+        /**
+         * @brief Constructs a scheduler.
+         * @param width Image width in pixels.
+         * @param height Image height in pixels.
+         * @param tile_size Side of a tile in pixels (clamped to 1..256).
+         * @param nb_threads Number of threads, 0 for the hardware concurrency.
+         */
+        tile_scheduler(size_t width, size_t height, size_t tile_size = 16, size_t nb_threads = 0);
+
+        /// @return Number of tiles covering the image.
+        size_t tile_count() const { return tiles.size(); }
+
+        /// @return Number of threads run() uses.
+        size_t thread_count() const { return nb_threads; }
+
+        /**
+         * @brief Renders every tile once.
+         *
+         * Blocks until all tiles are done. The calling thread takes part as thread 0.
+         *
+         * @param render_tile Called as `render_tile(tile, thread_index)`, concurrently from
+         *        several threads, on distinct tiles.
+         * @return Statistics of the run.
+         */
+        tile_stats run(const std::function<void(const tile &, size_t)> &render_tile) const;
+
+        /**
+         * @brief Visits the pixels of a tile in Morton (Z-curve) order.
+         * @param t The tile.
+         * @param visit Called as `visit(x, y)` for every pixel of the tile.
+         */
+        template <typename Visit>
+        void for_each_pixel(const tile &t, Visit &&visit) const
+        {
+            uint32_t w = t.x1 - t.x0;
+            uint32_t h = t.y1 - t.y0;
+            for (const auto &offset : morton_order)
+                if (offset.x < w && offset.y < h)
+                    visit(t.x0 + offset.x, t.y0 + offset.y);
+        }
+
+    private:
+        struct pixel_offset
+        {
+            uint16_t x;
+            uint16_t y;
+        };
+
+        size_t nb_threads;
+        std::vector<tile> tiles;                ///< Tiles in row-major order.
+        std::vector<pixel_offset> morton_order; ///< Offsets of a full tile, in Morton order.
+    };
+} // namespace cobra
@@ -0,0 +1,197 @@
+#include "render/wavefront_integrator.h"
+#include "core/material.h"
+#include "core/instrumentation.h"
+
+#include <algorithm>
+
+namespace cobra
+{
+    wavefront_integrator::wavefront_integrator(const camera &cam, const hittable &world, const hittable &lights, size_t wave_size)
+        : cam(cam), world(world), lights(lights), wave_size(std::max<size_t>(1, wave_size))
+    {
+        size_t batch_size = size_t(cam.strata()) * cam.strata();
+        size_t capacity = std::max(this->wave_size, batch_size);
+        paths.reserve(capacity);
+        hits.resize(capacity);
+        active.reserve(capacity);
+        binned.resize(capacity);
+        shaded.reserve(capacity);
+        sorted.resize(capacity);
+        materials.reserve(max_material_bins);
+    }
+
+    void wavefront_integrator::trace(std::vector<pixel_batch> &batches)
+    {
+        // Waves of whole batches, as many as fit (at least one).
+        size_t first = 0;
+        while (first < batches.size())
+        {
+            size_t end = first, samples = 0;
+            while (end < batches.size() && (end == first || samples + batches[end].samples <= wave_size))
+                samples += batches[end++].samples;
+            trace_wave(batches, first, end);
+            first = end;
+        }
+    }
+
+    void wavefront_integrator::sort_by_material()
+    {
+        // Scenes usually have a handful of materials: count them in a small table and
+        // bucket the paths in one pass, the materials of a kind next to each other so that
+        // the dispatch switch of camera::shade takes the same branch over long runs.
+        // Fall back to a comparison sort for many materials.
+        auto by_kind = [](const auto &a, const auto &b)
+        {
+            if (a.first->kind() != b.first->kind())
+                return a.first->kind() < b.first->kind();
+            return a.first != b.first ? a.first < b.first : a.second < b.second;
+        };
+        materials.clear();
+        size_t last = 0;
+        for (auto &entry : shaded)
+        {
+            if (last < materials.size() && materials[last].first == entry.first)
+            {
+                ++materials[last].second;
+                continue;
+            }
+            last = 0;
+            while (last < materials.size() && materials[last].first != entry.first)
+                ++last;
+            if (last == materials.size())
+            {
+                if (materials.size() == max_material_bins)
+                {
+                    std::sort(shaded.begin(), shaded.end(), by_kind);
+                    return;
+                }
+                materials.emplace_back(entry.first, 0);
+            }
+            ++materials[last].second;
+        }
+
+        std::sort(materials.begin(), materials.end(), by_kind);
+        size_t start = 0;
+        for (auto &bin : materials)
+        {
+            size_t count = bin.second;
+            bin.second = start;
+            start += count;
+        }
+        for (const auto &entry : shaded)
+        {
+            size_t bin = 0;
+            while (materials[bin].first != entry.first)
+                ++bin;
+            sorted[materials[bin].second++] = entry;
+        }
+        std::copy(sorted.begin(), sorted.begin() + shaded.size(), shaded.begin());
+    }
+
+    void wavefront_integrator::trace_wave(std::vector<pixel_batch> &batches, size_t first, size_t end)
+    {
+        rng &generator = thread_rng();
+
+        COBRA_TRACE_SPAN("wave", "wavefront");
+
+        // Generate: one camera ray per sample, keyed as in camera::sample_pixel.
+        paths.clear();
+        {
+            COBRA_TRACE_SPAN("generate", "wavefront");
+            for (size_t b = first; b < end; ++b)
+            {
+                const pixel_batch &batch = batches[b];
+                size_t pixel = size_t(batch.j) * cam.width + batch.i;
+                for (size_t sample = batch.first_sample; sample < batch.first_sample + batch.samples; ++sample)
+                {
+                    wave_path p;
+                    p.key = rng::sample_key(cam.seed, pixel, sample);
+                    generator.reseed(p.key, 0);
+                    p.state.r = cam.generate_sample_ray(batch.i, batch.j, sample);
+                    paths.push_back(p);
+                }
+            }
+        }
+
+        active.resize(paths.size());
+        for (size_t p = 0; p < paths.size(); ++p)
+            active[p] = uint32_t(p);
+
+        while (!active.empty())
+        {
+            // Bin the live rays by direction octant (counting sort, stable).
+            size_t octant_start[9] = {};
+            auto octant = [&](uint32_t p)
+            {
+                const vec3 &d = paths[p].state.r.get_direction();
+                return (d.x() < 0) | ((d.y() < 0) << 1) | ((d.z() < 0) << 2);
+            };
+            for (uint32_t p : active)
+                ++octant_start[octant(p) + 1];
+            for (int o = 0; o < 8; ++o)
+                octant_start[o + 1] += octant_start[o];
+            for (uint32_t p : active)
+                binned[octant_start[octant(p)]++] = p;
+
+            // Intersect: paths that leave the scene pick up the background and end.
+            shaded.clear();
+            {
+                COBRA_TRACE_SPAN("intersect", "wavefront");
+                for (size_t k = 0; k < active.size(); ++k)
+                {
+                    uint32_t p = binned[k];
+                    path_state &path = paths[p].state;
+                    if (path.bounce >= cam.depth)
+                        continue;
+
+                    hit_record &rec = hits[p];
+                    COBRA_COUNT(rays);
+                    if (world.hit(path.r, interval(0.001, infinity), rec))
+                        shaded.emplace_back(rec.mat, p);
+                    else
+                        path.radiance += path.throughput * cam.background;
+                }
+            }
+
+            // Shade, one material after the other.
+            {
+                COBRA_TRACE_SPAN("shade", "wavefront");
+                sort_by_material();
+                active.clear();
+                for (const auto &entry : shaded)
+                {
+                    path_state &path = paths[entry.second].state;
+                    generator.reseed(paths[entry.second].key, path.bounce + 1);
+                    if (cam.shade(path, hits[entry.second], lights))
+                        active.push_back(entry.second);
+                }
+            }
+
+            // Shadow: the any-hit tests of the shadow rays left by shading, ended paths included.
+            {
+                COBRA_TRACE_SPAN("shadow", "wavefront");
+                for (const auto &entry : shaded)
+                    paths[entry.second].state.resolve_shadow(world);
+            }
+        }
+
+        // Gather the samples of each batch in sample order, as sample_pixel does.
+        size_t p = 0;
+        for (size_t b = first; b < end; ++b)
+        {
+            pixel_batch &batch = batches[b];
+            batch.sum = vec3(0, 0, 0);
+            batch.aovs = aov_sample();
+            for (uint32_t s = 0; s < batch.samples; ++s, ++p)
+            {
+                const vec3 &color = paths[p].state.radiance;
+                COBRA_PATH_LENGTH(paths[p].state.bounce);
+                batch.sum += color;
+                if (batch.luminance)
+                    batch.luminance->add(luminance(color));
+                if (cam.aovs)
+                    batch.aovs += paths[p].state.first_hit;
+            }
+        }
+    }
+} // namespace cobra
@@ -0,0 +1,78 @@
+#pragma once
+#include "camera/camera.h"
+#include "core/hit_record.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace cobra
+{
+    class material;
+
+    /**
+     * @class wavefront_integrator
+     * @brief Traces many paths together, one bounce stage at a time.
+     *
+     * Instead of following each path to its end, a wave of paths goes through the
+     * stages of a bounce together:
+     *  - generate: camera rays for every sample of the wave;
+     *  - intersect: the live rays, binned by direction octant so that consecutive
+     *    traversals take similar routes through the BVH;
+     *  - shade: the hits, sorted by material kind and then by material so that each
+     *    material's code runs on a contiguous run of paths; shading continues or ends
+     *    each path, and may leave a shadow ray toward a light (next-event estimation);
+     *  - shadow: the occlusion tests of those shadow rays, with the any-hit query.
+     *
+     * Each path reseeds the thread's generator from its own sample key before using
+     * it, exactly as camera::trace_ray does, so the image is the same as with
+     * trace_ray and only the throughput differs. One integrator serves one thread; its
+     * buffers are kept from one call to the next.
+     */
+    class wavefront_integrator
+    {
+    public:
+        /**
+         * @brief Constructs an integrator.
+         * @param cam The camera, already initialized by render_image.
+         * @param world Scene to trace in.
+         * @param lights Objects sampled towards for importance sampling.
+         * @param wave_size Maximum number of paths in a wave.
+         */
+        wavefront_integrator(const camera &cam, const hittable &world, const hittable &lights, size_t wave_size);
+
+        /**
+         * @brief Traces pixel batches, filling their `sum` (and `luminance`).
+         * @param batches The batches to trace; each has at most one stratification grid of samples.
+         */
+        void trace(std::vector<pixel_batch> &batches);
+
+    private:
+        /// A path of the current wave.
+        struct wave_path
+        {
+            path_state state; ///< Ray, throughput and radiance of the path.
+            uint64_t key;     ///< Random sequence key of the path's camera sample.
+        };
+
+        const camera &cam;
+        const hittable &world;
+        const hittable &lights;
+        size_t wave_size;
+
+        std::vector<wave_path> paths;                               ///< Paths of the wave, batch by batch.
+        std::vector<hit_record> hits;                               ///< Hit of each path at the current bounce.
+        std::vector<uint32_t> active;                               ///< Paths still alive.
+        std::vector<uint32_t> binned;                               ///< Alive paths, by direction octant.
+        std::vector<std::pair<const material *, uint32_t>> shaded;  ///< Paths to shade, by material.
+        std::vector<std::pair<const material *, uint32_t>> sorted;  ///< Scratch space of the material sort.
+        std::vector<std::pair<const material *, size_t>> materials; ///< Materials of the wave and their bin.
+
+        /// Number of distinct materials above which paths are sorted rather than bucketed.
+        static constexpr size_t max_material_bins = 32;
+
+        void sort_by_material();
+
+        void trace_wave(std::vector<pixel_batch> &batches, size_t first, size_t end);
+    };
+} // namespace cobra
@@ -0,0 +1,315 @@
+#include "scene/demo_scenes.h"
+#include "geometry/sphere.h"
+#include "geometry/quad.h"
+#include "core/lambertian.h"
+#include "core/metal.h"
+#include "core/dieletric.h"
+#include "core/light.h"
+
+namespace cobra
+{
+    demo_scene quads()
+    {
+        demo_scene demo;
+        scene &world = demo.world;
+
+        // Materials
+        auto left_red = make_shared<lambertian>(vec3(1.0, 0.2, 0.2));
+        auto back_green = make_shared<lambertian>(vec3(0.2, 1.0, 0.2));
+        auto right_blue = make_shared<lambertian>(vec3(0.2, 0.2, 1.0));
+        auto upper_orange = make_shared<lambertian>(vec3(1.0, 0.5, 0.0));
+        auto lower_teal = make_shared<lambertian>(vec3(0.2, 0.8, 0.8));
+
+        // Quads
+        world.add_hittable(make_shared<quad>(vec3(-3, -2, 5), vec3(0, 0, -4), vec3(0, 4, 0), left_red));
+        world.add_hittable(make_shared<quad>(vec3(-2, -2, 0), vec3(4, 0, 0), vec3(0, 4, 0), back_green));
+        world.add_hittable(make_shared<quad>(vec3(3, -2, 1), vec3(0, 0, 4), vec3(0, 4, 0), right_blue));
+        world.add_hittable(make_shared<quad>(vec3(-2, 3, 1), vec3(4, 0, 0), vec3(0, 0, 4), upper_orange));
+        world.add_hittable(make_shared<quad>(vec3(-2, -3, 5), vec3(4, 0, 0), vec3(0, 0, -4), lower_teal));
+
+        camera &cam = demo.cam;
+
+        cam.aspect_ratio = 1.0;
+        cam.width = 400;
+        cam.nb_samples = 1000;
+        cam.depth = 50;
+
+        cam.vfov = 80;
+        cam.lookfrom = vec3(0, 0, 9);
+        cam.lookat = vec3(0, 0, 0);
+        cam.vup = vec3(0, 1, 0);
+
+        cam.defocus_angle = 0;
+        cam.background = vec3(0.70, 0.80, 1.00);
+
+        return demo;
+    }
+
+    demo_scene fill_with_spheres()
+    {
+        demo_scene demo;
+        camera &cam = demo.cam;
+
+        cam.aspect_ratio = 16.0 / 9.0;
+        cam.width = 1200;
+        cam.nb_samples = 500;
+        cam.depth = 50;
+
+        cam.vfov = 20;
+        cam.lookfrom = vec3(13, 2, 3);
+        cam.lookat = vec3(0, 0, 0);
+        cam.vup = vec3(0, 1, 0);
+
+        cam.defocus_angle = 0.6;
+        cam.focus_dist = 10.0;
+        cam.background = vec3(0.70, 0.80, 1.00);
+
+        scene &world = demo.world;
+
+        auto checker = std::make_shared<checker_texture>(0.32, vec3(.2, .3, .1), vec3(.9, .9, .9));
+        world.add_hittable(std::make_shared<sphere>(vec3(0, -1000, 0), 1000, std::make_shared<lambertian>(checker)));
+
+        for (int a = -11; a < 11; a++)
+        {
+            for (int b = -11; b < 11; b++)
+            {
+                auto choose_mat = random_double();
+                vec3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+                if ((center - vec3(4, 0.2, 0)).length() > 0.9)
+                {
+                    shared_ptr<material> sphere_material;
+
+                    if (choose_mat < 0.8)
+                    {
+                        // diffuse
+                        auto albedo = vec3::random() * vec3::random();
+                        sphere_material = std::make_shared<lambertian>(albedo);
+                        world.add_hittable(make_shared<sphere>(center, 0.2, sphere_material));
+                    }
+                    else if (choose_mat < 0.95)
+                    {
+                        // metal
+                        auto albedo = vec3::random(0.5, 1);
+                        auto fuzz = random_double(0, 0.5);
+                        sphere_material = std::make_shared<metal>(albedo, fuzz);
+                        world.add_hittable(make_shared<sphere>(center, 0.2, sphere_material));
+                    }
+                    else
+                    {
+                        // glass
+                        sphere_material = std::make_shared<dielectric>(1.5);
+                        world.add_hittable(make_shared<sphere>(center, 0.2, sphere_material));
+                    }
+                }
+            }
+        }
+
+        auto material1 = make_shared<dielectric>(1.5);
+        world.add_hittable(make_shared<sphere>(vec3(0, 1, 0), 1.0, material1));
+
+        auto material2 = std::make_shared<lambertian>(vec3(0.4, 0.2, 0.1));
+        world.add_hittable(std::make_shared<sphere>(vec3(-4, 1, 0), 1.0, material2));
+
+        auto material3 = std::make_shared<metal>(vec3(0.7, 0.6, 0.5), 0.0);
+        world.add_hittable(std::make_shared<sphere>(vec3(4, 1, 0), 1.0, material3));
+
+        return demo;
+    }
+
+    demo_scene checkered_spheres()
+    {
+        demo_scene demo;
+        scene &world = demo.world;
+
+        auto checker = make_shared<checker_texture>(0.32, vec3(.2, .3, .1), vec3(.9, .9, .9));
+
+        world.add_hittable(make_shared<sphere>(vec3(0, -10, 0), 10, make_shared<lambertian>(checker)));
+        world.add_hittable(make_shared<sphere>(vec3(0, 10, 0), 10, make_shared<lambertian>(checker)));
+
+        camera &cam = demo.cam;
+
+        cam.aspect_ratio = 16.0 / 9.0;
+        cam.width = 400;
+        cam.nb_samples = 100;
+        cam.depth = 50;
+
+        cam.vfov = 20;
+        cam.lookfrom = vec3(13, 2, 3);
+        cam.lookat = vec3(0, 0, 0);
+        cam.vup = vec3(0, 1, 0);
+        cam.background = vec3(0.70, 0.80, 1.00);
+
+        cam.defocus_angle = 0;
+
+        return demo;
+    }
+
+    demo_scene simple_light()
+    {
+        demo_scene demo;
+        scene &world = demo.world;
+
+        shared_ptr<texture> pertext = make_shared<solid_color>(vec3(0.4, 0.4, 0.4));
+        world.add_hittable(make_shared<sphere>(vec3(0, -1000, 0), 1000, make_shared<lambertian>(pertext)));
+        world.add_hittable(make_shared<sphere>(vec3(0, 2, 0), 2, make_shared<lambertian>(pertext)));
+
+        auto difflight = make_shared<diffuse_light>(vec3(4, 4, 4));
+        auto lights = make_shared<scene>();
+        lights->add_hittable(make_shared<sphere>(vec3(0, 7, 0), 2, difflight));
+        lights->add_hittable(make_shared<quad>(vec3(3, 1, -2), vec3(2, 0, 0), vec3(0, 2, 0), difflight));
+        for (const auto &light : lights->hittable_list)
+            world.add_hittable(light);
+
+        camera &cam = demo.cam;
+
+        cam.aspect_ratio = 16.0 / 9.0;
+        cam.width = 400;
+        cam.nb_samples = 100;
+        cam.depth = 50;
+        cam.background = vec3(0, 0, 0);
+
+        cam.vfov = 20;
+        cam.lookfrom = vec3(26, 3, 6);
+        cam.lookat = vec3(0, 2, 0);
+        cam.vup = vec3(0, 1, 0);
+
+        cam.defocus_angle = 0;
+
+        demo.lights = lights;
+        return demo;
+    }
+
+    demo_scene cornell_box()
+    {
+        demo_scene demo;
+        scene &world = demo.world;
+
+        auto red = make_shared<lambertian>(vec3(.65, .05, .05));
+        auto white = make_shared<lambertian>(vec3(.73, .73, .73));
+        auto green = make_shared<lambertian>(vec3(.12, .45, .15));
+        auto light = make_shared<diffuse_light>(vec3(15, 15, 15));
+
+        world.add_hittable(make_shared<quad>(vec3(555, 0, 0), vec3(0, 555, 0), vec3(0, 0, 555), green));
+        world.add_hittable(make_shared<quad>(vec3(0, 0, 0), vec3(0, 555, 0), vec3(0, 0, 555), red));
+        auto ceiling_light = make_shared<quad>(vec3(343, 554, 332), vec3(-130, 0, 0), vec3(0, 0, -105), light);
+        world.add_hittable(ceiling_light);
+        world.add_hittable(make_shared<quad>(vec3(0, 0, 0), vec3(555, 0, 0), vec3(0, 0, 555), white));
+        world.add_hittable(make_shared<quad>(vec3(555, 555, 555), vec3(-555, 0, 0), vec3(0, 0, -555), white));
+        world.add_hittable(make_shared<quad>(vec3(0, 0, 555), vec3(555, 0, 0), vec3(0, 555, 0), white));
+
+         // Box
+        shared_ptr<hittable> box1 = make_shared<cube>(vec3(0,0,0), vec3(165,330,165), white);
+        box1 = make_shared<rotate_y>(box1, 15);
+        box1 = make_shared<translate>(box1, vec3(265,0,295));
+        world.add_hittable(box1);
+
+        // Glass Sphere
+        auto glass = make_shared<dielectric>(1.5);
+        world.add_hittable(make_shared<sphere>(vec3(190,90,190), 90, glass));
+
+        // Light Sources: the emitter itself, so that shadow rays can read its emission.
+        demo.lights = ceiling_light;
+
+        camera &cam = demo.cam;
+
+        cam.aspect_ratio = 1.0;
+        cam.width = 600;
+        cam.nb_samples = 1000;
+        cam.depth = 20;
+        cam.background = vec3(0, 0, 0);
+
+        cam.vfov = 40;
+        cam.lookfrom = vec3(278, 278, -800);
+        cam.lookat = vec3(278, 278, 0);
+        cam.vup = vec3(0, 1, 0);
+
+        cam.defocus_angle = 0;
+
+        return demo;
+    }
+
+    demo_scene cube_field()
+    {
+        demo_scene demo;
+        scene &world = demo.world;
+
+        auto ground = make_shared<lambertian>(vec3(0.48, 0.83, 0.53));
+        auto white = make_shared<lambertian>(vec3(.73, .73, .73));
+        auto light = make_shared<diffuse_light>(vec3(7, 7, 7));
+
+        world.add_hittable(make_shared<quad>(vec3(-1000, 0, -1000), vec3(2000, 0, 0), vec3(0, 0, 2000), ground));
+        auto sky_light = make_shared<quad>(vec3(-150, 400, -150), vec3(300, 0, 0), vec3(0, 0, 300), light);
+        world.add_hittable(sky_light);
+
+        // Every copy shares this cube; the transforms are folded into instances at build time.
+        shared_ptr<hittable> box = make_shared<cube>(vec3(-5, 0, -5), vec3(5, 40, 5), white);
+        for (int i = 0; i < 50; i++)
+        {
+            for (int j = 0; j < 50; j++)
+            {
+                shared_ptr<hittable> copy = make_shared<rotate_y>(box, random_double(0, 90));
+                copy = make_shared<translate>(copy, vec3(-500 + 20 * i, random_double(-38, -5), -500 + 20 * j));
+                world.add_hittable(copy);
+            }
+        }
+
+        demo.lights = sky_light;
+
+        camera &cam = demo.cam;
+
+        cam.aspect_ratio = 16.0 / 9.0;
+        cam.width = 800;
+        cam.nb_samples = 200;
+        cam.depth = 20;
+        cam.background = vec3(0.05, 0.05, 0.08);
+
+        cam.vfov = 40;
+        cam.lookfrom = vec3(0, 300, -700);
+        cam.lookat = vec3(0, 0, 0);
+        cam.vup = vec3(0, 1, 0);
+
+        cam.defocus_angle = 0;
+
+        return demo;
+    }
+
+    namespace
+    {
+        struct demo_entry
+        {
+            const char *name;
+            demo_scene (*make)();
+        };
+
+        const demo_entry demos[] = {
+            {"quads", quads},
+            {"fill_with_spheres", fill_with_spheres},
+            {"checkered_spheres", checkered_spheres},
+            {"simple_light", simple_light},
+            {"cornell_box", cornell_box},
+            {"cube_field", cube_field},
+        };
+    }
+
+    std::vector<std::string> demo_scene_names()
+    {
+        std::vector<std::string> names;
+        for (const auto &entry : demos)
+            names.push_back(entry.name);
+        return names;
+    }
+
+    bool make_demo_scene(const std::string &name, demo_scene &demo)
+    {
+        for (const auto &entry : demos)
+        {
+            if (name == entry.name)
+            {
+                demo = entry.make();
+                return true;
+            }
+        }
+        return false;
+    }
+}
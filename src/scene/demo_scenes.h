@@ -0,0 +1,50 @@
+#pragma once
+#include "camera/camera.h"
+#include "scene/scene.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief A ready-to-render demo scene: its objects, what to sample as lights and a camera.
+     */
+    struct demo_scene
+    {
+        scene world;                 ///< Objects of the scene.
+        shared_ptr<hittable> lights; ///< Emitters sampled toward; nullptr if the scene has none.
+        camera cam;                  ///< Camera set up for the scene.
+        double build_ms = 0;         ///< Time spent building bottom-level BVHs while loading the scene.
+    };
+
+    /// @brief Five colored quads facing the camera.
+    demo_scene quads();
+
+    /// @brief The "Ray Tracing in One Weekend" cover: a checkered ground and ~480 small spheres.
+    demo_scene fill_with_spheres();
+
+    /// @brief Two checkered spheres touching each other.
+    demo_scene checkered_spheres();
+
+    /// @brief A sphere lit by an emissive sphere and an emissive quad.
+    demo_scene simple_light();
+
+    /// @brief The Cornell box with a rotated box and a glass sphere.
+    demo_scene cornell_box();
+
+    /// @brief A field of 2500 rotated copies of a single cube, lit by an area light.
+    demo_scene cube_field();
+
+    /// @return The names of the demo scenes, as accepted by make_demo_scene.
+    std::vector<std::string> demo_scene_names();
+
+    /**
+     * @brief Builds a demo scene by name.
+     * @param name Name of the function building it, e.g. "cornell_box".
+     * @param demo Receives the scene.
+     * @return False if there is no demo of that name.
+     */
+    bool make_demo_scene(const std::string &name, demo_scene &demo);
+}
@@ -0,0 +1,102 @@
+#include "scene/instancing.h"
+#include "core/bvh_node.h"
+#include "core/wide_bvh.h"
+#include "geometry/sphere.h"
+#include "geometry/sphere_set.h"
+
+#include <typeinfo>
+
+namespace cobra
+{
+    scene instance_builder::build(const scene &world)
+    {
+        scene folded;
+        for (const auto &object : group_spheres(world.hittable_list))
+            folded.add_hittable(fold(object));
+        return folded;
+    }
+
+    shared_ptr<hittable> instance_builder::fold(const shared_ptr<hittable> &object)
+    {
+        // Walk down the chain, outermost transform first.
+        affine_transform to_world;
+        shared_ptr<hittable> base = object;
+        bool transformed = false;
+        while (true)
+        {
+            if (auto t = std::dynamic_pointer_cast<translate>(base))
+            {
+                to_world = to_world * t->transform();
+                base = t->wrapped();
+            }
+            else if (auto t = std::dynamic_pointer_cast<rotate_y>(base))
+            {
+                to_world = to_world * t->transform();
+                base = t->wrapped();
+            }
+            else if (auto t = std::dynamic_pointer_cast<instance>(base))
+            {
+                to_world = to_world * t->transform();
+                base = t->wrapped();
+            }
+            else
+                break;
+            transformed = true;
+        }
+
+        if (!transformed)
+            return object;
+        ++instances;
+        return make_shared<instance>(bottom_level(base), to_world);
+    }
+
+    shared_ptr<hittable> instance_builder::bottom_level(const shared_ptr<hittable> &object)
+    {
+        auto found = bottom_levels.find(object.get());
+        if (found != bottom_levels.end())
+            return found->second.second;
+
+        shared_ptr<hittable> blas = object;
+        auto list = std::dynamic_pointer_cast<scene>(object);
+        if (list && list->hittable_list.size() > 1)
+        {
+            scene grouped;
+            for (const auto &part : group_spheres(list->hittable_list))
+                grouped.add_hittable(part);
+            blas = grouped.hittable_list.size() > 1 ? make_shared<bvh8>(make_shared<bvh_node>(grouped))
+                                                    : grouped.hittable_list[0];
+        }
+
+        bottom_levels.emplace(object.get(), std::make_pair(object, blas));
+        return blas;
+    }
+
+    std::vector<shared_ptr<hittable>> instance_builder::group_spheres(const std::vector<shared_ptr<hittable>> &list)
+    {
+        // Only exact spheres: a subclass may override hit().
+        std::vector<const sphere *> spheres;
+        for (const auto &object : list)
+            if (object && typeid(*object) == typeid(sphere))
+                spheres.push_back(static_cast<const sphere *>(object.get()));
+        if (spheres.size() < min_sphere_group)
+            return list;
+
+        std::vector<shared_ptr<hittable>> others;
+        for (const auto &object : list)
+            if (!object || typeid(*object) != typeid(sphere))
+                others.push_back(object);
+
+        std::vector<vec3> centers;
+        std::vector<double> radii;
+        std::vector<uint32_t> material_ids;
+        for (const sphere *s : spheres)
+        {
+            centers.push_back(s->center());
+            radii.push_back(s->radius());
+            material_ids.push_back(sphere_materials->add(s->mat()));
+        }
+        grouped_spheres += spheres.size();
+        others.push_back(make_shared<sphere_set>(centers, radii, material_ids, sphere_materials));
+        return others;
+    }
+} // namespace cobra
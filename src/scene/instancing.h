@@ -0,0 +1,80 @@
+#pragma once
+#include "core/material_table.h"
+#include "geometry/instance.h"
+#include "scene/scene.h"
+
+#include <unordered_map>
+
+namespace cobra
+{
+    /**
+     * @class instance_builder
+     * @brief Turns a scene into the top level of a two-level acceleration structure.
+     *
+     * Every chain of translate, rotate_y and instance wrappers is folded into a single
+     * instance with one matrix. The object at the bottom of a chain gets one bottom-level
+     * BVH, built the first time it is met and shared by all its instances. A BVH built
+     * over the result (bvh_node, then bvh8) is the top level.
+     *
+     * Plain spheres of a list (the top level or a bottom-level list) are also moved into
+     * a single sphere_set when there are many of them: its packed arrays and SIMD leaves
+     * then stay in cache where thousands of scattered sphere objects do not. The materials
+     * of the grouped spheres go to a material_table shared by all the sets of the builder.
+     */
+    class instance_builder
+    {
+    public:
+        /**
+         * @brief Folds the transforms of every object of a scene.
+         * @param world The scene; its objects are not modified.
+         * @return A scene holding the instances and the untransformed objects.
+         */
+        scene build(const scene &world);
+
+        /**
+         * @brief Folds the wrappers above an object.
+         * @param object Any hittable.
+         * @return An instance of the shared bottom level, or `object` itself if it is not transformed.
+         */
+        shared_ptr<hittable> fold(const shared_ptr<hittable> &object);
+
+        /**
+         * @brief Returns the shared bottom-level structure of an object.
+         *
+         * Lists of objects (such as a cube) get a BVH; other objects, including meshes
+         * which have their own, are used as they are.
+         */
+        shared_ptr<hittable> bottom_level(const shared_ptr<hittable> &object);
+
+        /// @return Number of distinct bottom-level structures.
+        size_t bottom_level_count() const { return bottom_levels.size(); }
+
+        /// @return Number of instances created.
+        size_t instance_count() const { return instances; }
+
+        /// @return Number of spheres moved into sphere sets.
+        size_t grouped_sphere_count() const { return grouped_spheres; }
+
+        /// @return The materials of the grouped spheres.
+        const material_table &materials() const { return *sphere_materials; }
+
+        /// Smallest number of plain spheres of a list worth a sphere_set. Below a few thousand
+        /// spheres, a BVH8 over sphere objects, whose nodes test eight sphere boxes at once, is
+        /// as fast (random sphere clouds break even around 10k spheres, 200k run 1.4x faster).
+        static constexpr size_t min_sphere_group = 8192;
+
+    private:
+        /**
+         * @brief Moves the untransformed sphere objects of a list into one sphere_set.
+         * @param list The objects.
+         * @return The other objects followed by the set, or `list` if it has too few spheres.
+         */
+        std::vector<shared_ptr<hittable>> group_spheres(const std::vector<shared_ptr<hittable>> &list);
+
+        /// Source object (kept alive so that its address stays unique) and its bottom level.
+        std::unordered_map<const hittable *, std::pair<shared_ptr<hittable>, shared_ptr<hittable>>> bottom_levels;
+        size_t instances = 0;
+        size_t grouped_spheres = 0;
+        shared_ptr<material_table> sphere_materials = make_shared<material_table>();
+    };
+} // namespace cobra
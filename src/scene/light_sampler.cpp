@@ -0,0 +1,217 @@
+#include "scene/light_sampler.h"
+#include "core/bvh_builder.h"
+#include "core/random.h"
+#include "scene/scene.h"
+
+#include <algorithm>
+
+namespace cobra
+{
+    namespace
+    {
+        /// Deep enough for the light BVH: the builder stops using the SAH at depth 32 and then halves ranges.
+        constexpr int stack_size = 96;
+
+        /// Interval of the rays cast by pdf_value(), the one the lights test their hits with.
+        const interval light_ray_t(0.001, infinity);
+    }
+
+    bool parse_light_sampling(const std::string &name, light_sampling &strategy)
+    {
+        if (name == "uniform")
+            strategy = light_sampling::uniform;
+        else if (name == "power")
+            strategy = light_sampling::power;
+        else if (name == "bvh")
+            strategy = light_sampling::bvh;
+        else
+            return false;
+        return true;
+    }
+
+    light_sampler::light_sampler(const std::vector<shared_ptr<hittable>> &candidates, light_sampling strategy)
+        : strategy(strategy)
+    {
+        std::vector<double> powers;
+        std::vector<aabb> bounds;
+        for (const auto &light : candidates)
+        {
+            double power = light->emitted_power();
+            if (!(power > 0))
+                continue;
+            lights.push_back(light);
+            powers.push_back(power);
+            bounds.push_back(light->bounding_box());
+        }
+
+        bvh_build_options options;
+        options.max_leaf_size = 1;
+        bvh_builder builder(options);
+        if (!builder.build(bounds))
+            return;
+
+        // Children are always created after their parent, so a backward pass sums the powers.
+        const auto &build_nodes = builder.nodes();
+        nodes.resize(build_nodes.size());
+        for (size_t i = build_nodes.size(); i-- > 0;)
+        {
+            const bvh_build_node &b = build_nodes[i];
+            node &n = nodes[i];
+            n.bbox = b.bbox;
+            n.leaf = b.is_leaf();
+            if (n.leaf)
+            {
+                n.light = builder.primitive_order()[b.first_primitive];
+                n.power = powers[n.light];
+            }
+            else
+            {
+                n.children[0] = b.children[0];
+                n.children[1] = b.children[1];
+                n.power = nodes[b.children[0]].power + nodes[b.children[1]].power;
+            }
+        }
+
+        if (strategy == light_sampling::power)
+            table = alias_table(powers);
+    }
+
+    double light_sampler::left_probability(const node &n, const vec3 &origin) const
+    {
+        const node &left = nodes[n.children[0]];
+        const node &right = nodes[n.children[1]];
+        if (strategy == light_sampling::power)
+            return left.power / n.power;
+
+        // Power over the squared distance to the node, which is at least half its diagonal
+        // so that the lights around the point are not all given the same huge weight.
+        auto weight = [&](const node &child)
+        {
+            vec3 extent(child.bbox.x.size(), child.bbox.y.size(), child.bbox.z.size());
+            double distance2 = std::max((child.bbox.centroid() - origin).length_squared(), extent.length_squared() / 4);
+            return child.power / distance2;
+        };
+        double w_left = weight(left), w_right = weight(right);
+        return w_left / (w_left + w_right);
+    }
+
+    bool light_sampler::hit(const ray &r, interval ray_t, hit_record &rec) const
+    {
+        if (nodes.empty())
+            return false;
+
+        bool hit_anything = false;
+        uint32_t stack[stack_size];
+        int stack_top = 0;
+        stack[stack_top++] = 0;
+        while (stack_top > 0)
+        {
+            const node &n = nodes[stack[--stack_top]];
+            if (!n.bbox.hit(r, ray_t))
+                continue;
+            if (n.leaf)
+            {
+                if (lights[n.light]->hit(r, ray_t, rec))
+                {
+                    hit_anything = true;
+                    ray_t.max = rec.t;
+                }
+            }
+            else
+            {
+                stack[stack_top++] = n.children[0];
+                stack[stack_top++] = n.children[1];
+            }
+        }
+        return hit_anything;
+    }
+
+    double light_sampler::pdf_value(const vec3 &origin, const vec3 &direction) const
+    {
+        if (nodes.empty())
+            return 0;
+
+        // Every light the direction may reach contributes, not only the closest one: the
+        // ray is never shortened. The probability of reaching a node is carried down.
+        ray r(origin, direction);
+        struct entry
+        {
+            uint32_t index;
+            double probability;
+        };
+        entry stack[stack_size];
+        int stack_top = 0;
+        stack[stack_top++] = {0, 1.0};
+        double sum = 0;
+        while (stack_top > 0)
+        {
+            entry e = stack[--stack_top];
+            const node &n = nodes[e.index];
+            if (!n.bbox.hit(r, light_ray_t))
+                continue;
+            if (n.leaf)
+            {
+                double probability = strategy == light_sampling::power ? table.pmf(n.light) : e.probability;
+                sum += probability * lights[n.light]->pdf_value(origin, direction);
+            }
+            else
+            {
+                double left = left_probability(n, origin);
+                if (left > 0)
+                    stack[stack_top++] = {n.children[0], e.probability * left};
+                if (left < 1)
+                    stack[stack_top++] = {n.children[1], e.probability * (1 - left)};
+            }
+        }
+        return sum;
+    }
+
+    vec3 light_sampler::random(const vec3 &origin) const
+    {
+        if (nodes.empty())
+            return vec3(1, 0, 0);
+
+        double u = thread_rng().next_double();
+        if (strategy == light_sampling::power)
+            return lights[table.sample(u)]->random(origin);
+
+        // One number is enough for the whole walk: it is rescaled into the chosen part.
+        uint32_t index = 0;
+        while (!nodes[index].leaf)
+        {
+            const node &n = nodes[index];
+            double left = left_probability(n, origin);
+            if (u < left)
+            {
+                u /= left;
+                index = n.children[0];
+            }
+            else
+            {
+                u = std::min((u - left) / (1 - left), 1.0);
+                index = n.children[1];
+            }
+        }
+        return lights[nodes[index].light]->random(origin);
+    }
+
+    shared_ptr<hittable> make_light_sampler(const shared_ptr<hittable> &lights, light_sampling strategy)
+    {
+        if (!lights || !(lights->emitted_power() > 0))
+            return nullptr;
+        auto list = std::dynamic_pointer_cast<scene>(lights);
+        if (!list || list->hittable_list.size() < 2)
+            return lights;
+        if (strategy != light_sampling::uniform)
+            return make_shared<light_sampler>(list->hittable_list, strategy);
+
+        // Uniform choice, among the lights that emit only.
+        auto emitting = make_shared<scene>();
+        for (const auto &light : list->hittable_list)
+            if (light->emitted_power() > 0)
+                emitting->add_hittable(light);
+        if (emitting->hittable_list.size() == 1)
+            return emitting->hittable_list[0];
+        return emitting;
+    }
+} // namespace cobra
@@ -0,0 +1,97 @@
+#pragma once
+#include "core/alias_table.h"
+#include "geometry/hittable.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cobra
+{
+    /**
+     * @brief How a light is chosen among many for importance sampling.
+     */
+    enum class light_sampling
+    {
+        uniform, ///< Every object of the light list equally (scene::random), the list left as is.
+        power,   ///< In proportion to the emitted power, with an alias table.
+        bvh,     ///< By descending a light BVH, weighting nodes by power over squared distance.
+    };
+
+    /**
+     * @brief Reads a strategy name ("uniform", "power" or "bvh").
+     * @return False if the name is unknown.
+     */
+    bool parse_light_sampling(const std::string &name, light_sampling &strategy);
+
+    /**
+     * @class light_sampler
+     * @brief Samples directions toward one of many lights, chosen by their power.
+     *
+     * The lights that emit nothing (emitted_power() == 0) are left out. The others are the
+     * leaves of a BVH whose nodes store their total power. With light_sampling::bvh, random()
+     * walks down the tree choosing each child in proportion to its importance from the
+     * shaded point (power over squared distance to the node), so that near and bright
+     * lights get most of the samples; with light_sampling::power it picks a light from an
+     * alias table. pdf_value() only visits the nodes whose bounds the direction crosses,
+     * and multiplies the child probabilities along the way, which costs O(log N) per light
+     * in the direction instead of a loop over every light.
+     */
+    class light_sampler : public hittable
+    {
+    public:
+        /**
+         * @brief Builds the sampler.
+         * @param lights The candidate lights; at least one must emit.
+         * @param strategy light_sampling::power or light_sampling::bvh.
+         */
+        light_sampler(const std::vector<shared_ptr<hittable>> &lights, light_sampling strategy = light_sampling::bvh);
+
+        bool hit(const ray &r, interval ray_t, hit_record &rec) const override;
+
+        aabb bounding_box() const override { return nodes.empty() ? aabb() : nodes[0].bbox; }
+
+        double pdf_value(const vec3 &origin, const vec3 &direction) const override;
+
+        vec3 random(const vec3 &origin) const override;
+
+        double emitted_power() const override { return nodes.empty() ? 0.0 : nodes[0].power; }
+
+        /// @return Number of sampled lights.
+        size_t size() const { return lights.size(); }
+
+    private:
+        /// A node of the light BVH; leaves hold exactly one light.
+        struct node
+        {
+            aabb bbox;
+            double power = 0;      ///< Sum of the power of the lights below.
+            uint32_t children[2];  ///< Child node indices (interior nodes only).
+            uint32_t light = 0;    ///< Index in `lights` (leaves only).
+            bool leaf = false;
+        };
+
+        std::vector<shared_ptr<hittable>> lights; ///< The emitting lights.
+        std::vector<node> nodes;                  ///< Root first.
+        alias_table table;                        ///< Power-proportional choice, for light_sampling::power.
+        light_sampling strategy;
+
+        /// @return The probability of taking the left child of an interior node from a point.
+        double left_probability(const node &n, const vec3 &origin) const;
+    };
+
+    /**
+     * @brief Puts a light_sampler over a light list when it helps.
+     *
+     * A scene of several objects is replaced by a light_sampler, or with
+     * light_sampling::uniform by the list of the ones that emit; a single light is returned
+     * as is. Lights that emit nothing are not worth a shadow ray: without any that emits,
+     * there is nothing to sample.
+     *
+     * @param lights The light list of a scene, or nullptr.
+     * @param strategy How to choose among the lights.
+     * @return The object to sample toward, or nullptr if nothing emits.
+     */
+    shared_ptr<hittable> make_light_sampler(const shared_ptr<hittable> &lights, light_sampling strategy);
+} // namespace cobra
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include "core/aabb.h"
+#include "core/instrumentation.h"
 
 namespace cobra
 {
@@ -47,6 +48,7 @@ namespace cobra
          */
         bool hit(const ray &r, interval ray_t, hit_record &rec) const override
         {
+            COBRA_COUNT(scene_tests);
             hit_record temp_rec;
             bool hit_anything = false;
             auto closest_so_far = ray_t.max;
@@ -64,6 +66,15 @@ namespace cobra
             return hit_anything;
         }
 
+        bool occluded(const ray &r, interval ray_t) const override
+        {
+            COBRA_COUNT(scene_tests);
+            for (const auto &object : hittable_list)
+                if (object->occluded(r, ray_t))
+                    return true;
+            return false;
+        }
+
         /**
          * @brief Returns the list of hittable objects in the scene.
          * @return A constant vector of pointers to hittable objects.
@@ -91,6 +102,14 @@ namespace cobra
             return sum;
         }
 
+        double emitted_power() const override
+        {
+            double power = 0;
+            for (const auto &object : hittable_list)
+                power += object->emitted_power();
+            return power;
+        }
+
         vec3 random(const vec3 &origin) const override
         {
             auto int_size = int(hittable_list.size());
@@ -0,0 +1,486 @@
+#include "scene/scene_parser.h"
+#include "scene/instancing.h"
+#include "geometry/sphere.h"
+#include "geometry/quad.h"
+#include "geometry/triangle_mesh.h"
+#include "core/lambertian.h"
+#include "core/metal.h"
+#include "core/dieletric.h"
+#include "core/light.h"
+#include "io/mesh_loader.h"
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace cobra
+{
+    namespace
+    {
+        /// Error in the statement being parsed; turned into "name:line: message".
+        struct parse_error : std::runtime_error
+        {
+            using std::runtime_error::runtime_error;
+        };
+
+        /// The words of one statement, read front to back.
+        class statement
+        {
+        public:
+            explicit statement(const std::string &line)
+            {
+                std::istringstream words(line.substr(0, line.find('#')));
+                std::string word;
+                while (words >> word)
+                    tokens.push_back(word);
+            }
+
+            bool empty() const { return tokens.empty(); }
+            bool done() const { return position == tokens.size(); }
+
+            /// @return The next word without consuming it, or "" at the end.
+            std::string peek() const { return done() ? std::string() : tokens[position]; }
+
+            std::string word(const char *what)
+            {
+                if (done())
+                    throw parse_error(std::string("missing ") + what);
+                return tokens[position++];
+            }
+
+            double number(const char *what)
+            {
+                std::string w = word(what);
+                try
+                {
+                    size_t used;
+                    double value = std::stod(w, &used);
+                    if (used == w.size())
+                        return value;
+                }
+                catch (const std::exception &)
+                {
+                }
+                throw parse_error(std::string("expected a number for ") + what + ", got '" + w + "'");
+            }
+
+            size_t count(const char *what)
+            {
+                double value = number(what);
+                if (value < 0 || value != std::floor(value))
+                    throw parse_error(std::string(what) + " must be a non-negative integer");
+                return size_t(value);
+            }
+
+            vec3 vector(const char *what)
+            {
+                double x = number(what);
+                double y = number(what);
+                double z = number(what);
+                return vec3(x, y, z);
+            }
+
+            void finish()
+            {
+                if (!done())
+                    throw parse_error("unexpected '" + tokens[position] + "'");
+            }
+
+        private:
+            std::vector<std::string> tokens;
+            size_t position = 0;
+        };
+
+        class scene_reader
+        {
+        public:
+            scene_reader(const std::string &directory, demo_scene &description)
+                : directory(directory), description(description), target(&description.world)
+            {
+            }
+
+            void read(statement &s)
+            {
+                std::string keyword = s.word("keyword");
+                if (keyword == "camera")
+                    read_camera(s);
+                else if (keyword == "render")
+                    read_render(s);
+                else if (keyword == "texture")
+                    read_texture(s);
+                else if (keyword == "material")
+                    read_material(s);
+                else if (keyword == "light")
+                {
+                    // Only these shapes can be sampled toward (hittable::random and pdf_value).
+                    std::string shape = s.word("shape");
+                    if (shape != "sphere" && shape != "quad")
+                        throw parse_error("a light must be a sphere or a quad, not '" + shape + "'");
+                    add(read_shape(shape, s), true);
+                }
+                else if (keyword == "begin")
+                    transforms.push_back(current);
+                else if (keyword == "end")
+                {
+                    if (transforms.empty() || (object && transforms.size() == object_depth))
+                        throw parse_error("'end' without 'begin'");
+                    current = transforms.back();
+                    transforms.pop_back();
+                }
+                else if (keyword == "translate")
+                    current = current * affine_transform::translation(s.vector("offset"));
+                else if (keyword == "rotate_y")
+                    current = current * affine_transform::rotation_y(s.number("angle"));
+                else if (keyword == "rotate")
+                {
+                    vec3 axis = s.vector("axis");
+                    current = current * affine_transform::rotation(axis, s.number("angle"));
+                }
+                else if (keyword == "scale")
+                {
+                    vec3 factors = s.vector("factors");
+                    if (factors.x() == 0 || factors.y() == 0 || factors.z() == 0)
+                        throw parse_error("scale factors must not be zero");
+                    current = current * affine_transform::scaling(factors);
+                }
+                else if (keyword == "object")
+                    begin_object(s.word("object name"));
+                else if (keyword == "end_object")
+                    end_object();
+                else if (keyword == "instance")
+                    read_instance(s);
+                else
+                    add(read_shape(keyword, s), false);
+                s.finish();
+            }
+
+            void finish()
+            {
+                if (object)
+                    throw parse_error("missing 'end_object'");
+                // Checked once the file is read, as the width and the aspect come from two statements.
+                if (!description.cam.image_size_ok())
+                    throw parse_error("render width and camera aspect give an image larger than " +
+                                      std::to_string(size_t(camera::max_pixels)) + " pixels");
+                // A single light is sampled directly, without picking it from a list.
+                if (lights->hittable_list.size() == 1)
+                    description.lights = lights->hittable_list[0];
+                else if (!lights->hittable_list.empty())
+                    description.lights = lights;
+            }
+
+        private:
+            std::string directory;
+            demo_scene &description;
+            scene *target; ///< Scene receiving shapes: the world, or the object being defined.
+
+            std::map<std::string, shared_ptr<texture>> textures;
+            std::map<std::string, shared_ptr<material>> materials;
+            std::map<std::string, shared_ptr<scene>> objects;
+            std::map<std::string, shared_ptr<const mesh_data>> meshes;
+            shared_ptr<scene> lights = make_shared<scene>();
+            instance_builder bottom_levels;
+
+            affine_transform current;
+            std::vector<affine_transform> transforms;
+            shared_ptr<scene> object; ///< Object being defined, if any.
+            size_t object_depth = 0;  ///< Transform stack depth at its `object` statement.
+
+            /// Calls `build()`, adding its duration to the build time of the scene rather than to its parsing.
+            template <typename Build>
+            auto timed_build(const Build &build)
+            {
+                auto start = std::chrono::steady_clock::now();
+                auto built = build();
+                description.build_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                return built;
+            }
+
+            void read_camera(statement &s)
+            {
+                camera &cam = description.cam;
+                while (!s.done())
+                {
+                    std::string key = s.word("camera setting");
+                    if (key == "lookfrom")
+                        cam.lookfrom = s.vector("lookfrom");
+                    else if (key == "lookat")
+                        cam.lookat = s.vector("lookat");
+                    else if (key == "vup")
+                        cam.vup = s.vector("vup");
+                    else if (key == "vfov")
+                    {
+                        cam.vfov = s.number("vfov");
+                        if (!(cam.vfov > 0 && cam.vfov < 180))
+                            throw parse_error("vfov must be between 0 and 180 degrees");
+                    }
+                    else if (key == "aspect")
+                    {
+                        cam.aspect_ratio = s.number("aspect");
+                        if (!(cam.aspect_ratio > 0))
+                            throw parse_error("aspect must be positive");
+                    }
+                    else if (key == "defocus")
+                        cam.defocus_angle = s.number("defocus");
+                    else if (key == "focus")
+                        cam.focus_dist = s.number("focus");
+                    else
+                        throw parse_error("unknown camera setting '" + key + "'");
+                }
+            }
+
+            void read_render(statement &s)
+            {
+                camera &cam = description.cam;
+                while (!s.done())
+                {
+                    std::string key = s.word("render setting");
+                    if (key == "width")
+                    {
+                        cam.width = s.count("width");
+                        if (cam.width == 0)
+                            throw parse_error("width must be positive");
+                    }
+                    else if (key == "spp")
+                    {
+                        cam.nb_samples = s.count("spp");
+                        if (cam.nb_samples == 0)
+                            throw parse_error("spp must be positive");
+                    }
+                    else if (key == "depth")
+                        cam.depth = s.count("depth");
+                    else if (key == "rr_depth")
+                        cam.russian_roulette_depth = s.count("rr_depth");
+                    else if (key == "background")
+                        cam.background = s.vector("background");
+                    else if (key == "seed")
+                        cam.seed = s.count("seed");
+                    else
+                        throw parse_error("unknown render setting '" + key + "'");
+                }
+            }
+
+            shared_ptr<texture> find_texture(const std::string &name) const
+            {
+                auto found = textures.find(name);
+                if (found == textures.end())
+                    throw parse_error("unknown texture '" + name + "'");
+                return found->second;
+            }
+
+            shared_ptr<material> find_material(const std::string &name) const
+            {
+                auto found = materials.find(name);
+                if (found == materials.end())
+                    throw parse_error("unknown material '" + name + "'");
+                return found->second;
+            }
+
+            void read_texture(statement &s)
+            {
+                std::string name = s.word("texture name");
+                std::string kind = s.word("texture kind");
+                if (kind == "solid")
+                    textures[name] = make_shared<solid_color>(s.vector("color"));
+                else if (kind == "checker")
+                {
+                    double scale = s.number("scale");
+                    auto even = find_texture(s.word("even texture"));
+                    auto odd = find_texture(s.word("odd texture"));
+                    textures[name] = make_shared<checker_texture>(scale, even, odd);
+                }
+                else
+                    throw parse_error("unknown texture kind '" + kind + "'");
+            }
+
+            void read_material(statement &s)
+            {
+                std::string name = s.word("material name");
+                std::string kind = s.word("material kind");
+                if (kind == "lambertian")
+                {
+                    if (s.peek() == "texture")
+                    {
+                        s.word("texture");
+                        materials[name] = make_shared<lambertian>(find_texture(s.word("texture name")));
+                    }
+                    else
+                        materials[name] = make_shared<lambertian>(s.vector("albedo"));
+                }
+                else if (kind == "metal")
+                {
+                    vec3 albedo = s.vector("albedo");
+                    materials[name] = make_shared<metal>(albedo, s.number("fuzz"));
+                }
+                else if (kind == "dielectric")
+                    materials[name] = make_shared<dielectric>(s.number("refraction index"));
+                else if (kind == "light")
+                    materials[name] = make_shared<diffuse_light>(s.vector("emission"));
+                else
+                    throw parse_error("unknown material kind '" + kind + "'");
+            }
+
+            shared_ptr<hittable> read_shape(const std::string &kind, statement &s)
+            {
+                if (kind == "sphere")
+                {
+                    vec3 center = s.vector("center");
+                    double radius = s.number("radius");
+                    return make_shared<sphere>(center, radius, find_material(s.word("material")));
+                }
+                if (kind == "quad")
+                {
+                    vec3 q = s.vector("corner");
+                    vec3 u = s.vector("edge");
+                    vec3 v = s.vector("edge");
+                    return make_shared<quad>(q, u, v, find_material(s.word("material")));
+                }
+                if (kind == "box")
+                {
+                    vec3 a = s.vector("corner");
+                    vec3 b = s.vector("corner");
+                    return make_shared<cube>(a, b, find_material(s.word("material")));
+                }
+                if (kind == "mesh")
+                {
+                    std::string path = s.word("mesh path");
+                    auto mat = find_material(s.word("material"));
+                    auto mesh = load(path);
+                    return timed_build([&]
+                                       { return make_shared<triangle_mesh>(mesh, mat); });
+                }
+                throw parse_error("unknown statement '" + kind + "'");
+            }
+
+            shared_ptr<const mesh_data> load(const std::string &path)
+            {
+                std::string full = (path.empty() || path[0] == '/' || directory.empty()) ? path : directory + "/" + path;
+                auto found = meshes.find(full);
+                if (found != meshes.end())
+                    return found->second;
+
+                auto mesh = make_shared<mesh_data>();
+                std::string message;
+                if (!load_mesh(full, *mesh, &message))
+                    throw parse_error(message);
+                meshes[full] = mesh;
+                return mesh;
+            }
+
+            void add(const shared_ptr<hittable> &shape, bool is_light)
+            {
+                shared_ptr<hittable> placed = shape;
+                if (!current.is_identity())
+                    placed = make_shared<instance>(timed_build([&]
+                                                               { return bottom_levels.bottom_level(shape); }),
+                                                   current);
+
+                // Boxes in place go in as their six quads, so that the top-level BVH sees them.
+                auto list = std::dynamic_pointer_cast<scene>(placed);
+                if (list)
+                {
+                    for (const auto &part : list->hittable_list)
+                        target->add_hittable(part);
+                }
+                else
+                    target->add_hittable(placed);
+
+                if (is_light)
+                {
+                    if (object)
+                        throw parse_error("lights cannot be part of an object");
+                    lights->add_hittable(placed);
+                }
+            }
+
+            void begin_object(const std::string &name)
+            {
+                if (object)
+                    throw parse_error("objects cannot be nested");
+                if (objects.count(name))
+                    throw parse_error("object '" + name + "' is already defined");
+                object = make_shared<scene>();
+                objects[name] = object;
+                target = object.get();
+                transforms.push_back(current);
+                object_depth = transforms.size();
+                current = affine_transform();
+            }
+
+            void end_object()
+            {
+                if (!object)
+                    throw parse_error("'end_object' without 'object'");
+                if (transforms.size() != object_depth)
+                    throw parse_error("unbalanced 'begin' in object");
+                current = transforms.back();
+                transforms.pop_back();
+                object = nullptr;
+                target = &description.world;
+            }
+
+            void read_instance(statement &s)
+            {
+                if (object)
+                    throw parse_error("instances cannot be part of an object");
+                std::string name = s.word("object name");
+                auto found = objects.find(name);
+                if (found == objects.end())
+                    throw parse_error("unknown object '" + name + "'");
+                if (found->second->hittable_list.empty())
+                    throw parse_error("object '" + name + "' is empty");
+
+                auto shared = timed_build([&]
+                                          { return bottom_levels.bottom_level(found->second); });
+                if (current.is_identity())
+                    target->add_hittable(shared);
+                else
+                    target->add_hittable(make_shared<instance>(shared, current));
+            }
+        };
+    } // namespace
+
+    bool parse_scene(std::istream &in, const std::string &name, const std::string &directory,
+                     demo_scene &description, std::string *error)
+    {
+        description = demo_scene();
+        scene_reader reader(directory, description);
+        std::string line;
+        size_t line_number = 0;
+        try
+        {
+            while (std::getline(in, line))
+            {
+                ++line_number;
+                statement s(line);
+                if (!s.empty())
+                    reader.read(s);
+            }
+            reader.finish();
+        }
+        catch (const parse_error &e)
+        {
+            if (error)
+                *error = name + ":" + std::to_string(line_number) + ": " + e.what();
+            return false;
+        }
+        return true;
+    }
+
+    bool load_scene_file(const std::string &filename, demo_scene &description, std::string *error)
+    {
+        std::ifstream in(filename);
+        if (!in.is_open())
+        {
+            if (error)
+                *error = "cannot open " + filename;
+            return false;
+        }
+        size_t slash = filename.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "" : filename.substr(0, slash);
+        return parse_scene(in, filename, directory, description, error);
+    }
+} // namespace cobra
@@ -0,0 +1,61 @@
+#pragma once
+#include "scene/demo_scenes.h"
+
+#include <istream>
+#include <string>
+
+namespace cobra
+{
+    /**
+     * @brief Loads a scene description file.
+     *
+     * The format is line based; `#` starts a comment. Names (of textures, materials and
+     * objects) must be defined before they are used. Vectors are three numbers.
+     *
+     * @code
+     * camera lookfrom 278 278 -800 lookat 278 278 0 vup 0 1 0 vfov 40 aspect 1 defocus 0 focus 10
+     * render width 600 spp 1000 depth 20 rr_depth 3 background 0 0 0 seed 0
+     *
+     * texture  NAME solid R G B
+     * texture  NAME checker SCALE EVEN_TEXTURE ODD_TEXTURE
+     * material NAME lambertian R G B            (or: lambertian texture TEXTURE)
+     * material NAME metal R G B FUZZ
+     * material NAME dielectric IOR
+     * material NAME light R G B                 (diffuse emitter)
+     *
+     * sphere CENTER RADIUS MATERIAL
+     * quad   Q U V MATERIAL                     (corner and two edges)
+     * box    A B MATERIAL                       (two opposite corners)
+     * mesh   PATH MATERIAL                      (.obj or .ply, relative to the scene file)
+     * light  <sphere or quad statement>         (also sampled as a light; other shapes are refused)
+     *
+     * begin / end                               (save / restore the current transform)
+     * translate V | rotate_y DEGREES | rotate AXIS DEGREES | scale V
+     * object NAME ... end_object                (shapes defined once, in object space)
+     * instance NAME                             (places an object with the current transform)
+     * @endcode
+     *
+     * Transforms apply to the statements that follow them, innermost last as in a
+     * matrix product. Transformed shapes and instances share their bottom-level BVH
+     * (see instance_builder). Camera and render keys may appear in any order, on one
+     * or several lines.
+     *
+     * @param filename Path of the file.
+     * @param description Receives the world, the lights and the camera.
+     * @param error If not null, receives "file:line: message" when loading fails.
+     * @return True on success.
+     */
+    bool load_scene_file(const std::string &filename, demo_scene &description, std::string *error = nullptr);
+
+    /**
+     * @brief Parses a scene description from a stream (see load_scene_file for the format).
+     * @param in The text to parse.
+     * @param name Name used in error messages.
+     * @param directory Directory that mesh paths are relative to (may be empty).
+     * @param description Receives the world, the lights and the camera.
+     * @param error If not null, receives "name:line: message" when parsing fails.
+     * @return True on success.
+     */
+    bool parse_scene(std::istream &in, const std::string &name, const std::string &directory,
+                     demo_scene &description, std::string *error = nullptr);
+} // namespace cobra
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstdlib>
+
+namespace cobra
+{
+    /**
+     * @brief Reads a non-negative integer option value, for cobra and cobra_bench.
+     * @return The value, or -1 if `text` is not a non-negative integer.
+     */
+    inline long parse_count(const char *text)
+    {
+        char *end;
+        long value = std::strtol(text, &end, 10);
+        return (*text && !*end && value >= 0) ? value : -1;
+    }
+} // namespace cobra
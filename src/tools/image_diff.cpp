@@ -0,0 +1,213 @@
+#include "image/pfm_reader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cobra;
+
+namespace
+{
+    /// Differences between a reference image and a test image.
+    struct image_difference
+    {
+        std::string name;
+        size_t pixels = 0;
+        double mean_reference = 0; ///< Mean luminance of the reference.
+        double mean_test = 0;      ///< Mean luminance of the test image.
+        double rmse = 0;           ///< Root mean square difference over all channels.
+        double max_difference = 0; ///< Largest absolute channel difference.
+        double psnr = 0;           ///< PSNR of the colors clamped to [0, 1], in dB.
+        double differing = 0;      ///< Fraction of pixels with a channel differing by more than the threshold.
+
+        /// @return The relative difference of the mean luminances.
+        double bias() const { return mean_reference > 0 ? (mean_test - mean_reference) / mean_reference : 0; }
+    };
+
+    bool compare(const std::string &name, const std::string &reference_path, const std::string &test_path,
+                 double threshold, image_difference &diff)
+    {
+        std::string error;
+        auto reference = read_pfm(reference_path, &error);
+        auto test = reference ? read_pfm(test_path, &error) : nullptr;
+        if (!test)
+        {
+            std::cerr << error << std::endl;
+            return false;
+        }
+        if (reference->get_width() != test->get_width() || reference->get_height() != test->get_height())
+        {
+            std::cerr << name << ": the images have different sizes" << std::endl;
+            return false;
+        }
+
+        diff.name = name;
+        diff.pixels = reference->get_width() * reference->get_height();
+        double squared = 0, clamped_squared = 0;
+        size_t differing = 0;
+        for (size_t row = 0; row < reference->get_height(); ++row)
+        {
+            for (size_t col = 0; col < reference->get_width(); ++col)
+            {
+                vec3 a = reference->get_pixel(row, col);
+                vec3 b = test->get_pixel(row, col);
+                diff.mean_reference += luminance(a);
+                diff.mean_test += luminance(b);
+
+                bool differs = false;
+                for (int c = 0; c < 3; ++c)
+                {
+                    double d = double(b[c]) - double(a[c]);
+                    double clamped = std::clamp(double(b[c]), 0.0, 1.0) - std::clamp(double(a[c]), 0.0, 1.0);
+                    squared += d * d;
+                    clamped_squared += clamped * clamped;
+                    diff.max_difference = std::max(diff.max_difference, std::fabs(d));
+                    differs = differs || std::fabs(d) > threshold;
+                }
+                differing += differs ? 1 : 0;
+            }
+        }
+
+        diff.mean_reference /= double(diff.pixels);
+        diff.mean_test /= double(diff.pixels);
+        diff.rmse = std::sqrt(squared / (3.0 * diff.pixels));
+        double clamped_mse = clamped_squared / (3.0 * diff.pixels);
+        diff.psnr = clamped_mse > 0 ? -10 * std::log10(clamped_mse) : INFINITY;
+        diff.differing = double(differing) / double(diff.pixels);
+        return true;
+    }
+
+    /// @brief Writes a number, JSON having no infinity.
+    void write_number(std::ostream &out, double value)
+    {
+        if (std::isfinite(value))
+            out << value;
+        else
+            out << "null";
+    }
+
+    void write_json(const std::string &path, const std::vector<image_difference> &diffs, double threshold)
+    {
+        std::ofstream out(path);
+        out << std::setprecision(8) << "{\n  \"threshold\": " << threshold << ",\n  \"images\": [";
+        for (size_t i = 0; i < diffs.size(); ++i)
+        {
+            const image_difference &d = diffs[i];
+            out << (i ? "," : "") << "\n    {\"name\": \"" << d.name << "\", \"pixels\": " << d.pixels
+                << ", \"mean_reference\": " << d.mean_reference << ", \"mean_test\": " << d.mean_test
+                << ", \"bias\": " << d.bias() << ", \"rmse\": " << d.rmse << ", \"max_difference\": "
+                << d.max_difference << ", \"psnr\": ";
+            write_number(out, d.psnr);
+            out << ", \"differing\": " << d.differing << "}";
+        }
+        out << "\n  ]\n}\n";
+        if (!out)
+            std::cerr << "Could not write " << path << std::endl;
+    }
+
+    void print_usage(const char *program)
+    {
+        std::cout << "Usage: " << program << " [options] REFERENCE TEST\n"
+                  << "\n"
+                  << "Compares two PFM images, or every PFM image of directory REFERENCE with the\n"
+                  << "image of the same name in directory TEST (e.g. the cobra_bench --images output\n"
+                  << "of a double and of a single precision build).\n"
+                  << "\n"
+                  << "      --threshold X  channel difference counted as a differing pixel (default 0.01)\n"
+                  << "      --max-rmse X   exit with status 1 if an image pair has a larger RMSE\n"
+                  << "      --json PATH    also write the report as JSON\n"
+                  << "  -h, --help         print this help\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double threshold = 0.01;
+    double max_rmse = INFINITY;
+    std::string json;
+    std::vector<std::string> paths;
+    for (int a = 1; a < argc; ++a)
+    {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        if (arg == "--threshold" && has_value)
+            threshold = std::atof(argv[++a]);
+        else if (arg == "--max-rmse" && has_value)
+            max_rmse = std::atof(argv[++a]);
+        else if (arg == "--json" && has_value)
+            json = argv[++a];
+        else if (arg == "-h" || arg == "--help")
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown or incomplete option " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+        else
+            paths.push_back(arg);
+    }
+    if (paths.size() != 2)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    namespace fs = std::filesystem;
+    std::vector<std::pair<std::string, std::string>> pairs;
+    std::vector<std::string> names;
+    std::error_code ec;
+    if (fs::is_directory(paths[0], ec) && fs::is_directory(paths[1], ec))
+    {
+        for (const auto &entry : fs::directory_iterator(paths[0], ec))
+            if (entry.path().extension() == ".pfm" && fs::exists(fs::path(paths[1]) / entry.path().filename(), ec))
+                names.push_back(entry.path().filename().string());
+        std::sort(names.begin(), names.end());
+        for (const auto &name : names)
+            pairs.emplace_back((fs::path(paths[0]) / name).string(), (fs::path(paths[1]) / name).string());
+        if (pairs.empty())
+        {
+            std::cerr << "No PFM image is in both " << paths[0] << " and " << paths[1] << std::endl;
+            return 1;
+        }
+    }
+    else
+    {
+        names.push_back(fs::path(paths[1]).filename().string());
+        pairs.emplace_back(paths[0], paths[1]);
+    }
+
+    std::vector<image_difference> diffs;
+    bool ok = true;
+    std::cout << std::left << std::setw(24) << "image" << std::right << std::setw(12) << "bias" << std::setw(12)
+              << "rmse" << std::setw(12) << "max diff" << std::setw(10) << "psnr dB" << std::setw(11) << "differing"
+              << std::endl;
+    for (size_t i = 0; i < pairs.size(); ++i)
+    {
+        image_difference diff;
+        if (!compare(names[i], pairs[i].first, pairs[i].second, threshold, diff))
+        {
+            ok = false;
+            continue;
+        }
+        std::cout << std::left << std::setw(24) << diff.name << std::right << std::scientific << std::setprecision(2)
+                  << std::setw(12) << diff.bias() << std::setw(12) << diff.rmse << std::setw(12)
+                  << diff.max_difference << std::fixed << std::setprecision(1) << std::setw(10) << diff.psnr
+                  << std::setw(10) << diff.differing * 100 << "%" << std::endl;
+        ok = ok && diff.rmse <= max_rmse;
+        diffs.push_back(diff);
+    }
+
+    if (!json.empty())
+        write_json(json, diffs, threshold);
+    return ok ? 0 : 1;
+}
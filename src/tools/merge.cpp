@@ -0,0 +1,131 @@
+#include "image/accumulation.h"
+#include "image/denoiser.h"
+#include "image/image_writer.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace cobra;
+
+namespace
+{
+    void print_usage(const char *program)
+    {
+        std::cout << "Usage: " << program << " [options] PARTIAL...\n"
+                  << "\n"
+                  << "Combines the partial accumulation files of a split render (cobra --partial,\n"
+                  << "with --region or --sample-offset) into the image of the whole frame. Each\n"
+                  << "pixel is the mean of all the samples the parts took of it.\n"
+                  << "\n"
+                  << "  -o, --output PATH  output image (.ppm or .pfm); default: merged.pfm\n"
+                  << "      --accumulation PATH\n"
+                  << "                     also write the merged samples as an accumulation file\n"
+                  << "      --denoise      filter the noise out; the parts need AOVs (cobra --aovs)\n"
+                  << "      --aov-output PREFIX\n"
+                  << "                     also write PREFIX_albedo, PREFIX_normal and PREFIX_depth\n"
+                  << "  -h, --help         print this help\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string output = "merged.pfm";
+    std::string accumulation;
+    std::string aov_output;
+    bool denoised = false;
+    std::vector<std::string> paths;
+    for (int a = 1; a < argc; ++a)
+    {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        if ((arg == "-o" || arg == "--output") && has_value)
+            output = argv[++a];
+        else if (arg == "--accumulation" && has_value)
+            accumulation = argv[++a];
+        else if (arg == "--aov-output" && has_value)
+            aov_output = argv[++a];
+        else if (arg == "--denoise")
+            denoised = true;
+        else if (arg == "-h" || arg == "--help")
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown or incomplete option " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+        else
+            paths.push_back(arg);
+    }
+    if (paths.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    std::string error;
+    std::vector<std::unique_ptr<accumulation_buffer>> buffers;
+    std::vector<const accumulation_buffer *> parts;
+    for (const auto &path : paths)
+    {
+        buffers.push_back(read_accumulation(path, &error));
+        if (!buffers.back())
+        {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        const accumulation_buffer &part = *buffers.back();
+        std::cout << path << ": " << part.width << "x" << part.height << " at (" << part.x0 << ", " << part.y0
+                  << "), samples from " << part.sample_offset << ", " << part.sample_count() << " samples" << std::endl;
+        parts.push_back(&part);
+    }
+
+    accumulation_buffer merged;
+    if (!merge_accumulations(parts, merged, &error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    size_t empty = 0;
+    for (const auto &p : merged.pixels)
+        empty += p.samples() == 0 ? 1 : 0;
+    if (empty > 0)
+        std::cerr << "Warning: " << empty << " pixels are in no part and stay black" << std::endl;
+
+    if ((denoised || !aov_output.empty()) && !merged.aovs)
+        std::cerr << "Warning: the parts have no AOVs (cobra --aovs): the AOV images are black and only the luminance guides the filter" << std::endl;
+
+    auto writer = image_writer::create(output);
+    if (!writer || !writer->write(denoised ? denoise(merged) : merged.resolve(), output))
+    {
+        std::cerr << "Could not write " << output << std::endl;
+        return 1;
+    }
+    size_t dot = output.find_last_of('.');
+    const std::string extension = dot == std::string::npos ? ".ppm" : output.substr(dot);
+    const std::pair<aov, const char *> aovs[] = {{aov::albedo, "_albedo"}, {aov::normal, "_normal"}, {aov::depth, "_depth"}};
+    for (const auto &entry : aovs)
+    {
+        const std::string path = aov_output + entry.second + extension;
+        if (!aov_output.empty() && !writer->write(merged.resolve(entry.first), path))
+        {
+            std::cerr << "Could not write " << path << std::endl;
+            return 1;
+        }
+    }
+    if (!accumulation.empty() && !write_accumulation(merged, accumulation, &error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    std::cout << "Output: " << output << ", " << merged.width << "x" << merged.height << ", "
+              << merged.sample_count() << " samples" << std::endl;
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "image/denoiser.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace cobra;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const std::string &what, size_t width, size_t height)
+    {
+        if (condition)
+            return;
+        std::cerr << width << "x" << height << ": " << what << std::endl;
+        ++failures;
+    }
+
+    /// @brief Fills a pixel with `samples` samples of one color, and one normal and depth per column.
+    void fill(pixel_accumulator &p, const vec3 &color, size_t samples, size_t column)
+    {
+        p = pixel_accumulator();
+        for (size_t s = 0; s < samples; ++s)
+        {
+            p.sum += color;
+            p.luminance.add(luminance(color));
+            p.aovs += {vec3(0.5, 0.5, 0.5), vec3(0, 0, 1), 2.0 + double(column % 3)};
+        }
+    }
+
+    /// @brief A flat image stays flat, whatever its width against the SIMD width.
+    void flat_image(size_t width, size_t height, bool aovs)
+    {
+        const vec3 color(0.25, 0.5, 0.75);
+        accumulation_buffer buffer(width, height, 1, 4, false);
+        buffer.aovs = aovs;
+        for (size_t j = 0; j < height; ++j)
+            for (size_t i = 0; i < width; ++i)
+                fill(buffer.at(i, j), color, 4, i);
+
+        const image result = denoise(buffer);
+        bool flat = true;
+        for (size_t j = 0; j < height; ++j)
+            for (size_t i = 0; i < width; ++i)
+            {
+                const vec3 c = result.get_pixel(j, i);
+                for (int k = 0; k < 3; ++k)
+                    flat = flat && std::isfinite(double(c[k])) && std::abs(double(c[k] - color[k])) < 1e-4;
+            }
+        check(flat, "a flat image does not stay flat", width, height);
+    }
+
+    /// @brief A pixel with a single sample keeps its color, among noisy ones that get smoothed.
+    void single_sample(size_t width, size_t height)
+    {
+        accumulation_buffer buffer(width, height, 1, 4, false);
+        for (size_t j = 0; j < height; ++j)
+            for (size_t i = 0; i < width; ++i)
+            {
+                fill(buffer.at(i, j), vec3(0.3, 0.3, 0.3), 2, i);
+                pixel_accumulator bright;
+                fill(bright, vec3(0.7, 0.7, 0.7), 2, i);
+                buffer.at(i, j).sum += bright.sum;
+                buffer.at(i, j).luminance.add(bright.luminance);
+            }
+        const vec3 lone(0.625, 0.625, 0.625);
+        fill(buffer.at(width / 2, height / 2), lone, 1, width / 2);
+
+        const vec3 c = denoise(buffer).get_pixel(height / 2, width / 2);
+        check(c[0] == lone[0] && c[1] == lone[1] && c[2] == lone[2], "a single-sample pixel is filtered", width,
+              height);
+    }
+} // namespace
+
+int main()
+{
+    // Widths below, at and across the 4 and 8 lanes of the kernel.
+    for (size_t width : {1, 3, 7, 8, 81})
+        for (size_t height : {1, 5})
+        {
+            flat_image(width, height, false);
+            flat_image(width, height, true);
+            single_sample(width, height);
+        }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
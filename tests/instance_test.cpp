@@ -0,0 +1,68 @@
+#include "scene/scene.h"
+#include "geometry/instance.h"
+#include "geometry/quad.h"
+#include "geometry/sphere.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+
+using namespace cobra;
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const std::string &what)
+    {
+        if (condition)
+            return;
+        std::cerr << what << std::endl;
+        ++failures;
+    }
+
+    /// @brief A scaled quad light has the density of the same quad written in world space.
+    void scaled_quad(double s)
+    {
+        auto local = std::make_shared<quad>(vec3(0.5, 2, 0.5), vec3(-1, 0, 0), vec3(0, 0, -1), nullptr);
+        instance scaled(local, affine_transform::scaling(vec3(s, s, s)));
+        quad world(vec3(0.5, 2, 0.5) * s, vec3(-s, 0, 0), vec3(0, 0, -s), nullptr);
+
+        const vec3 origin(0.3, 0.2, -0.1);
+        bool same = true;
+        for (int k = 0; k < 100; ++k)
+        {
+            const vec3 direction = unit_vector(world.random(origin));
+            const double expected = world.pdf_value(origin, direction);
+            same = same && expected > 0 && std::abs(scaled.pdf_value(origin, direction) / expected - 1) < 1e-6;
+        }
+        check(same, "a quad scaled by " + std::to_string(s) + " has another pdf than its world-space copy");
+    }
+
+    /// @brief The density of a light under a non-uniform scale and shear still sums to 1 over the directions.
+    void sheared_light(const std::shared_ptr<hittable> &light, const std::string &name)
+    {
+        const affine_transform shear = affine_transform::scaling(vec3(1, 2.5, 0.5));
+        instance placed(light, affine_transform::rotation(vec3(1, 1, 0), 0.7) * shear);
+
+        // Uniform directions: the mean of pdf * 4 pi estimates its integral.
+        const vec3 origin(0.5, -4, 1);
+        const int count = 1000000;
+        double sum = 0;
+        for (int k = 0; k < count; ++k)
+            sum += placed.pdf_value(origin, random_unit_vector());
+        const double integral = sum * 4 * pi / count;
+        check(std::abs(integral - 1) < 0.02, "the pdf of a sheared " + name + " sums to " + std::to_string(integral));
+    }
+} // namespace
+
+int main()
+{
+    for (double s : {0.5, 2.0, 4.0})
+        scaled_quad(s);
+    sheared_light(std::make_shared<sphere>(vec3(0, 0, 0), 1, nullptr), "sphere");
+    sheared_light(std::make_shared<quad>(vec3(-1, 0, -1), vec3(2, 0, 0), vec3(0, 0, 2), nullptr), "quad");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,24 @@
+# Rend la boîte de Cornell en un processus, puis en trois avec --split ${SPLIT}, et compare.
+# 10 échantillons par pixel : la grille de stratification en garde 9, que les trois
+# processus se partagent en --split samples.
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(single ${WORK_DIR}/single_${SPLIT}.pfm)
+set(split ${WORK_DIR}/split_${SPLIT}.pfm)
+set(settings -w 48 -s 10 -t 1)
+
+execute_process(COMMAND ${COBRA} ${settings} -o ${single} RESULT_VARIABLE status OUTPUT_QUIET ERROR_QUIET)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "single-process render failed")
+endif()
+
+execute_process(COMMAND ${COBRA} ${settings} --workers 3 --split ${SPLIT} -o ${split}
+                RESULT_VARIABLE status OUTPUT_QUIET ERROR_QUIET)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "split render failed")
+endif()
+
+# Les sommes des parties sont additionnées dans un autre ordre : seul l'arrondi peut différer.
+execute_process(COMMAND ${IMAGE_DIFF} --max-rmse 1e-6 ${single} ${split} RESULT_VARIABLE status)
+if(NOT status EQUAL 0)
+    message(FATAL_ERROR "the split render differs from the single-process one")
+endif()